@@ -32,6 +32,11 @@
 #include "tile.h"
 #include "tileset.h"
 
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
 using namespace Tiled;
 
 // Bits on the far end of the 32-bit global tile ID are used for tile flags
@@ -61,6 +66,45 @@ GidMapper::GidMapper(const QVector<SharedTileset> &tilesets)
     }
 }
 
+/**
+ * Insert the given \a tileset with \a firstGid as its first global ID.
+ */
+void GidMapper::insert(unsigned firstGid, Tileset *tileset)
+{
+    // Tilesets are usually inserted in order, so check the end first
+    if (mFirstGids.isEmpty() || mFirstGids.last() < firstGid) {
+        mFirstGids.append(firstGid);
+        mTilesets.append(tileset);
+    } else {
+        auto it = std::lower_bound(mFirstGids.begin(), mFirstGids.end(), firstGid);
+        const int index = it - mFirstGids.begin();
+
+        if (*it == firstGid) {
+            // Replacing a tileset may affect the reverse lookup of the old one
+            mTilesets[index] = tileset;
+            rebuildTilesetToFirstGid();
+            return;
+        }
+
+        mFirstGids.insert(index, firstGid);
+        mTilesets.insert(index, tileset);
+    }
+
+    // When a tileset is inserted multiple times, its lowest first GID is used
+    auto it = mTilesetToFirstGid.find(tileset);
+    if (it == mTilesetToFirstGid.end() || firstGid < it.value())
+        mTilesetToFirstGid.insert(tileset, firstGid);
+}
+
+void GidMapper::rebuildTilesetToFirstGid()
+{
+    mTilesetToFirstGid.clear();
+
+    // Iterate backwards so that the lowest first GID of each tileset remains
+    for (int i = mFirstGids.size() - 1; i >= 0; --i)
+        mTilesetToFirstGid.insert(mTilesets.at(i), mFirstGids.at(i));
+}
+
 /**
  * Returns the cell data matched by the given \a gid. The \a ok parameter
  * indicates whether an error occurred.
@@ -85,14 +129,15 @@ Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
         ok = false;
     } else {
         // Find the tileset containing this tile
-        QMap<unsigned, Tileset*>::const_iterator i = mFirstGidToTileset.upperBound(gid);
-        if (i == mFirstGidToTileset.begin()) {
+        auto i = std::upper_bound(mFirstGids.begin(), mFirstGids.end(), gid);
+        if (i == mFirstGids.begin()) {
             // Invalid global tile ID, since it lies before the first tileset
             ok = false;
         } else {
             --i; // Navigate one tileset back since upper bound finds the next
-            int tileId = gid - i.key();
-            Tileset *tileset = i.value();
+            const int index = i - mFirstGids.begin();
+            int tileId = gid - *i;
+            Tileset *tileset = mTilesets.at(index);
 
             result.setTile(tileset, tileId);
 
@@ -112,18 +157,12 @@ unsigned GidMapper::cellToGid(const Cell &cell) const
     if (cell.isEmpty())
         return 0;
 
-    const Tileset *tileset = cell.tileset();
-
     // Find the first GID for the tileset
-    QMap<unsigned, Tileset*>::const_iterator i = mFirstGidToTileset.begin();
-    QMap<unsigned, Tileset*>::const_iterator i_end = mFirstGidToTileset.end();
-    while (i != i_end && i.value() != tileset)
-        ++i;
-
-    if (i == i_end) // tileset not found
+    auto i = mTilesetToFirstGid.find(cell.tileset());
+    if (i == mTilesetToFirstGid.end()) // tileset not found
         return 0;
 
-    unsigned gid = i.key() + cell.tileId();
+    unsigned gid = i.value() + cell.tileId();
     if (cell.flippedHorizontally())
         gid |= FlippedHorizontallyFlag;
     if (cell.flippedVertically())
@@ -183,30 +222,130 @@ GidMapper::DecodeError GidMapper::decodeLayerData(TileLayer &tileLayer,
         return CorruptLayerData;
 
     const unsigned char *data = reinterpret_cast<const unsigned char*>(decodedData.constData());
-    int x = 0;
-    int y = 0;
-    bool ok;
-
-    for (int i = 0; i < size - 3; i += 4) {
-        const unsigned gid = data[i] |
-                             data[i + 1] << 8 |
-                             data[i + 2] << 16 |
-                             data[i + 3] << 24;
-
-        const Cell result = gidToCell(gid, ok);
-        if (!ok) {
-            mInvalidTile = gid;
-            return isEmpty() ? TileButNoTilesets : InvalidTile;
-        }
+    QVector<unsigned> gids(size / 4);
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // The GIDs are stored in little-endian, so no conversion is needed
+    std::memcpy(gids.data(), data, size);
+#else
+    for (int i = 0; i < gids.size(); ++i)
+        gids[i] = qFromLittleEndian<quint32>(data + i * 4);
+#endif
+
+    return decodeLayerData(tileLayer, gids);
+}
+
+/**
+ * Sets the cells of \a tileLayer to the given \a gids, in row-major order.
+ *
+ * The cells are written directly into the chunks of the layer in their
+ * packed form, avoiding the overhead of setting each cell separately. Since
+ * all cells are replaced, the layer is cleared first and the cells referring
+ * to each tileset are counted on the way.
+ *
+ * Cells with an invalid GID are left empty. Decoding continues past them and
+ * the error for the first one is returned, so callers can decide whether to
+ * treat it as fatal.
+ */
+GidMapper::DecodeError GidMapper::decodeLayerData(TileLayer &tileLayer,
+                                                  const QVector<unsigned> &gids) const
+{
+    const int width = tileLayer.width();
+    const int height = tileLayer.height();
 
-        tileLayer.setCell(x, y, result);
+    if (gids.size() != width * height)
+        return CorruptLayerData;
+
+    tileLayer.mChunks.clear();
+    tileLayer.mTilesetCellCounts.fill(0);
+    tileLayer.mOverflowTilesetCellCounts.clear();
+    tileLayer.mDrawMarginsDirty = true;
+
+    // Look up the packed tileset bits for each of our tilesets once
+    QVector<quint32> packedTilesets(mTilesets.size());
+    for (int i = 0; i < mTilesets.size(); ++i) {
+        const int index = tileLayer.tilesetIndex(mTilesets.at(i));
+        packedTilesets[i] = index == OverflowTilesetIndex ? PackedOverflowCell
+                                                          : quint32(index) << PackedTilesetShift;
+    }
 
-        x++;
-        if (x == tileLayer.width()) {
-            x = 0;
-            y++;
+    const unsigned flagsMask = FlippedHorizontallyFlag |
+                               FlippedVerticallyFlag |
+                               FlippedAntiDiagonallyFlag;
+
+    // The tileset table doesn't grow while decoding, since all our tilesets
+    // were looked up above
+    int *cellCounts = tileLayer.mTilesetCellCounts.data();
+
+    DecodeError error = NoError;
+    int tilesetIndex = 0;
+    QPoint chunkPosition(-1, -1);
+    Chunk *chunk = nullptr;
+    const unsigned *gid = gids.constData();
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x, ++gid) {
+            const unsigned id = *gid & ~flagsMask;
+            quint32 packed = 0;
+
+            if (id != 0) {
+                if (isEmpty()) {
+                    if (error == NoError) {
+                        mInvalidTile = *gid;
+                        error = TileButNoTilesets;
+                    }
+                    continue;
+                }
+
+                // Tiles from the same tileset tend to be grouped, so check
+                // the previous tileset before searching
+                if (id < mFirstGids.at(tilesetIndex) ||
+                        (tilesetIndex + 1 < mFirstGids.size() &&
+                         id >= mFirstGids.at(tilesetIndex + 1))) {
+                    auto i = std::upper_bound(mFirstGids.begin(), mFirstGids.end(), id);
+                    if (i == mFirstGids.begin()) {
+                        if (error == NoError) {
+                            mInvalidTile = *gid;
+                            error = InvalidTile;
+                        }
+                        continue;
+                    }
+                    tilesetIndex = i - mFirstGids.begin() - 1;
+                }
+
+                const unsigned tileId = id - mFirstGids.at(tilesetIndex);
+                const quint32 packedTileset = packedTilesets.at(tilesetIndex);
+
+                if (packedTileset == PackedOverflowCell || tileId > PackedTileIdMask) {
+                    // This cell doesn't fit in the packed layout
+                    bool ok;
+                    tileLayer.setCell(x, y, gidToCell(*gid, ok));
+                    continue;
+                }
+
+                // The GID flags use the same bits as the packed flags
+                packed = (*gid & flagsMask) | packedTileset | tileId;
+                ++cellCounts[packedTileset >> PackedTilesetShift];
+            }
+
+            const QPoint position = TileLayer::chunkPosition(x, y);
+            if (position != chunkPosition) {
+                chunkPosition = position;
+                auto it = tileLayer.mChunks.find(position);
+                chunk = it != tileLayer.mChunks.end() ? &it.value() : nullptr;
+            }
+
+            if (!chunk) {
+                if (packed == 0)
+                    continue;
+                chunk = &tileLayer.mChunks[position];
+            }
+
+            chunk->setPackedCell(x & CHUNK_MASK, y & CHUNK_MASK, packed);
         }
     }
 
-    return NoError;
+    tileLayer.releaseUnusedTilesetSlots();
+
+    return error;
 }
@@ -31,7 +31,8 @@
 #include "map.h"
 #include "tilelayer.h"
 
-#include <QMap>
+#include <QHash>
+#include <QVector>
 
 namespace Tiled {
 
@@ -65,29 +66,33 @@ public:
                                 const QByteArray &layerData,
                                 Map::LayerDataFormat format) const;
 
+    DecodeError decodeLayerData(TileLayer &tileLayer,
+                                const QVector<unsigned> &gids) const;
+
     unsigned invalidTile() const;
 
 private:
-    QMap<unsigned, Tileset*> mFirstGidToTileset;
+    void rebuildTilesetToFirstGid();
+
+    // Sorted by first GID, for looking up the tileset of a GID
+    QVector<unsigned> mFirstGids;
+    QVector<Tileset*> mTilesets;
+
+    // For looking up the first GID of a tileset
+    QHash<const Tileset*, unsigned> mTilesetToFirstGid;
 
     mutable unsigned mInvalidTile;
 };
 
 
-/**
- * Insert the given \a tileset with \a firstGid as its first global ID.
- */
-inline void GidMapper::insert(unsigned firstGid, Tileset *tileset)
-{
-    mFirstGidToTileset.insert(firstGid, tileset);
-}
-
 /**
  * Clears the gid mapper, so that it can be reused.
  */
 inline void GidMapper::clear()
 {
-    mFirstGidToTileset.clear();
+    mFirstGids.clear();
+    mTilesets.clear();
+    mTilesetToFirstGid.clear();
 }
 
 /**
@@ -95,7 +100,7 @@ inline void GidMapper::clear()
  */
 inline bool GidMapper::isEmpty() const
 {
-    return mFirstGidToTileset.isEmpty();
+    return mFirstGids.isEmpty();
 }
 
 /**
@@ -0,0 +1,227 @@
+/*
+ * imagecache.cpp
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "imagecache.h"
+
+#include <QCache>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace Tiled {
+
+namespace {
+
+struct CachedImage
+{
+    QDateTime lastModified;
+    QImage image;
+};
+
+struct CachedPixmap
+{
+    qint64 imageKey;
+    QPixmap pixmap;
+};
+
+// The default memory budget, in kilobytes
+const int DefaultMemoryBudget = 256 * 1024;
+
+// The memory budget is split evenly between the images and the pixmaps
+int imageShare(int budget) { return budget / 2; }
+int pixmapShare(int budget) { return budget - budget / 2; }
+
+struct ImageCacheData
+{
+    ImageCacheData()
+        : budget(DefaultMemoryBudget)
+        , images(imageShare(DefaultMemoryBudget))
+        , pixmaps(pixmapShare(DefaultMemoryBudget))
+    {}
+
+    QMutex mutex;
+    int budget;                             // protected by the mutex
+    QCache<QString, CachedImage> images;    // protected by the mutex
+    QCache<QString, CachedPixmap> pixmaps;  // only used from the GUI thread
+};
+
+} // anonymous namespace
+
+Q_GLOBAL_STATIC(ImageCacheData, cacheData)
+
+static int imageCost(const QImage &image)
+{
+    return qMax(1, image.byteCount() / 1024);
+}
+
+bool isGuiThread()
+{
+    QCoreApplication *app = QCoreApplication::instance();
+    return app && QThread::currentThread() == app->thread();
+}
+
+// Pixmaps need to be released before the application is gone
+static void clearPixmaps()
+{
+    cacheData()->pixmaps.clear();
+}
+
+/**
+ * Returns the image stored in the given file. The image is decoded only when
+ * it isn't in the cache yet, or when the file was modified since it was
+ * cached.
+ *
+ * This function is thread-safe.
+ */
+QImage ImageCache::loadImage(const QString &fileName)
+{
+    if (fileName.isEmpty())
+        return QImage();
+
+    ImageCacheData *data = cacheData();
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+
+    {
+        QMutexLocker locker(&data->mutex);
+        if (CachedImage *cached = data->images.object(fileName))
+            if (cached->lastModified == lastModified)
+                return cached->image;
+    }
+
+    // Decode outside of the lock, so that images can load in parallel
+    const QImage image(fileName);
+    if (image.isNull())
+        return image;
+
+    QMutexLocker locker(&data->mutex);
+    data->images.insert(fileName,
+                        new CachedImage { lastModified, image },
+                        imageCost(image));
+
+    return image;
+}
+
+/**
+ * Returns the image stored in the given file as a pixmap. The same pixmap is
+ * returned for as long as the cached image remains the same.
+ */
+QPixmap ImageCache::loadPixmap(const QString &fileName)
+{
+    return toPixmap(loadImage(fileName), fileName);
+}
+
+/**
+ * Converts the given \a image, loaded from \a fileName, to a pixmap. When
+ * the same image was converted before, the same pixmap is returned.
+ *
+ * Pixmaps are only cached when called from the GUI thread.
+ */
+QPixmap ImageCache::toPixmap(const QImage &image, const QString &fileName)
+{
+    if (fileName.isEmpty() || image.isNull() || !isGuiThread())
+        return QPixmap::fromImage(image);
+
+    ImageCacheData *data = cacheData();
+    if (CachedPixmap *cached = data->pixmaps.object(fileName))
+        if (cached->imageKey == image.cacheKey())
+            return cached->pixmap;
+
+    static bool clearPixmapsAdded = false;
+    if (!clearPixmapsAdded) {
+        qAddPostRoutine(clearPixmaps);
+        clearPixmapsAdded = true;
+    }
+
+    const QPixmap pixmap = QPixmap::fromImage(image);
+    data->pixmaps.insert(fileName,
+                         new CachedPixmap { image.cacheKey(), pixmap },
+                         imageCost(image));
+
+    return pixmap;
+}
+
+/**
+ * Removes the image stored in the given file from the cache. Should be
+ * called when the file is known to have changed.
+ */
+void ImageCache::remove(const QString &fileName)
+{
+    ImageCacheData *data = cacheData();
+
+    {
+        QMutexLocker locker(&data->mutex);
+        data->images.remove(fileName);
+    }
+
+    if (isGuiThread())
+        data->pixmaps.remove(fileName);
+}
+
+/**
+ * Returns the maximum amount of memory used by the cache, in kilobytes. The
+ * budget is shared by the images and the pixmaps.
+ */
+int ImageCache::memoryBudget()
+{
+    ImageCacheData *data = cacheData();
+    QMutexLocker locker(&data->mutex);
+    return data->budget;
+}
+
+/**
+ * Returns the part of the memory budget used by the pixmaps, in kilobytes.
+ * Should also limit other caches keeping pixmaps of this cache alive.
+ */
+int ImageCache::pixmapBudget()
+{
+    return pixmapShare(memoryBudget());
+}
+
+/**
+ * Sets the maximum amount of memory used by the cache, in kilobytes.
+ *
+ * May only be called from the GUI thread.
+ */
+void ImageCache::setMemoryBudget(int kilobytes)
+{
+    Q_ASSERT(isGuiThread());
+
+    ImageCacheData *data = cacheData();
+
+    {
+        QMutexLocker locker(&data->mutex);
+        data->budget = kilobytes;
+        data->images.setMaxCost(imageShare(kilobytes));
+    }
+
+    data->pixmaps.setMaxCost(pixmapShare(kilobytes));
+}
+
+} // namespace Tiled
@@ -0,0 +1,70 @@
+/*
+ * imagecache.h
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "tiled_global.h"
+
+#include <QImage>
+#include <QPixmap>
+#include <QString>
+
+namespace Tiled {
+
+/**
+ * A process-wide cache of decoded images, keyed by their file name. Maps and
+ * tilesets referring to the same image file share a single decoded copy.
+ *
+ * Cached images are validated against the modification time of their file,
+ * so changed files are always loaded again. The memory used by the cache is
+ * limited by a budget, beyond which the least recently used images are
+ * dropped.
+ *
+ * Images can be loaded from any thread, whereas pixmaps are only cached when
+ * requested from the GUI thread.
+ */
+class TILEDSHARED_EXPORT ImageCache
+{
+public:
+    static QImage loadImage(const QString &fileName);
+    static QPixmap loadPixmap(const QString &fileName);
+    static QPixmap toPixmap(const QImage &image, const QString &fileName);
+
+    static void remove(const QString &fileName);
+
+    static int memoryBudget();
+    static int pixmapBudget();
+    static void setMemoryBudget(int kilobytes);
+};
+
+/**
+ * Returns whether the calling thread is the GUI thread, which is the only
+ * thread where pixmaps can be safely created and shared.
+ */
+TILEDSHARED_EXPORT bool isGuiThread();
+
+} // namespace Tiled
@@ -28,6 +28,8 @@
  */
 
 #include "imagelayer.h"
+
+#include "imagecache.h"
 #include "map.h"
 
 #include <QBitmap>
@@ -58,7 +60,7 @@ bool ImageLayer::loadFromImage(const QImage &image, const QString &fileName)
         return false;
     }
 
-    mImage = QPixmap::fromImage(image);
+    mImage = ImageCache::toPixmap(image, fileName);
 
     if (mTransparentColor.isValid()) {
         const QImage mask = image.createMaskFromColor(mTransparentColor.rgb());
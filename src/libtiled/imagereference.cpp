@@ -20,6 +20,8 @@
 
 #include "imagereference.h"
 
+#include "imagecache.h"
+
 namespace Tiled {
 
 bool ImageReference::hasImage() const
@@ -30,7 +32,7 @@ bool ImageReference::hasImage() const
 QImage Tiled::ImageReference::create() const
 {
     if (!source.isEmpty())
-        return QImage(source);
+        return ImageCache::loadImage(source);
     else if (!data.isEmpty())
         return QImage::fromData(data, format);
 
@@ -237,7 +237,7 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
     // Determine whether the current row is shifted half a tile to the right
     bool shifted = inUpperHalf ^ inLeftHalf;
 
-    CellRenderer renderer(painter);
+    CellRenderer renderer(painter, renderImages());
 
     for (int y = startPos.y() * 2; y - tileHeight * 2 < rect.bottom() * 2;
          y += tileHeight)
@@ -301,8 +301,8 @@ void IsometricRenderer::drawMapObject(QPainter *painter,
     if (!cell.isEmpty()) {
         const QPointF pos = pixelToScreenCoords(object->position());
 
-        CellRenderer(painter).render(cell, pos, object->size(),
-                                     CellRenderer::BottomCenter);
+        CellRenderer(painter, renderImages()).render(cell, pos, object->size(),
+                                                     CellRenderer::BottomCenter);
 
         if (testFlag(ShowTileObjectOutlines)) {
             QSizeF imgSize;
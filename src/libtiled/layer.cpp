@@ -138,6 +138,31 @@ QPointF Layer::totalOffset() const
     return offset;
 }
 
+void Layer::setName(const QString &name)
+{
+    if (mName == name)
+        return;
+
+    mName = name;
+
+    if (mMap)
+        mMap->invalidateLayerIndex();
+}
+
+void Layer::setMap(Map *map)
+{
+    if (mMap == map)
+        return;
+
+    if (mMap)
+        mMap->invalidateLayerIndex();
+
+    mMap = map;
+
+    if (mMap)
+        mMap->invalidateLayerIndex();
+}
+
 /**
  * A helper function for initializing the members of the given instance to
  * those of this layer. Used by subclasses when cloning.
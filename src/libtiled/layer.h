@@ -79,7 +79,7 @@ public:
     /**
      * Sets the name of this layer.
      */
-    void setName(const QString &name) { mName = name; }
+    void setName(const QString &name);
 
     /**
      * Returns the opacity of this layer.
@@ -213,7 +213,7 @@ protected:
      * Sets the map this layer is part of. Should only be called from the
      * Map class.
      */
-    virtual void setMap(Map *map) { mMap = map; }
+    virtual void setMap(Map *map);
     void setParentLayer(GroupLayer *groupLayer) { mParentLayer = groupLayer; }
 
     Layer *initializeClone(Layer *clone) const;
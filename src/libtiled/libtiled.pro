@@ -32,6 +32,7 @@ SOURCES += compression.cpp \
     gidmapper.cpp \
     grouplayer.cpp \
     hexagonalrenderer.cpp \
+    imagecache.cpp \
     imagelayer.cpp \
     imagereference.cpp \
     isometricrenderer.cpp \
@@ -61,6 +62,7 @@ HEADERS += compression.h \
     gidmapper.h \
     grouplayer.h \
     hexagonalrenderer.h \
+    imagecache.h \
     imagelayer.h \
     imagereference.h \
     isometricrenderer.h \
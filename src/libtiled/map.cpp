@@ -53,6 +53,7 @@ Map::Map(Orientation orientation,
     mStaggerAxis(StaggerY),
     mStaggerIndex(StaggerOdd),
     mDrawMarginsDirty(true),
+    mLayerIndexDirty(true),
     mLayerDataFormat(Base64Zlib),
     mNextObjectId(1)
 {
@@ -72,6 +73,7 @@ Map::Map(const Map &map):
     mBackgroundColor(map.mBackgroundColor),
     mDrawMargins(map.mDrawMargins),
     mDrawMarginsDirty(map.mDrawMarginsDirty),
+    mLayerIndexDirty(true),
     mTilesets(map.mTilesets),
     mLayerDataFormat(map.mLayerDataFormat),
     mNextObjectId(1)
@@ -96,6 +98,33 @@ QMargins Map::drawMargins() const
     return mDrawMargins;
 }
 
+/**
+ * Makes sure the draw margins of this map and of its tile layers are
+ * recomputed when they are next requested.
+ */
+void Map::invalidateDrawMargins()
+{
+    mDrawMarginsDirty = true;
+
+    LayerIterator iterator(this);
+    while (Layer *layer = iterator.next())
+        if (TileLayer *tl = layer->asTileLayer())
+            tl->invalidateDrawMargins();
+}
+
+/**
+ * Makes sure the spatial indexes of the object groups of this map are rebuilt
+ * when they are next queried. Needed when the size of the tiles used by tile
+ * objects changed.
+ */
+void Map::invalidateObjectIndexes()
+{
+    LayerIterator iterator(this);
+    while (Layer *layer = iterator.next())
+        if (ObjectGroup *og = layer->asObjectGroup())
+            og->invalidateIndex();
+}
+
 static QMargins maxMargins(const QMargins &a,
                            const QMargins &b)
 {
@@ -190,24 +219,55 @@ QList<TileLayer*> Map::tileLayers() const
 
 void Map::addLayer(Layer *layer)
 {
-    adoptLayer(layer);
-    mLayers.append(layer);
+    insertLayer(mLayers.size(), layer);
 }
 
 int Map::indexOfLayer(const QString &layerName, unsigned layertypes) const
 {
-    for (int index = 0; index < mLayers.size(); index++)
-        if (layerAt(index)->name() == layerName
-                && (layertypes & layerAt(index)->layerType()))
+    updateLayerIndex();
+
+    const auto it = mTopLevelLayerIndices.constFind(layerName);
+    if (it == mTopLevelLayerIndices.constEnd())
+        return -1;
+
+    for (int index : it.value())
+        if (layertypes & layerAt(index)->layerType())
             return index;
 
     return -1;
 }
 
+Layer *Map::findLayer(const QString &layerName, unsigned layerTypes) const
+{
+    updateLayerIndex();
+
+    const auto it = mLayersByName.constFind(layerName);
+    if (it == mLayersByName.constEnd())
+        return nullptr;
+
+    for (Layer *layer : it.value())
+        if (layerTypes & layer->layerType())
+            return layer;
+
+    return nullptr;
+}
+
 void Map::insertLayer(int index, Layer *layer)
 {
+    const bool appendToIndex = !mLayerIndexDirty &&
+            index == mLayers.size() &&
+            !layer->isGroupLayer();
+
     adoptLayer(layer);
     mLayers.insert(index, layer);
+
+    // Appending a single layer doesn't require rebuilding the index, which
+    // keeps adding many layers in a row cheap.
+    if (appendToIndex) {
+        mTopLevelLayerIndices[layer->name()].append(index);
+        mLayersByName[layer->name()].append(layer);
+        mLayerIndexDirty = false;
+    }
 }
 
 void Map::adoptLayer(Layer *layer)
@@ -218,6 +278,27 @@ void Map::adoptLayer(Layer *layer)
         initializeObjectIds(*group);
 }
 
+/**
+ * Rebuilds the index of the layers by name, when it is out of date.
+ */
+void Map::updateLayerIndex() const
+{
+    if (!mLayerIndexDirty)
+        return;
+
+    mTopLevelLayerIndices.clear();
+    mLayersByName.clear();
+
+    for (int index = 0; index < mLayers.size(); ++index)
+        mTopLevelLayerIndices[mLayers.at(index)->name()].append(index);
+
+    LayerIterator iterator(this);
+    while (Layer *layer = iterator.next())
+        mLayersByName[layer->name()].append(layer);
+
+    mLayerIndexDirty = false;
+}
+
 Layer *Map::takeLayerAt(int index)
 {
     Layer *layer = mLayers.takeAt(index);
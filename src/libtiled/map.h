@@ -35,9 +35,11 @@
 #include "tileset.h"
 
 #include <QColor>
+#include <QHash>
 #include <QList>
 #include <QMargins>
 #include <QSize>
+#include <QVector>
 
 namespace Tiled {
 
@@ -213,6 +215,8 @@ public:
     QMargins drawMargins() const;
     void invalidateDrawMargins();
 
+    void invalidateObjectIndexes();
+
     QMargins computeLayerOffsetMargins() const;
 
     /**
@@ -265,10 +269,24 @@ public:
      *
      * The second optional parameter specifies the layer types which are
      * searched.
+     *
+     * Only the top-level layers are searched. Use findLayer() to also find
+     * layers within group layers.
      */
     int indexOfLayer(const QString &layerName,
                      unsigned layerTypes = Layer::AnyLayerType) const;
 
+    /**
+     * Returns the first layer given by \a layerName, in the order of
+     * LayerIterator, or null if no layer with that name is found. Layers
+     * within group layers are included.
+     *
+     * The second optional parameter specifies the layer types which are
+     * searched.
+     */
+    Layer *findLayer(const QString &layerName,
+                     unsigned layerTypes = Layer::AnyLayerType) const;
+
     /**
      * Adds a layer to this map, inserting it at the given index.
      */
@@ -369,9 +387,13 @@ public:
 
 private:
     friend class GroupLayer;    // so it cal call adoptLayer
+    friend class Layer;         // so it can call invalidateLayerIndex
 
     void adoptLayer(Layer *layer);
 
+    void invalidateLayerIndex() { mLayerIndexDirty = true; }
+    void updateLayerIndex() const;
+
     void recomputeDrawMargins() const;
 
     Orientation mOrientation;
@@ -387,6 +409,12 @@ private:
     mutable QMargins mDrawMargins;
     mutable bool mDrawMarginsDirty;
     QList<Layer*> mLayers;
+
+    // Index of the layers by name, rebuilt when needed
+    mutable QHash<QString, QVector<int>> mTopLevelLayerIndices;
+    mutable QHash<QString, QVector<Layer*>> mLayersByName;
+    mutable bool mLayerIndexDirty;
+
     QVector<SharedTileset> mTilesets;
     LayerDataFormat mLayerDataFormat;
     int mNextObjectId;
@@ -423,11 +451,6 @@ inline void Map::setStaggerIndex(StaggerIndex staggerIndex)
     mStaggerIndex = staggerIndex;
 }
 
-inline void Map::invalidateDrawMargins()
-{
-    mDrawMarginsDirty = true;
-}
-
 /**
  * Sets the next id to be used for objects on this map.
  */
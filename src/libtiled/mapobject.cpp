@@ -105,6 +105,15 @@ void MapObject::setTextData(const TextData &textData)
     mTextData = textData;
 }
 
+/**
+ * Keeps the spatial index of the object group up to date.
+ */
+void MapObject::geometryChanged()
+{
+    if (mObjectGroup)
+        mObjectGroup->objectGeometryChanged(this);
+}
+
 /**
  * Shortcut to getting a QRectF from position() and size() that uses cell tile if present.
  */
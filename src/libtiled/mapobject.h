@@ -180,6 +180,8 @@ public:
     MapObject *clone() const;
 
 private:
+    void geometryChanged();
+
     int mId;
     QString mName;
     QString mType;
@@ -250,7 +252,10 @@ inline const QPointF &MapObject::position() const
  * Sets the position of this object.
  */
 inline void MapObject::setPosition(const QPointF &pos)
-{ mPos = pos; }
+{
+    mPos = pos;
+    geometryChanged();
+}
 
 /**
  * Returns the x position of this object.
@@ -262,7 +267,10 @@ inline qreal MapObject::x() const
  * Sets the x position of this object.
  */
 inline void MapObject::setX(qreal x)
-{ mPos.setX(x); }
+{
+    mPos.setX(x);
+    geometryChanged();
+}
 
 /**
  * Returns the y position of this object.
@@ -274,7 +282,10 @@ inline qreal MapObject::y() const
  * Sets the x position of this object.
  */
 inline void MapObject::setY(qreal y)
-{ mPos.setY(y); }
+{
+    mPos.setY(y);
+    geometryChanged();
+}
 
 /**
  * Returns the size of this object.
@@ -286,7 +297,10 @@ inline const QSizeF &MapObject::size() const
  * Sets the size of this object.
  */
 inline void MapObject::setSize(const QSizeF &size)
-{ mSize = size; }
+{
+    mSize = size;
+    geometryChanged();
+}
 
 inline void MapObject::setSize(qreal width, qreal height)
 { setSize(QSizeF(width, height)); }
@@ -301,7 +315,10 @@ inline qreal MapObject::width() const
  * Sets the width of this object.
  */
 inline void MapObject::setWidth(qreal width)
-{ mSize.setWidth(width); }
+{
+    mSize.setWidth(width);
+    geometryChanged();
+}
 
 /**
  * Returns the height of this object.
@@ -313,7 +330,10 @@ inline qreal MapObject::height() const
  * Sets the height of this object.
  */
 inline void MapObject::setHeight(qreal height)
-{ mSize.setHeight(height); }
+{
+    mSize.setHeight(height);
+    geometryChanged();
+}
 
 /**
  * Sets the position and size of this object.
@@ -322,6 +342,7 @@ inline void MapObject::setBounds(const QRectF &bounds)
 {
     mPos = bounds.topLeft();
     mSize = bounds.size();
+    geometryChanged();
 }
 
 /**
@@ -344,7 +365,10 @@ inline const QPolygonF &MapObject::polygon() const
  * \sa setShape()
  */
 inline void MapObject::setPolygon(const QPolygonF &polygon)
-{ mPolygon = polygon; }
+{
+    mPolygon = polygon;
+    geometryChanged();
+}
 
 /**
  * Returns the shape of the object.
@@ -377,7 +401,10 @@ inline const Cell &MapObject::cell() const
  * \warning The object shape is ignored for tile objects!
  */
 inline void MapObject::setCell(const Cell &cell)
-{ mCell = cell; }
+{
+    mCell = cell;
+    geometryChanged();
+}
 
 /**
  * Returns the object group this object belongs to.
@@ -402,7 +429,10 @@ inline qreal MapObject::rotation() const
  * Sets the rotation of the object in degrees clockwise.
  */
 inline void MapObject::setRotation(qreal rotation)
-{ mRotation = rotation; }
+{
+    mRotation = rotation;
+    geometryChanged();
+}
 
 inline bool MapObject::isVisible() const
 { return mVisible; }
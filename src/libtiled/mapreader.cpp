@@ -33,6 +33,7 @@
 #include "compression.h"
 #include "gidmapper.h"
 #include "grouplayer.h"
+#include "imagecache.h"
 #include "imagelayer.h"
 #include "objectgroup.h"
 #include "map.h"
@@ -46,6 +47,9 @@
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 #include <QVector>
 #include <QXmlStreamReader>
 
@@ -55,6 +59,47 @@ using namespace Tiled::Internal;
 namespace Tiled {
 namespace Internal {
 
+/**
+ * Decodes an image in a worker thread, while the XML is still being parsed.
+ * Releases the given semaphore when done.
+ */
+class DecodeImageTask : public QRunnable
+{
+public:
+    DecodeImageTask(const ImageReference &reference, QSemaphore &done)
+        : mReference(reference)
+        , mDone(done)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        mImage = mReference.create();
+        mDone.release();
+    }
+
+    const ImageReference &reference() const { return mReference; }
+    const QImage &image() const { return mImage; }
+
+private:
+    const ImageReference mReference;
+    QImage mImage;
+    QSemaphore &mDone;
+};
+
+/**
+ * An image being decoded, along with what it should be assigned to. Either
+ * the tile, the tileset or the image layer.
+ */
+struct PendingImage
+{
+    DecodeImageTask *task;
+    SharedTileset tileset;
+    Tile *tile;
+    ImageLayer *imageLayer;
+};
+
 class MapReaderPrivate
 {
     Q_DECLARE_TR_FUNCTIONS(MapReader)
@@ -64,9 +109,15 @@ class MapReaderPrivate
 public:
     MapReaderPrivate(MapReader *mapReader):
         p(mapReader),
-        mReadingExternalTileset(false)
+        mReadingExternalTileset(false),
+        mAssignImages(true)
     {}
 
+    ~MapReaderPrivate()
+    {
+        discardImages();
+    }
+
     Map *readMap(QIODevice *device, const QString &path);
     SharedTileset readTileset(QIODevice *device, const QString &path);
 
@@ -94,6 +145,8 @@ private:
                                const QByteArray &data,
                                Map::LayerDataFormat format);
     void decodeCSVLayerData(TileLayer &tileLayer, QStringRef text);
+    void reportDecodeError(const TileLayer &tileLayer,
+                           GidMapper::DecodeError error);
 
     /**
      * Returns the cell for the given global tile ID. Errors are raised with
@@ -120,6 +173,13 @@ private:
     Properties readProperties();
     void readProperty(Properties *properties);
 
+    bool canDeferImage(const ImageReference &reference) const;
+    void decodeImage(const ImageReference &reference,
+                     const PendingImage &pending);
+    void finishDecodingImages();
+    void assignImages();
+    void discardImages();
+
     MapReader *p;
 
     QString mError;
@@ -127,6 +187,10 @@ private:
     QScopedPointer<Map> mMap;
     GidMapper mGidMapper;
     bool mReadingExternalTileset;
+    bool mAssignImages;
+
+    QVector<PendingImage> mPendingImages;
+    QSemaphore mDecodedImages;
 
     QXmlStreamReader xml;
 };
@@ -134,8 +198,31 @@ private:
 } // namespace Internal
 } // namespace Tiled
 
+/**
+ * Sets the width and height of tile objects that have no size to the size of
+ * their tile.
+ */
+static void fixTileObjectSizes(Map *map)
+{
+    LayerIterator iterator(map);
+    while (Layer *layer = iterator.next()) {
+        if (ObjectGroup *objectGroup = layer->asObjectGroup()) {
+            for (MapObject *object : *objectGroup) {
+                if (const Tile *tile = object->cell().tile()) {
+                    const QSizeF tileSize = tile->size();
+                    if (object->width() == 0)
+                        object->setWidth(tileSize.width());
+                    if (object->height() == 0)
+                        object->setHeight(tileSize.height());
+                }
+            }
+        }
+    }
+}
+
 Map *MapReaderPrivate::readMap(QIODevice *device, const QString &path)
 {
+    discardImages();
     mError.clear();
     mPath = path;
     Map *map = nullptr;
@@ -154,6 +241,7 @@ Map *MapReaderPrivate::readMap(QIODevice *device, const QString &path)
 
 SharedTileset MapReaderPrivate::readTileset(QIODevice *device, const QString &path)
 {
+    discardImages();
     mError.clear();
     mPath = path;
     SharedTileset tileset;
@@ -166,6 +254,12 @@ SharedTileset MapReaderPrivate::readTileset(QIODevice *device, const QString &pa
     else
         xml.raiseError(tr("Not a tileset file."));
 
+    // Wait for the images, which have been decoding in the meantime
+    finishDecodingImages();
+
+    if (xml.hasError())
+        discardImages();
+
     mReadingExternalTileset = false;
     return tileset;
 }
@@ -265,32 +359,16 @@ Map *MapReaderPrivate::readMap()
             readUnknownElement();
     }
 
+    // Wait for the images, which have been decoding in the meantime
+    finishDecodingImages();
+
     // Clean up in case of error
     if (xml.hasError()) {
+        discardImages();
         mMap.reset();
-    } else {
-        // Try to load the tileset images
-        auto tilesets = mMap->tilesets();
-        for (SharedTileset &tileset : tilesets) {
-            if (!tileset->isCollection() && tileset->fileName().isEmpty())
-                tileset->loadImage();
-        }
-
-        // Fix up sizes of tile objects
-        LayerIterator iterator(mMap.data());
-        while (Layer *layer = iterator.next()) {
-            if (ObjectGroup *objectGroup = layer->asObjectGroup()) {
-                for (MapObject *object : *objectGroup) {
-                    if (const Tile *tile = object->cell().tile()) {
-                        const QSizeF tileSize = tile->size();
-                        if (object->width() == 0)
-                            object->setWidth(tileSize.width());
-                        if (object->height() == 0)
-                            object->setHeight(tileSize.height());
-                    }
-                }
-            }
-        }
+    } else if (mAssignImages) {
+        // Otherwise this happens in MapReader::assignImages()
+        fixTileObjectSizes(mMap.data());
     }
 
     return mMap.take();
@@ -415,14 +493,13 @@ void MapReaderPrivate::readTilesetTile(Tileset &tileset)
             tile->mergeProperties(readProperties());
         } else if (xml.name() == QLatin1String("image")) {
             ImageReference imageReference = readImage();
-            if (imageReference.hasImage()) {
-                QImage image = imageReference.create();
-                if (image.isNull()) {
-                    if (imageReference.source.isEmpty())
-                        xml.raiseError(tr("Error reading embedded image for tile %1").arg(id));
-                }
-                tileset.setTileImage(tile, QPixmap::fromImage(image),
-                                     imageReference.source);
+            if (canDeferImage(imageReference)) {
+                tileset.setDeferredTileImage(tile,
+                                             imageReference.source,
+                                             imageReference.size);
+            } else if (imageReference.hasImage()) {
+                PendingImage pending = { nullptr, tileset.sharedPointer(), tile, nullptr };
+                decodeImage(imageReference, pending);
             }
         } else if (xml.name() == QLatin1String("objectgroup")) {
             tile->setObjectGroup(readObjectGroup());
@@ -478,7 +555,11 @@ void MapReaderPrivate::readTilesetImage(Tileset &tileset)
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("image"));
 
-    tileset.setImageReference(readImage());
+    const ImageReference imageReference = readImage();
+    tileset.setImageReference(imageReference);
+
+    PendingImage pending = { nullptr, tileset.sharedPointer(), nullptr, nullptr };
+    decodeImage(imageReference, pending);
 }
 
 ImageReference MapReaderPrivate::readImage()
@@ -685,7 +766,12 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer &tileLayer,
                                              Map::LayerDataFormat format)
 {
     GidMapper::DecodeError error = mGidMapper.decodeLayerData(tileLayer, data, format);
+    reportDecodeError(tileLayer, error);
+}
 
+void MapReaderPrivate::reportDecodeError(const TileLayer &tileLayer,
+                                         GidMapper::DecodeError error)
+{
     switch (error) {
     case GidMapper::CorruptLayerData:
         xml.raiseError(tr("Corrupt layer data for layer '%1'").arg(tileLayer.name()));
@@ -701,31 +787,72 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer &tileLayer,
     }
 }
 
+static bool isCSVWhitespace(QChar c)
+{
+    return c == QLatin1Char(' ') || c == QLatin1Char('\n') ||
+            c == QLatin1Char('\r') || c == QLatin1Char('\t');
+}
+
+/**
+ * Parses the comma-separated GIDs in place, without creating a string for
+ * each of them. Whitespace around the numbers is ignored.
+ */
 void MapReaderPrivate::decodeCSVLayerData(TileLayer &tileLayer, QStringRef text)
 {
-    QString trimText = text.trimmed().toString();
-    QStringList tiles = trimText.split(QLatin1Char(','));
+    const int width = tileLayer.width();
+    const int count = width * tileLayer.height();
+
+    QVector<unsigned> gids;
+    gids.reserve(count);
+
+    const QChar *c = text.unicode();
+    const QChar *end = c + text.size();
+
+    while (true) {
+        while (c != end && isCSVWhitespace(*c))
+            ++c;
+
+        quint64 gid = 0;
+        const QChar *digitsStart = c;
+        while (c != end && c->unicode() >= '0' && c->unicode() <= '9' && gid <= 0xFFFFFFFF) {
+            gid = gid * 10 + (c->unicode() - '0');
+            ++c;
+        }
+        const bool conversionOk = c != digitsStart && gid <= 0xFFFFFFFF;
+
+        while (c != end && isCSVWhitespace(*c))
+            ++c;
+
+        if (gids.size() == count) {
+            xml.raiseError(tr("Corrupt layer data for layer '%1'")
+                           .arg(tileLayer.name()));
+            return;
+        }
+
+        if (!conversionOk || (c != end && *c != QLatin1Char(','))) {
+            const int index = gids.size();
+            xml.raiseError(
+                    tr("Unable to parse tile at (%1,%2) on layer '%3'")
+                           .arg(index % width + 1).arg(index / width + 1)
+                           .arg(tileLayer.name()));
+            return;
+        }
+
+        gids.append(unsigned(gid));
 
-    if (tiles.length() != tileLayer.width() * tileLayer.height()) {
+        if (c == end)
+            break;
+
+        ++c;    // skip the comma
+    }
+
+    if (gids.size() != count) {
         xml.raiseError(tr("Corrupt layer data for layer '%1'")
                        .arg(tileLayer.name()));
         return;
     }
 
-    for (int y = 0; y < tileLayer.height(); y++) {
-        for (int x = 0; x < tileLayer.width(); x++) {
-            bool conversionOk;
-            const unsigned gid = tiles.at(y * tileLayer.width() + x)
-                    .toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer.name()));
-                return;
-            }
-            tileLayer.setCell(x, y, cellForGid(gid));
-        }
-    }
+    reportDecodeError(tileLayer, mGidMapper.decodeLayerData(tileLayer, gids));
 }
 
 Cell MapReaderPrivate::cellForGid(unsigned gid)
@@ -825,9 +952,11 @@ void MapReaderPrivate::readImageLayerImage(ImageLayer &imageLayer)
         imageLayer.setTransparentColor(QColor(trans));
     }
 
-    source = p->resolveReference(source, mPath);
+    ImageReference imageReference;
+    imageReference.source = p->resolveReference(source, mPath);
 
-    imageLayer.loadFromImage(source);
+    PendingImage pending = { nullptr, SharedTileset(), nullptr, &imageLayer };
+    decodeImage(imageReference, pending);
 
     xml.skipCurrentElement();
 }
@@ -1091,6 +1220,133 @@ MapReader::~MapReader()
     delete d;
 }
 
+void MapReader::setAssignImages(bool enabled)
+{
+    d->mAssignImages = enabled;
+}
+
+void MapReader::assignImages(Map *map)
+{
+    d->assignImages();
+
+    if (map)
+        fixTileObjectSizes(map);
+}
+
+static bool deferTileImagesEnabled = true;
+
+void MapReader::setDeferTileImages(bool enabled)
+{
+    deferTileImagesEnabled = enabled;
+}
+
+bool MapReader::deferTileImages()
+{
+    return deferTileImagesEnabled;
+}
+
+/**
+ * Returns whether loading the image given by \a reference can be left until
+ * its tile is first displayed. This requires the size of the image to be
+ * known up front. Missing files are loaded right away, so that they still
+ * show up as broken links.
+ *
+ * Deferred images are only loaded in the GUI thread, so when reading from
+ * another thread images are always loaded right away.
+ *
+ * \sa MapReader::setDeferTileImages()
+ */
+bool MapReaderPrivate::canDeferImage(const ImageReference &reference) const
+{
+    return deferTileImagesEnabled &&
+            !reference.source.isEmpty() &&
+            !reference.size.isEmpty() &&
+            isGuiThread() &&
+            QFile::exists(reference.source);
+}
+
+/**
+ * Starts decoding the image given by \a reference in the global thread pool.
+ * It is assigned to its target once finishDecodingImages() is called.
+ */
+void MapReaderPrivate::decodeImage(const ImageReference &reference,
+                                   const PendingImage &pending)
+{
+    PendingImage pendingImage = pending;
+    pendingImage.task = new DecodeImageTask(reference, mDecodedImages);
+    mPendingImages.append(pendingImage);
+
+    // When reading from a worker thread, decode right away. Waiting for the
+    // thread pool from one of its own threads could deadlock.
+    if (isGuiThread())
+        QThreadPool::globalInstance()->start(pendingImage.task);
+    else
+        pendingImage.task->run();
+}
+
+/**
+ * Waits for all images to be decoded and, unless disabled, assigns them to
+ * their tile, tileset or image layer.
+ */
+void MapReaderPrivate::finishDecodingImages()
+{
+    if (mPendingImages.isEmpty())
+        return;
+
+    mDecodedImages.acquire(mPendingImages.size());
+
+    for (const PendingImage &pending : mPendingImages) {
+        const ImageReference &reference = pending.task->reference();
+        if (pending.tile && pending.task->image().isNull() &&
+                reference.source.isEmpty() && !xml.hasError()) {
+            xml.raiseError(tr("Error reading embedded image for tile %1")
+                           .arg(pending.tile->id()));
+        }
+    }
+
+    if (mAssignImages)
+        assignImages();
+}
+
+/**
+ * Assigns the decoded images to their tile, tileset or image layer. This
+ * needs to happen in the GUI thread, since it involves creating pixmaps.
+ */
+void MapReaderPrivate::assignImages()
+{
+    for (const PendingImage &pending : mPendingImages) {
+        const ImageReference &reference = pending.task->reference();
+        const QImage &image = pending.task->image();
+
+        if (pending.tile) {
+            pending.tileset->setTileImage(pending.tile,
+                                          ImageCache::toPixmap(image, reference.source),
+                                          reference.source);
+        } else if (pending.tileset) {
+            pending.tileset->loadFromImage(image, reference.source);
+        } else if (pending.imageLayer) {
+            pending.imageLayer->loadFromImage(image, reference.source);
+        }
+
+        delete pending.task;
+    }
+
+    mPendingImages.clear();
+}
+
+/**
+ * Drops the decoded images that were not assigned, for example because
+ * reading failed.
+ */
+void MapReaderPrivate::discardImages()
+{
+    for (const PendingImage &pending : mPendingImages)
+        delete pending.task;
+
+    mPendingImages.clear();
+}
+
+
 Map *MapReader::readMap(QIODevice *device, const QString &path)
 {
     return d->readMap(device, path);
@@ -1107,11 +1363,7 @@ Map *MapReader::readMap(const QString &fileName)
 
 SharedTileset MapReader::readTileset(QIODevice *device, const QString &path)
 {
-    SharedTileset tileset = d->readTileset(device, path);
-    if (tileset && !tileset->isCollection())
-        tileset->loadImage();
-
-    return tileset;
+    return d->readTileset(device, path);
 }
 
 SharedTileset MapReader::readTileset(const QString &fileName)
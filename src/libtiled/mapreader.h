@@ -94,6 +94,35 @@ public:
      */
     QString errorString() const;
 
+    /**
+     * Sets whether the images of image collection tiles may be loaded once
+     * they are first needed, rather than while reading. Enabled by default.
+     *
+     * Deferred images are only loaded in the GUI thread, so applications
+     * rendering maps in other threads should disable this.
+     */
+    static void setDeferTileImages(bool enabled);
+    static bool deferTileImages();
+
+    /**
+     * Sets whether the decoded images are assigned to their tiles, tilesets
+     * and image layers while reading. Enabled by default.
+     *
+     * Assigning the images involves creating pixmaps, which is only safe in
+     * the GUI thread. When disabled, maps and tilesets can be read in other
+     * threads, and assignImages() needs to be called in the GUI thread once
+     * reading is done.
+     */
+    void setAssignImages(bool enabled);
+
+    /**
+     * Assigns the images decoded by the last call to readMap() or
+     * readTileset(), when setAssignImages() was disabled. The \a map should
+     * be the one that was read, so that the sizes of its tile objects can be
+     * determined.
+     */
+    void assignImages(Map *map = nullptr);
+
 protected:
     /**
      * Called for each \a reference to an external file. Should return the path
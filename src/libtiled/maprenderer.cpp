@@ -49,7 +49,10 @@ void MapRenderer::drawImageLayer(QPainter *painter,
 {
     Q_UNUSED(exposed)
 
-    painter->drawPixmap(QPointF(), imageLayer->image());
+    if (mRenderImages)
+        painter->drawImage(QPointF(), mRenderImages->imageLayers.value(imageLayer));
+    else
+        painter->drawPixmap(QPointF(), imageLayer->image());
 }
 
 void MapRenderer::setFlag(RenderFlag flag, bool enabled)
@@ -106,10 +109,15 @@ static bool hasOpenGLEngine(const QPainter *painter)
             type == QPaintEngine::OpenGL2);
 }
 
-CellRenderer::CellRenderer(QPainter *painter)
+/**
+ * Creates a cell renderer drawing with the given \a painter. When
+ * \a renderImages is given, tiles are drawn from those images instead of
+ * their pixmaps.
+ */
+CellRenderer::CellRenderer(QPainter *painter, const RenderImages *renderImages)
     : mPainter(painter)
-    , mTile(nullptr)
     , mIsOpenGL(hasOpenGLEngine(painter))
+    , mRenderImages(renderImages)
 {
 }
 
@@ -117,10 +125,12 @@ CellRenderer::CellRenderer(QPainter *painter)
  * Renders a \a cell with the given \a origin at \a pos, taking into account
  * the flipping and tile offset.
  *
- * For performance reasons, the actual drawing is delayed until a different
- * kind of tile has to be drawn. For this reason it is necessary to call
- * flush when finished doing drawCell calls. This function is also called by
- * the destructor so usually an explicit call is not needed.
+ * For performance reasons, the actual drawing is delayed until a tile using a
+ * different image has to be drawn. Since tiles cut from a tileset image share
+ * that image, this usually means until a different tileset is used. For this
+ * reason it is necessary to call flush when finished doing drawCell calls.
+ * This function is also called by the destructor so usually an explicit call
+ * is not needed.
  */
 void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &size, Origin origin)
 {
@@ -137,11 +147,29 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
     if (!tile)
         return;
 
-    if (mTile != tile)
-        flush();
+    // Taken by value, since a deferred tile image may be released while
+    // another tile's image is loaded
+    QPixmap image;
+    QRect imageRect;
+    const RenderImages::TileImage *renderImage = nullptr;
+
+    if (mRenderImages) {
+        auto it = mRenderImages->tiles.find(tile);
+        if (it == mRenderImages->tiles.end() || it->image.isNull())
+            return;
+
+        renderImage = &it.value();
+        imageRect = renderImage->rect;
+    } else {
+        image = tile->image();
+        imageRect = tile->imageRect();
+
+        // Tiles sharing the same image (usually the tileset image) are batched
+        if (!mFragments.isEmpty() && mImage.cacheKey() != image.cacheKey())
+            flush();
+    }
 
-    const QPixmap &image = tile->image();
-    const QSizeF imageSize = image.size();
+    const QSizeF imageSize = imageRect.size();
     const QSizeF scale(size.width() / imageSize.width(), size.height() / imageSize.height());
     const QPoint offset = tile->offset();
     const QPointF sizeHalf = QPointF(size.width() / 2, size.height() / 2);
@@ -152,8 +180,8 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
     QPainter::PixmapFragment fragment;
     fragment.x = pos.x() + (offset.x() * scale.width()) + sizeHalf.x();
     fragment.y = pos.y() + (offset.y() * scale.height()) + sizeHalf.y() - size.height();
-    fragment.sourceLeft = 0;
-    fragment.sourceTop = 0;
+    fragment.sourceLeft = imageRect.x();
+    fragment.sourceTop = imageRect.y();
     fragment.width = imageSize.width();
     fragment.height = imageSize.height();
     fragment.scaleX = flippedHorizontally ? -1 : 1;
@@ -180,14 +208,15 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
     fragment.scaleX = scale.width() * (flippedHorizontally ? -1 : 1);
     fragment.scaleY = scale.height() * (flippedVertically ? -1 : 1);
 
-    if (mIsOpenGL || (fragment.scaleX > 0 && fragment.scaleY > 0)) {
-        mTile = tile;
+    if (!renderImage && (mIsOpenGL || (fragment.scaleX > 0 && fragment.scaleY > 0))) {
+        mImage = image;
         mFragments.append(fragment);
         return;
     }
 
     // The Raster paint engine as of Qt 4.8.4 / 5.0.2 does not support
-    // drawing fragments with a negative scaling factor.
+    // drawing fragments with a negative scaling factor. Images can't be
+    // drawn as fragments at all.
 
     flush(); // make sure we drew all tiles so far
 
@@ -199,10 +228,13 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
 
     const QRectF target(fragment.width * -0.5, fragment.height * -0.5,
                         fragment.width, fragment.height);
-    const QRectF source(0, 0, fragment.width, fragment.height);
+    const QRectF source(imageRect);
 
     mPainter->setTransform(transform);
-    mPainter->drawPixmap(target, image, source);
+    if (renderImage)
+        mPainter->drawImage(target, renderImage->image, source);
+    else
+        mPainter->drawPixmap(target, image, source);
     mPainter->setTransform(oldTransform);
 }
 
@@ -211,13 +243,13 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
  */
 void CellRenderer::flush()
 {
-    if (!mTile)
+    if (mFragments.isEmpty())
         return;
 
     mPainter->drawPixmapFragments(mFragments.constData(),
                                   mFragments.size(),
-                                  mTile->image());
+                                  mImage);
 
-    mTile = nullptr;
+    mImage = QPixmap();
     mFragments.resize(0);
 }
@@ -30,6 +30,8 @@
 
 #include "tiled_global.h"
 
+#include <QHash>
+#include <QImage>
 #include <QPainter>
 
 namespace Tiled {
@@ -48,6 +50,26 @@ enum RenderFlag {
 
 Q_DECLARE_FLAGS(RenderFlags, RenderFlag)
 
+/**
+ * Images to draw in place of the pixmaps of tiles and image layers. Since
+ * pixmaps can only be used in the GUI thread, this allows rendering a copy of
+ * a map in another thread.
+ *
+ * Tiles without an image in \a tiles are not drawn. The rect of a tile image
+ * is the part of the image showing the tile.
+ */
+struct RenderImages
+{
+    struct TileImage
+    {
+        QImage image;
+        QRect rect;
+    };
+
+    QHash<const Tile*, TileImage> tiles;
+    QHash<const ImageLayer*, QImage> imageLayers;
+};
+
 /**
  * This interface is used for rendering tile layers and retrieving associated
  * metrics. The different implementations deal with different map
@@ -61,6 +83,7 @@ public:
         , mFlags(nullptr)
         , mObjectLineWidth(2)
         , mPainterScale(1)
+        , mRenderImages(nullptr)
     {}
 
     virtual ~MapRenderer() {}
@@ -211,6 +234,13 @@ public:
     RenderFlags flags() const { return mFlags; }
     void setFlags(RenderFlags flags) { mFlags = flags; }
 
+    /**
+     * Sets the images to draw instead of the pixmaps of tiles and image
+     * layers, or nullptr to draw the pixmaps. The images are not owned.
+     */
+    void setRenderImages(const RenderImages *renderImages) { mRenderImages = renderImages; }
+    const RenderImages *renderImages() const { return mRenderImages; }
+
     static QPolygonF lineToPolygon(const QPointF &start, const QPointF &end);
 
 private:
@@ -219,6 +249,7 @@ private:
     RenderFlags mFlags;
     qreal mObjectLineWidth;
     qreal mPainterScale;
+    const RenderImages *mRenderImages;
 };
 
 inline const Map *MapRenderer::map() const
@@ -258,7 +289,8 @@ public:
         BottomCenter
     };
 
-    explicit CellRenderer(QPainter *painter);
+    explicit CellRenderer(QPainter *painter,
+                          const RenderImages *renderImages = nullptr);
 
     ~CellRenderer() { flush(); }
 
@@ -267,9 +299,10 @@ public:
 
 private:
     QPainter * const mPainter;
-    const Tile *mTile;
+    QPixmap mImage;         // the image of the current batch
     QVector<QPainter::PixmapFragment> mFragments;
     const bool mIsOpenGL;
+    const RenderImages * const mRenderImages;
 };
 
 } // namespace Tiled
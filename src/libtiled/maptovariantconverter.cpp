@@ -295,6 +295,17 @@ QVariant MapToVariantConverter::toVariant(const TileLayer &tileLayer,
     switch (format) {
     case Map::XML:
     case Map::CSV: {
+        if (mCompactTileLayerData) {
+            QVector<unsigned> gids;
+            gids.reserve(tileLayer.width() * tileLayer.height());
+            for (int y = 0; y < tileLayer.height(); ++y)
+                for (int x = 0; x < tileLayer.width(); ++x)
+                    gids.append(mGidMapper.cellToGid(tileLayer.cellAt(x, y)));
+
+            tileLayerVariant[QLatin1String("data")] = QVariant::fromValue(gids);
+            break;
+        }
+
         QVariantList tileVariants;
         for (int y = 0; y < tileLayer.height(); ++y)
             for (int x = 0; x < tileLayer.width(); ++x)
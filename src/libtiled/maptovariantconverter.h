@@ -38,7 +38,18 @@ class TextData;
 class TILEDSHARED_EXPORT MapToVariantConverter
 {
 public:
-    MapToVariantConverter() {}
+    MapToVariantConverter()
+        : mCompactTileLayerData(false)
+    {}
+
+    /**
+     * Sets whether the data of tile layers in CSV format is stored as a
+     * single QVector<unsigned>, instead of as a QVariantList holding a
+     * QVariant for each tile. This takes a lot less memory, but needs to be
+     * supported by the consumer of the variant, like the JsonWriter.
+     */
+    void setCompactTileLayerData(bool compact)
+    { mCompactTileLayerData = compact; }
 
     /**
      * Converts the given \s map to a QVariant. The \a mapDir is used to
@@ -71,6 +82,7 @@ private:
 
     QDir mMapDir;
     GidMapper mGidMapper;
+    bool mCompactTileLayerData;
 };
 
 } // namespace Tiled
@@ -34,20 +34,83 @@
 #include "map.h"
 #include "mapobject.h"
 #include "tile.h"
+#include "tilelayer.h"
 
+#include <QTransform>
+
+#include <algorithm>
 #include <cmath>
 
 using namespace Tiled;
 
+// The size of the buckets of the spatial index, in pixels
+static const int BucketSize = 256;
+
+// Objects covering more buckets are checked for each query instead
+static const int MaxBucketsPerObject = 64;
+
+/**
+ * Returns the bounds under which the \a object is stored in the spatial
+ * index. These include its tile and polygon, and are rotated along with the
+ * object around its position.
+ */
+static QRectF indexBounds(const MapObject *object)
+{
+    const QPointF &pos = object->position();
+    QRectF bounds = object->bounds().normalized();
+
+    // Avoid QRectF::united, which ignores the size-less rects of points
+    auto unite = [&] (const QRectF &rect) {
+        bounds.setCoords(qMin(bounds.left(), rect.left()),
+                         qMin(bounds.top(), rect.top()),
+                         qMax(bounds.right(), rect.right()),
+                         qMax(bounds.bottom(), rect.bottom()));
+    };
+
+    if (!object->cell().isEmpty())
+        unite(object->boundsUseTile());
+    if (!object->polygon().isEmpty())
+        unite(object->polygon().boundingRect().translated(pos));
+
+    if (object->rotation() != 0) {
+        QTransform transform;
+        transform.translate(pos.x(), pos.y());
+        transform.rotate(object->rotation());
+        transform.translate(-pos.x(), -pos.y());
+        bounds = transform.mapRect(bounds);
+    }
+
+    return bounds;
+}
+
+static QRect bucketRange(const QRectF &bounds)
+{
+    auto bucket = [] (qreal coordinate) {
+        return static_cast<int>(std::floor(coordinate / BucketSize));
+    };
+
+    return QRect(QPoint(bucket(bounds.left()), bucket(bounds.top())),
+                 QPoint(bucket(bounds.right()), bucket(bounds.bottom())));
+}
+
+static qint64 bucketCount(const QRect &range)
+{
+    return qint64(range.width()) * range.height();
+}
+
 ObjectGroup::ObjectGroup()
     : Layer(ObjectGroupType, QString(), 0, 0)
     , mDrawOrder(TopDownOrder)
+    , mIndexed(false)
+    , mObjectOrderDirty(true)
 {
 }
 
 ObjectGroup::ObjectGroup(const QString &name, int x, int y)
     : Layer(ObjectGroupType, name, x, y)
     , mDrawOrder(TopDownOrder)
+    , mIndexed(false)
+    , mObjectOrderDirty(true)
 {
 }
 
@@ -62,6 +125,10 @@ void ObjectGroup::addObject(MapObject *object)
     object->setObjectGroup(this);
     if (mMap && object->id() == 0)
         object->setId(mMap->takeNextObjectId());
+    if (mIndexed)
+        indexObject(object);
+    if (!mObjectOrderDirty)
+        mObjectOrder.insert(object, mObjects.size() - 1);
 }
 
 void ObjectGroup::insertObject(int index, MapObject *object)
@@ -70,6 +137,9 @@ void ObjectGroup::insertObject(int index, MapObject *object)
     object->setObjectGroup(this);
     if (mMap && object->id() == 0)
         object->setId(mMap->takeNextObjectId());
+    if (mIndexed)
+        indexObject(object);
+    mObjectOrderDirty = true;
 }
 
 int ObjectGroup::removeObject(MapObject *object)
@@ -79,6 +149,9 @@ int ObjectGroup::removeObject(MapObject *object)
 
     mObjects.removeAt(index);
     object->setObjectGroup(nullptr);
+    if (mIndexed)
+        unindexObject(object);
+    mObjectOrderDirty = true;
     return index;
 }
 
@@ -86,6 +159,9 @@ void ObjectGroup::removeObjectAt(int index)
 {
     MapObject *object = mObjects.takeAt(index);
     object->setObjectGroup(nullptr);
+    if (mIndexed)
+        unindexObject(object);
+    mObjectOrderDirty = true;
 }
 
 void ObjectGroup::moveObjects(int from, int to, int count)
@@ -108,6 +184,8 @@ void ObjectGroup::moveObjects(int from, int to, int count)
 
     for (int i = 0; i < count; ++i)
         mObjects.insert(to + i, movingObjects.at(i));
+
+    mObjectOrderDirty = true;
 }
 
 QRectF ObjectGroup::objectsBoundingRect() const
@@ -118,6 +196,140 @@ QRectF ObjectGroup::objectsBoundingRect() const
     return boundingRect;
 }
 
+QList<MapObject*> ObjectGroup::objectsIntersecting(const QRectF &rect) const
+{
+    if (!mIndexed)
+        buildIndex();
+
+    const QRectF r = rect.normalized();
+    auto intersects = [&] (MapObject *object) {
+        const QRectF bounds = mIndexedBounds.value(object);
+        return bounds.left() <= r.right() && r.left() <= bounds.right() &&
+                bounds.top() <= r.bottom() && r.top() <= bounds.bottom();
+    };
+
+    QList<MapObject*> result;
+    const QRect buckets = bucketRange(r);
+
+    if (bucketCount(buckets) > MaxBucketsPerObject) {
+        // Large queries are cheaper to answer by checking all objects
+        for (MapObject *object : mObjects)
+            if (intersects(object))
+                result.append(object);
+        return result;
+    }
+
+    for (MapObject *object : mUnbucketedObjects)
+        if (intersects(object))
+            result.append(object);
+
+    for (int y = buckets.top(); y <= buckets.bottom(); ++y) {
+        for (int x = buckets.left(); x <= buckets.right(); ++x) {
+            auto it = mIndexBuckets.constFind(QPoint(x, y));
+            if (it == mIndexBuckets.constEnd())
+                continue;
+
+            for (MapObject *object : *it) {
+                if (!intersects(object))
+                    continue;
+
+                // Objects spanning several buckets are reported from the
+                // first bucket within the queried range
+                const QRect objectBuckets = bucketRange(mIndexedBounds.value(object));
+                if (qMax(objectBuckets.left(), buckets.left()) == x &&
+                        qMax(objectBuckets.top(), buckets.top()) == y) {
+                    result.append(object);
+                }
+            }
+        }
+    }
+
+    sortInObjectOrder(result);
+    return result;
+}
+
+void ObjectGroup::objectGeometryChanged(MapObject *object)
+{
+    if (!mIndexed)
+        return;
+
+    unindexObject(object);
+    indexObject(object);
+}
+
+void ObjectGroup::invalidateIndex()
+{
+    mIndexed = false;
+    mIndexBuckets.clear();
+    mIndexedBounds.clear();
+    mUnbucketedObjects.clear();
+}
+
+void ObjectGroup::buildIndex() const
+{
+    mIndexed = true;
+    for (MapObject *object : mObjects)
+        indexObject(object);
+}
+
+void ObjectGroup::indexObject(MapObject *object) const
+{
+    const QRectF bounds = indexBounds(object);
+    mIndexedBounds.insert(object, bounds);
+
+    const QRect buckets = bucketRange(bounds);
+    if (bucketCount(buckets) > MaxBucketsPerObject) {
+        mUnbucketedObjects.append(object);
+        return;
+    }
+
+    for (int y = buckets.top(); y <= buckets.bottom(); ++y)
+        for (int x = buckets.left(); x <= buckets.right(); ++x)
+            mIndexBuckets[QPoint(x, y)].append(object);
+}
+
+void ObjectGroup::unindexObject(MapObject *object) const
+{
+    const QRectF bounds = mIndexedBounds.take(object);
+
+    const QRect buckets = bucketRange(bounds);
+    if (bucketCount(buckets) > MaxBucketsPerObject) {
+        mUnbucketedObjects.removeOne(object);
+        return;
+    }
+
+    for (int y = buckets.top(); y <= buckets.bottom(); ++y) {
+        for (int x = buckets.left(); x <= buckets.right(); ++x) {
+            auto it = mIndexBuckets.find(QPoint(x, y));
+            it->removeOne(object);
+            if (it->isEmpty())
+                mIndexBuckets.erase(it);
+        }
+    }
+}
+
+/**
+ * Sorts the given \a objects of this group by their position in the list of
+ * objects, so that query results don't depend on the layout of the index.
+ */
+void ObjectGroup::sortInObjectOrder(QList<MapObject*> &objects) const
+{
+    if (objects.size() < 2)
+        return;
+
+    if (mObjectOrderDirty) {
+        mObjectOrder.clear();
+        mObjectOrder.reserve(mObjects.size());
+        for (int i = 0; i < mObjects.size(); ++i)
+            mObjectOrder.insert(mObjects.at(i), i);
+        mObjectOrderDirty = false;
+    }
+
+    std::sort(objects.begin(), objects.end(), [this] (MapObject *a, MapObject *b) {
+        return mObjectOrder.value(a) < mObjectOrder.value(b);
+    });
+}
+
 bool ObjectGroup::isEmpty() const
 {
     return mObjects.isEmpty();
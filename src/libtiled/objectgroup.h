@@ -35,8 +35,10 @@
 #include "layer.h"
 
 #include <QColor>
+#include <QHash>
 #include <QList>
 #include <QMetaType>
+#include <QRect>
 
 namespace Tiled {
 
@@ -133,6 +135,41 @@ public:
      */
     QRectF objectsBoundingRect() const;
 
+    /**
+     * Returns the objects whose bounds intersect the given \a rect, in pixel
+     * coordinates. The bounds include the tile and polygon of an object and
+     * take its rotation into account, so callers may need to do a more
+     * precise check. Objects on the edge of \a rect are included.
+     *
+     * The first call builds a spatial index of the objects, which is kept up
+     * to date as objects are added, removed, moved and resized. Queries are
+     * then proportional to the number of objects near \a rect.
+     *
+     * The objects are returned in the order in which they appear in
+     * objects().
+     */
+    QList<MapObject*> objectsIntersecting(const QRectF &rect) const;
+
+    /**
+     * Returns the objects whose bounds contain the given \a pos.
+     *
+     * \sa objectsIntersecting()
+     */
+    QList<MapObject*> objectsAt(const QPointF &pos) const
+    { return objectsIntersecting(QRectF(pos, QSizeF(0, 0))); }
+
+    /**
+     * Updates the spatial index after the geometry of the given \a object
+     * changed. Should only be called from the MapObject class.
+     */
+    void objectGeometryChanged(MapObject *object);
+
+    /**
+     * Makes sure the spatial index is rebuilt on the next query. Needs to be
+     * called when the size of the tiles used by tile objects changed.
+     */
+    void invalidateIndex();
+
     /**
      * Returns whether this object group contains any objects.
      */
@@ -191,9 +228,24 @@ protected:
     ObjectGroup *initializeClone(ObjectGroup *clone) const;
 
 private:
+    void buildIndex() const;
+    void indexObject(MapObject *object) const;
+    void unindexObject(MapObject *object) const;
+    void sortInObjectOrder(QList<MapObject*> &objects) const;
+
     QList<MapObject*> mObjects;
     QColor mColor;
     DrawOrder mDrawOrder;
+
+    // Spatial index, built on the first query
+    mutable bool mIndexed;
+    mutable QHash<QPoint, QList<MapObject*>> mIndexBuckets;
+    mutable QHash<MapObject*, QRectF> mIndexedBounds;
+    mutable QList<MapObject*> mUnbucketedObjects;   // spanning many buckets
+
+    // Position of each object in mObjects, for sorting query results
+    mutable bool mObjectOrderDirty;
+    mutable QHash<MapObject*, int> mObjectOrder;
 };
 
 
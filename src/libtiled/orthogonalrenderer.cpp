@@ -254,7 +254,7 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
     const QTransform savedTransform = painter->transform();
     painter->translate(layerPos);
 
-    CellRenderer renderer(painter);
+    CellRenderer renderer(painter, renderImages());
 
     Map::RenderOrder renderOrder = map()->renderOrder();
 
@@ -329,8 +329,8 @@ void OrthogonalRenderer::drawMapObject(QPainter *painter,
     const Cell &cell = object->cell();
 
     if (!cell.isEmpty()) {
-        CellRenderer(painter).render(cell, QPointF(), object->size(),
-                                     CellRenderer::BottomLeft);
+        CellRenderer(painter, renderImages()).render(cell, QPointF(), object->size(),
+                                                     CellRenderer::BottomLeft);
 
         if (testFlag(ShowTileObjectOutlines)) {
             QSizeF imgSize;
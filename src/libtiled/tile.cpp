@@ -28,15 +28,74 @@
 
 #include "tile.h"
 
+#include "imagecache.h"
 #include "objectgroup.h"
 #include "tileset.h"
 
+#include <QCache>
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <climits>
+
 using namespace Tiled;
 
+namespace Tiled {
+
+/**
+ * An entry in the cache of loaded deferred tile images. Releases the image
+ * of its tile when it is evicted, so that it gets loaded again when needed.
+ */
+class DeferredTileImage
+{
+public:
+    explicit DeferredTileImage(const Tile *tile)
+        : mTile(tile)
+    {}
+
+    ~DeferredTileImage()
+    {
+        mTile->mImage = QPixmap();
+    }
+
+private:
+    const Tile *mTile;
+};
+
+} // namespace Tiled
+
+typedef QCache<const Tile*, DeferredTileImage> DeferredTileImageCache;
+
+// The least recently used deferred tile images are released once their total
+// size exceeds the pixmap budget of the ImageCache, since these pixmaps come
+// from there. Only used from the GUI thread.
+Q_GLOBAL_STATIC(DeferredTileImageCache, deferredTileImages)
+
+static bool trimDeferredTileImagesScheduled = false;
+
+// Pixmaps need to be released before the application is gone
+static void clearDeferredTileImages()
+{
+    deferredTileImages()->clear();
+}
+
+// Releases the least recently used deferred tile images until they fit the
+// memory budget again. Done from the event loop rather than on insertion, so
+// that no image is released while tiles are being painted.
+static void trimDeferredTileImages()
+{
+    trimDeferredTileImagesScheduled = false;
+
+    DeferredTileImageCache *cache = deferredTileImages();
+    cache->setMaxCost(ImageCache::pixmapBudget());
+    cache->setMaxCost(INT_MAX);
+}
+
 Tile::Tile(int id, Tileset *tileset):
     Object(TileType),
     mId(id),
     mTileset(tileset),
+    mImageDeferred(false),
     mTerrain(-1),
     mProbability(1.f),
     mObjectGroup(nullptr),
@@ -49,6 +108,8 @@ Tile::Tile(const QPixmap &image, int id, Tileset *tileset):
     mId(id),
     mTileset(tileset),
     mImage(image),
+    mImageRect(image.rect()),
+    mImageDeferred(false),
     mTerrain(-1),
     mProbability(1.f),
     mObjectGroup(nullptr),
@@ -58,6 +119,7 @@ Tile::Tile(const QPixmap &image, int id, Tileset *tileset):
 
 Tile::~Tile()
 {
+    releaseDeferredImage();
     delete mObjectGroup;
 }
 
@@ -69,6 +131,92 @@ QSharedPointer<Tileset> Tile::sharedTileset() const
     return mTileset->sharedPointer();
 }
 
+/**
+ * Sets the image of this tile to the \a imageRect part of \a image. This
+ * allows tiles to share the image of their tileset.
+ */
+void Tile::setImage(const QPixmap &image, const QRect &imageRect)
+{
+    releaseDeferredImage();
+    mImageDeferred = false;
+    mImage = image;
+    mImageRect = imageRect;
+}
+
+/**
+ * Sets this tile to load its image from \a imageSource once it is first
+ * needed, rather than right away. The \a imageSize, usually known from the
+ * file referring to the image, is used as the size of the tile until then.
+ *
+ * The image may be released again when it hasn't been used for a while, in
+ * which case it is loaded again on the next access.
+ */
+void Tile::setDeferredImage(const QString &imageSource, const QSize &imageSize)
+{
+    releaseDeferredImage();
+    mImage = QPixmap();
+    mImageRect = QRect(QPoint(), imageSize);
+    mImageSource = imageSource;
+    mImageDeferred = true;
+}
+
+/**
+ * Loads the deferred image of this tile when it isn't loaded yet, and marks
+ * it as recently used otherwise.
+ */
+void Tile::useDeferredImage() const
+{
+    if (!isGuiThread())
+        return;
+
+    DeferredTileImageCache *cache = deferredTileImages();
+
+    if (!mImage.isNull()) {
+        cache->object(this);
+        return;
+    }
+
+    mImage = ImageCache::loadPixmap(mImageSource);
+
+    if (mImage.isNull()) {
+        // Don't keep trying, the tile shows up as a broken link instead
+        mImageDeferred = false;
+        return;
+    }
+
+    mImageRect = mImage.rect();
+
+    static bool clearDeferredTileImagesAdded = false;
+    if (!clearDeferredTileImagesAdded) {
+        qAddPostRoutine(clearDeferredTileImages);
+        clearDeferredTileImagesAdded = true;
+    }
+
+    // An image exceeding the whole budget is simply kept
+    const int cost = qMax(1, mImage.width() * mImage.height() * mImage.depth() / 8 / 1024);
+    const int budget = ImageCache::pixmapBudget();
+    if (cost > budget)
+        return;
+
+    // Never evict on insertion, see trimDeferredTileImages()
+    cache->setMaxCost(INT_MAX);
+    cache->insert(this, new DeferredTileImage(this), cost);
+
+    if (cache->totalCost() > budget && !trimDeferredTileImagesScheduled) {
+        trimDeferredTileImagesScheduled = true;
+        QTimer::singleShot(0, trimDeferredTileImages);
+    }
+}
+
+/**
+ * Removes this tile from the cache of loaded deferred images.
+ */
+void Tile::releaseDeferredImage() const
+{
+    if (mImageDeferred && !mImage.isNull() && isGuiThread())
+        deferredTileImages()->remove(this);
+}
+
 /**
  * Returns the tile to render when taking into account tile animations.
  *
@@ -150,6 +298,7 @@ void Tile::setFrames(const QVector<Frame> &frames)
 {
     resetAnimation();
     mFrames = frames;
+    mTileset->markAnimatedTilesDirty();
 }
 
 /**
@@ -194,14 +343,33 @@ bool Tile::advanceAnimation(int ms)
     return previousTileId != frame.tileId;
 }
 
+/**
+ * Returns the amount of milliseconds this tile animation needs to be advanced
+ * by before its current frame changes, or INT_MAX when it never will.
+ */
+int Tile::remainingFrameTime() const
+{
+    if (!isAnimated())
+        return INT_MAX;
+
+    const Frame &frame = mFrames.at(mCurrentFrameIndex);
+    if (frame.duration <= 0)
+        return INT_MAX;
+
+    // The frame only changes once the unused time exceeds its duration
+    return frame.duration - mUnusedTime + 1;
+}
+
 /**
  * Returns a duplicate of this tile, to be added to the given \a tileset.
  */
 Tile *Tile::clone(Tileset *tileset) const
 {
-    Tile *c = new Tile(mImage, mId, tileset);
+    Tile *c = new Tile(mImageDeferred ? QPixmap() : mImage, mId, tileset);
 
+    c->mImageRect = mImageRect;
     c->mImageSource = mImageSource;
+    c->mImageDeferred = mImageDeferred;
     c->mTerrain = mTerrain;
     c->mProbability = mProbability;
 
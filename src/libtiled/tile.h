@@ -102,7 +102,11 @@ public:
     QSharedPointer<Tileset> sharedTileset() const;
 
     const QPixmap &image() const;
+    const QRect &imageRect() const;
     void setImage(const QPixmap &image);
+    void setImage(const QPixmap &image, const QRect &imageRect);
+    void setDeferredImage(const QString &imageSource, const QSize &imageSize);
+    bool isImageDeferred() const;
 
     const Tile *currentFrameTile() const;
 
@@ -136,15 +140,21 @@ public:
     int currentFrameIndex() const;
     bool resetAnimation();
     bool advanceAnimation(int ms);
+    int remainingFrameTime() const;
 
     bool imageLoaded() const;
 
     Tile *clone(Tileset *tileset) const;
 
 private:
+    void useDeferredImage() const;
+    void releaseDeferredImage() const;
+
     int mId;
     Tileset *mTileset;
-    QPixmap mImage;
+    mutable QPixmap mImage;
+    mutable QRect mImageRect;
+    mutable bool mImageDeferred;
     QString mImageSource;
     unsigned mTerrain;
     float mProbability;
@@ -155,6 +165,7 @@ private:
     int mUnusedTime;
 
     friend class Tileset; // To allow changing the tile id
+    friend class DeferredTileImage;
 };
 
 /**
@@ -174,19 +185,47 @@ inline Tileset *Tile::tileset() const
 }
 
 /**
- * Returns the image of this tile.
+ * Returns the image of this tile. For tiles cut from a tileset image, this is
+ * the image of the whole tileset, of which imageRect() is the part showing
+ * this tile.
+ *
+ * A deferred image is loaded on first access. This only happens in the GUI
+ * thread, in other threads a deferred image may still be null. Loaded deferred
+ * images may be released again from the event loop, so the returned reference
+ * should not be kept beyond that.
  */
 inline const QPixmap &Tile::image() const
 {
+    if (mImageDeferred)
+        useDeferredImage();
     return mImage;
 }
 
+/**
+ * Returns the part of image() that shows this tile.
+ */
+inline const QRect &Tile::imageRect() const
+{
+    return mImageRect;
+}
+
 /**
  * Sets the image of this tile.
  */
 inline void Tile::setImage(const QPixmap &image)
 {
-    mImage = image;
+    setImage(image, image.rect());
+}
+
+/**
+ * Returns whether the image of this tile is loaded from its image source
+ * only when it is needed.
+ *
+ * \sa setDeferredImage()
+ */
+inline bool Tile::isImageDeferred() const
+{
+    return mImageDeferred;
 }
 
 /**
@@ -209,7 +248,7 @@ inline void Tile::setImageSource(const QString &imageSource)
  */
 inline int Tile::width() const
 {
-    return mImage.width();
+    return mImageRect.width();
 }
 
 /**
@@ -217,7 +256,7 @@ inline int Tile::width() const
  */
 inline int Tile::height() const
 {
-    return mImage.height();
+    return mImageRect.height();
 }
 
 /**
@@ -225,7 +264,7 @@ inline int Tile::height() const
  */
 inline QSize Tile::size() const
 {
-    return mImage.size();
+    return mImageRect.size();
 }
 
 /**
@@ -293,11 +332,12 @@ inline int Tile::currentFrameIndex() const
 }
 
 /**
- * Returns whether the image referenced by this tile was loaded.
+ * Returns whether the image referenced by this tile was loaded. A deferred
+ * image counts as loaded until loading it has failed.
  */
 inline bool Tile::imageLoaded() const
 {
-    return !mImage.isNull();
+    return mImageDeferred || !mImage.isNull();
 }
 
 } // namespace Tiled
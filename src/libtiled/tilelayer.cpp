@@ -32,14 +32,85 @@
 #include "map.h"
 #include "tile.h"
 
+#include <algorithm>
+
 using namespace Tiled;
 
+const Cell Cell::empty;
+
+bool Chunk::isEmpty() const
+{
+    for (quint32 packedCell : mGrid)
+        if (packedCell != 0)
+            return false;
+
+    return true;
+}
+
+/**
+ * Copies the cell at (\a sourceX, \a sourceY) in \a source to
+ * (\a destX, \a destY) in \a dest. Both chunks need to use the same tileset
+ * table.
+ */
+static void copyCell(const Chunk &source, int sourceX, int sourceY,
+                     Chunk &dest, int destX, int destY)
+{
+    const quint32 packed = source.packedCellAt(sourceX, sourceY);
+    if (packed == PackedOverflowCell)
+        dest.setOverflowCell(destX, destY, source.overflowCellAt(sourceX, sourceY));
+    else
+        dest.setPackedCell(destX, destY, packed);
+}
+
+/**
+ * Calls \a function for each allocated chunk in \a chunks that intersects
+ * with \a rect, passing along the position of the chunk and the part of
+ * \a rect that falls within it.
+ *
+ * Depending on which is cheaper, either the chunk positions covered by the
+ * rectangle are looked up or all allocated chunks are tested.
+ */
+template<typename Function>
+static void forEachChunkIn(const QHash<QPoint, Chunk> &chunks,
+                           const QRect &rect,
+                           Function function)
+{
+    if (rect.isEmpty() || chunks.isEmpty())
+        return;
+
+    const int left = rect.left() & ~CHUNK_MASK;
+    const int top = rect.top() & ~CHUNK_MASK;
+    const qint64 columns = ((rect.right() & ~CHUNK_MASK) - left) / CHUNK_SIZE + 1;
+    const qint64 rows = ((rect.bottom() & ~CHUNK_MASK) - top) / CHUNK_SIZE + 1;
+
+    if (columns * rows <= chunks.size()) {
+        for (int y = top; y <= rect.bottom(); y += CHUNK_SIZE) {
+            for (int x = left; x <= rect.right(); x += CHUNK_SIZE) {
+                QHash<QPoint, Chunk>::const_iterator it = chunks.find(QPoint(x, y));
+                if (it != chunks.end()) {
+                    const QRect chunkRect(it.key(), QSize(CHUNK_SIZE, CHUNK_SIZE));
+                    function(it.key(), it.value(), rect & chunkRect);
+                }
+            }
+        }
+    } else {
+        for (auto it = chunks.begin(), it_end = chunks.end(); it != it_end; ++it) {
+            const QRect intersection = rect & QRect(it.key(), QSize(CHUNK_SIZE, CHUNK_SIZE));
+            if (!intersection.isEmpty())
+                function(it.key(), it.value(), intersection);
+        }
+    }
+}
+
+
 TileLayer::TileLayer(const QString &name, int x, int y, int width, int height)
     : Layer(TileLayerType, name, x, y)
     , mWidth(width)
     , mHeight(height)
-    , mGrid(width * height)
-    , mUsedTilesetsDirty(false)
+    , mTilesetTable(1)
+    , mTilesetCellCounts(1)
+    , mLastTilesetIndex(0)
+    , mDrawMarginsDirty(true)
 {
     Q_ASSERT(width >= 0);
     Q_ASSERT(height >= 0);
@@ -79,34 +150,301 @@ static QMargins computeDrawMargins(const QSet<SharedTileset> &tilesets)
                     offsetMargins.bottom());
 }
 
+/**
+ * Returns the margins by which the tiles of this layer may extend beyond their
+ * cells, based on the tile size and tile offset of the used tilesets.
+ *
+ * The margins are cached, and invalidated when a tileset starts or stops being
+ * used by this layer.
+ */
 QMargins TileLayer::drawMargins() const
 {
-    return computeDrawMargins(usedTilesets());
+    if (mDrawMarginsDirty) {
+        mDrawMargins = computeDrawMargins(usedTilesets());
+        mDrawMarginsDirty = false;
+    }
+
+    return mDrawMargins;
+}
+
+/**
+ * Returns the positions of the allocated chunks, sorted by row and then by
+ * column.
+ */
+QVector<QPoint> TileLayer::sortedChunkPositions() const
+{
+    QVector<QPoint> positions;
+    positions.reserve(mChunks.size());
+
+    for (auto it = mChunks.begin(), it_end = mChunks.end(); it != it_end; ++it)
+        positions.append(it.key());
+
+    std::sort(positions.begin(), positions.end(),
+              [] (const QPoint &a, const QPoint &b) {
+        return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+    });
+
+    return positions;
+}
+
+/**
+ * Returns the region covered by the allocated chunks, moved by \a offset and
+ * clipped to \a clip.
+ */
+QRegion TileLayer::chunksRegion(const QRect &clip, const QPoint &offset) const
+{
+    QRegion region;
+
+    // Added in row-major order, which allows QRegion to append the rects
+    for (const QPoint &position : sortedChunkPositions()) {
+        const QRect rect = QRect(position + offset, QSize(CHUNK_SIZE, CHUNK_SIZE)) & clip;
+        if (!rect.isEmpty())
+            region += rect;
+    }
+
+    return region;
 }
 
 QRegion TileLayer::region(std::function<bool (const Cell &)> condition) const
 {
     QRegion region;
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            if (condition(cellAt(x, y))) {
-                const int rangeStart = x;
-                for (++x; x <= mWidth; ++x) {
-                    if (x == mWidth || !condition(cellAt(x, y))) {
-                        const int rangeEnd = x;
-                        region += QRect(rangeStart + mX, y + mY,
-                                        rangeEnd - rangeStart, 1);
-                        break;
+    const bool emptyMatches = condition(Cell::empty);
+    const QVector<QPoint> positions = sortedChunkPositions();
+    QVector<const Chunk*> rowChunks;
+    int index = 0;
+
+    // Scan one row of chunks at a time, but each row of cells from left to
+    // right across all chunks, so that the rects get appended in order.
+    for (int chunkY = 0; chunkY < mHeight; chunkY += CHUNK_SIZE) {
+        const int rowEnd = qMin(chunkY + CHUNK_SIZE, mHeight);
+        const int first = index;
+
+        rowChunks.clear();
+        while (index < positions.size() && positions.at(index).y() == chunkY) {
+            const QPoint &position = positions.at(index);
+            rowChunks.append(findChunk(position.x(), position.y()));
+            ++index;
+        }
+
+        if (rowChunks.isEmpty()) {
+            if (emptyMatches && mWidth > 0)
+                region += QRect(mX, chunkY + mY, mWidth, rowEnd - chunkY);
+            continue;
+        }
+
+        for (int y = chunkY; y < rowEnd; ++y) {
+            int rangeStart = -1;
+            int x = 0;
+
+            for (int i = 0; i < rowChunks.size(); ++i) {
+                const int chunkX = positions.at(first + i).x();
+                const Chunk *chunk = rowChunks.at(i);
+
+                // Handle the gap of unallocated chunks
+                if (chunkX > x) {
+                    if (emptyMatches) {
+                        if (rangeStart == -1)
+                            rangeStart = x;
+                    } else if (rangeStart != -1) {
+                        region += QRect(rangeStart + mX, y + mY, x - rangeStart, 1);
+                        rangeStart = -1;
                     }
                 }
+
+                const int chunkEnd = qMin(chunkX + CHUNK_SIZE, mWidth);
+                for (x = chunkX; x < chunkEnd; ++x) {
+                    if (condition(unpack(*chunk, x - chunkX, y - chunkY))) {
+                        if (rangeStart == -1)
+                            rangeStart = x;
+                    } else if (rangeStart != -1) {
+                        region += QRect(rangeStart + mX, y + mY, x - rangeStart, 1);
+                        rangeStart = -1;
+                    }
+                }
+            }
+
+            if (emptyMatches && x < mWidth) {
+                if (rangeStart == -1)
+                    rangeStart = x;
+                x = mWidth;
             }
+
+            if (rangeStart != -1)
+                region += QRect(rangeStart + mX, y + mY, x - rangeStart, 1);
         }
     }
 
     return region;
 }
 
+Chunk &TileLayer::chunk(int x, int y)
+{
+    return mChunks[chunkPosition(x, y)];
+}
+
+/**
+ * Returns the index of \a tileset in the tileset table of this layer, adding
+ * it when necessary. Slots released by unused tilesets are reused. Returns
+ * OverflowTilesetIndex when the table is full.
+ */
+int TileLayer::tilesetIndex(Tileset *tileset)
+{
+    if (mTilesetTable.at(mLastTilesetIndex) == tileset)
+        return mLastTilesetIndex;
+
+    int index = mTilesetTable.indexOf(tileset, 1);
+    if (index == -1) {
+        index = mTilesetTable.indexOf(nullptr, 1);
+        if (index != -1) {
+            mTilesetTable[index] = tileset;
+        } else {
+            if (mTilesetTable.size() >= OverflowTilesetIndex)
+                return OverflowTilesetIndex;
+
+            index = mTilesetTable.size();
+            mTilesetTable.append(tileset);
+            mTilesetCellCounts.append(0);
+        }
+    }
+
+    mLastTilesetIndex = index;
+    return index;
+}
+
+/**
+ * Adjusts the cell count of the tileset used by the cell with the given
+ * \a packed value by \a delta. For overflow cells, their tileset needs to be
+ * passed as \a overflowTileset.
+ */
+void TileLayer::countCell(quint32 packed, Tileset *overflowTileset, int delta)
+{
+    if (packed == 0)
+        return;
+
+    if (packed == PackedOverflowCell)
+        countTileset(overflowTileset, delta);
+    else
+        adjustCellCount((packed & PackedTilesetMask) >> PackedTilesetShift, delta);
+}
+
+/**
+ * Adjusts the cell count of \a tileset by \a delta. Tilesets that did not fit
+ * in the tileset table are counted separately.
+ */
+void TileLayer::countTileset(Tileset *tileset, int delta)
+{
+    const int index = mTilesetTable.indexOf(tileset, 1);
+    if (index != -1) {
+        adjustCellCount(index, delta);
+        return;
+    }
+
+    int &count = mOverflowTilesetCellCounts[tileset];
+    if (count == 0)
+        mDrawMarginsDirty = true;
+
+    count += delta;
+    Q_ASSERT(count >= 0);
+
+    if (count == 0) {
+        mOverflowTilesetCellCounts.remove(tileset);
+        mDrawMarginsDirty = true;
+    }
+}
+
+/**
+ * Adjusts the cell count of the tileset at \a index in the tileset table by
+ * \a delta. The draw margins are invalidated when a tileset starts or stops
+ * being used, and the slot of a tileset is released once it is unused.
+ */
+void TileLayer::adjustCellCount(int index, int delta)
+{
+    int &count = mTilesetCellCounts[index];
+    if (count == 0)
+        mDrawMarginsDirty = true;
+
+    count += delta;
+    Q_ASSERT(count >= 0);
+
+    if (count == 0) {
+        mTilesetTable[index] = nullptr;
+        mDrawMarginsDirty = true;
+    }
+}
+
+/**
+ * Releases the slots of the tilesets in the tileset table that are no longer
+ * used by any cell. This avoids keeping pointers to tilesets that may have
+ * been deleted, and allows the slots to be reused.
+ */
+void TileLayer::releaseUnusedTilesetSlots()
+{
+    for (int index = 1; index < mTilesetTable.size(); ++index)
+        if (mTilesetCellCounts.at(index) == 0)
+            mTilesetTable[index] = nullptr;
+}
+
+/**
+ * Recounts the cells referring to each tileset. Used after operations that
+ * touch all cells anyway.
+ */
+void TileLayer::recountTilesets()
+{
+    mTilesetCellCounts.fill(0);
+    mOverflowTilesetCellCounts.clear();
+
+    for (const Chunk &chunk : mChunks) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const quint32 packed = chunk.packedCellAt(x, y);
+                if (packed == PackedOverflowCell) {
+                    Tileset *tileset = chunk.overflowCellAt(x, y).tileset();
+                    const int index = mTilesetTable.indexOf(tileset, 1);
+                    if (index != -1)
+                        ++mTilesetCellCounts[index];
+                    else
+                        ++mOverflowTilesetCellCounts[tileset];
+                } else if (packed != 0) {
+                    ++mTilesetCellCounts[(packed & PackedTilesetMask) >> PackedTilesetShift];
+                }
+            }
+        }
+    }
+
+    releaseUnusedTilesetSlots();
+    mDrawMarginsDirty = true;
+}
+
+/**
+ * Packs the given \a cell. Returns PackedOverflowCell when the cell needs to
+ * be stored unpacked. Empty cells are always packed to 0, dropping any flags.
+ */
+quint32 TileLayer::pack(const Cell &cell)
+{
+    if (cell.isEmpty())
+        return 0;
+
+    const int tileId = cell.tileId();
+    if (tileId < 0 || quint32(tileId) > PackedTileIdMask)
+        return PackedOverflowCell;
+
+    const int index = tilesetIndex(cell.tileset());
+    if (index == OverflowTilesetIndex)
+        return PackedOverflowCell;
+
+    quint32 packed = (quint32(index) << PackedTilesetShift) | quint32(tileId);
+
+    if (cell.flippedHorizontally())
+        packed |= PackedFlippedHorizontallyFlag;
+    if (cell.flippedVertically())
+        packed |= PackedFlippedVerticallyFlag;
+    if (cell.flippedAntiDiagonally())
+        packed |= PackedFlippedAntiDiagonallyFlag;
+
+    return packed;
+}
+
 /**
  * Sets the cell at the given coordinates.
  */
@@ -114,20 +452,35 @@ void Tiled::TileLayer::setCell(int x, int y, const Cell &cell)
 {
     Q_ASSERT(contains(x, y));
 
-    Cell &existingCell = mGrid[x + y * mWidth];
-
-    if (!mUsedTilesetsDirty) {
-        Tileset *oldTileset = existingCell.isEmpty() ? nullptr : existingCell.tileset();
-        Tileset *newTileset = cell.tileset();
-        if (oldTileset != newTileset) {
-            if (oldTileset)
-                mUsedTilesetsDirty = true;
-            else if (newTileset)
-                mUsedTilesets.insert(newTileset->sharedPointer());
-        }
+    const quint32 packed = pack(cell);
+    Chunk *chunk;
+
+    if (packed == 0) {
+        // Clearing a cell never needs to allocate a chunk
+        QHash<QPoint, Chunk>::iterator it = mChunks.find(chunkPosition(x, y));
+        if (it == mChunks.end())
+            return;
+        chunk = &it.value();
+    } else {
+        chunk = &this->chunk(x, y);
     }
 
-    existingCell = cell;
+    const int chunkX = x & CHUNK_MASK;
+    const int chunkY = y & CHUNK_MASK;
+    const quint32 oldPacked = chunk->packedCellAt(chunkX, chunkY);
+    Tileset *oldOverflowTileset = nullptr;
+    if (oldPacked == PackedOverflowCell)
+        oldOverflowTileset = chunk->overflowCellAt(chunkX, chunkY).tileset();
+
+    if (packed == PackedOverflowCell)
+        chunk->setOverflowCell(chunkX, chunkY, cell);
+    else
+        chunk->setPackedCell(chunkX, chunkY, packed);
+
+    // Count the new cell first, to avoid needlessly invalidating the draw
+    // margins when the tileset stays the same
+    countCell(packed, cell.tileset(), 1);
+    countCell(oldPacked, oldOverflowTileset, -1);
 }
 
 TileLayer *TileLayer::copy(const QRegion &region) const
@@ -135,19 +488,28 @@ TileLayer *TileLayer::copy(const QRegion &region) const
     const QRegion area = region.intersected(QRect(0, 0, width(), height()));
     const QRect bounds = region.boundingRect();
     const QRect areaBounds = area.boundingRect();
-    const int offsetX = qMax(0, areaBounds.x() - bounds.x());
-    const int offsetY = qMax(0, areaBounds.y() - bounds.y());
+    const int offsetX = qMax(0, areaBounds.x() - bounds.x()) - areaBounds.x();
+    const int offsetY = qMax(0, areaBounds.y() - bounds.y()) - areaBounds.y();
 
     TileLayer *copied = new TileLayer(QString(),
                                       0, 0,
                                       bounds.width(), bounds.height());
 
-    for (const QRect &rect : area.rects())
-        for (int x = rect.left(); x <= rect.right(); ++x)
-            for (int y = rect.top(); y <= rect.bottom(); ++y)
-                copied->setCell(x - areaBounds.x() + offsetX,
-                                y - areaBounds.y() + offsetY,
-                                cellAt(x, y));
+    for (const QRect &rect : area.rects()) {
+        forEachChunkIn(mChunks, rect, [&] (const QPoint &position,
+                                           const Chunk &chunk,
+                                           const QRect &r) {
+            for (int y = r.top(); y <= r.bottom(); ++y) {
+                for (int x = r.left(); x <= r.right(); ++x) {
+                    const int chunkX = x - position.x();
+                    const int chunkY = y - position.y();
+                    if (chunk.packedCellAt(chunkX, chunkY) != 0)
+                        copied->setCell(x + offsetX, y + offsetY,
+                                        unpack(chunk, chunkX, chunkY));
+                }
+            }
+        });
+    }
 
     return copied;
 }
@@ -158,12 +520,19 @@ void TileLayer::merge(const QPoint &pos, const TileLayer *layer)
     QRect area = QRect(pos, QSize(layer->width(), layer->height()));
     area &= QRect(0, 0, width(), height());
 
-    for (int y = area.top(); y <= area.bottom(); ++y) {
-        for (int x = area.left(); x <= area.right(); ++x) {
-            const Cell &cell = layer->cellAt(x - pos.x(),
-                                             y - pos.y());
-            if (!cell.isEmpty())
-                setCell(x, y, cell);
+    // Only the allocated chunks of the merged layer can contain tiles
+    for (auto it = layer->mChunks.begin(), it_end = layer->mChunks.end(); it != it_end; ++it) {
+        const QPoint chunkPos = it.key() + pos;
+        const QRect rect = area & QRect(chunkPos, QSize(CHUNK_SIZE, CHUNK_SIZE));
+        const Chunk &chunk = it.value();
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const int chunkX = x - chunkPos.x();
+                const int chunkY = y - chunkPos.y();
+                if (chunk.packedCellAt(chunkX, chunkY) != 0)
+                    setCell(x, y, layer->unpack(chunk, chunkX, chunkY));
+            }
         }
     }
 }
@@ -179,42 +548,85 @@ void TileLayer::setCells(int x, int y, TileLayer *layer,
         area &= mask;
 
     for (const QRect &rect : area.rects())
-        for (int _x = rect.left(); _x <= rect.right(); ++_x)
-            for (int _y = rect.top(); _y <= rect.bottom(); ++_y)
+        for (int _y = rect.top(); _y <= rect.bottom(); ++_y)
+            for (int _x = rect.left(); _x <= rect.right(); ++_x)
                 setCell(_x, _y, layer->cellAt(_x - x, _y - y));
 }
 
 void TileLayer::erase(const QRegion &area)
 {
+    QVector<QRect> rects;
+    QVector<QPoint> touchedChunks;
+
+    for (const QRect &rect : area.rects()) {
+        forEachChunkIn(mChunks, rect, [&] (const QPoint &position,
+                                           const Chunk &,
+                                           const QRect &r) {
+            rects.append(r);
+            touchedChunks.append(position);
+        });
+    }
+
     const Cell emptyCell;
-    for (const QRect &rect : area.rects())
-        for (int x = rect.left(); x <= rect.right(); ++x)
-            for (int y = rect.top(); y <= rect.bottom(); ++y)
+    for (const QRect &rect : rects)
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+            for (int x = rect.left(); x <= rect.right(); ++x)
                 setCell(x, y, emptyCell);
+
+    // Release chunks that no longer contain any tiles
+    for (const QPoint &position : touchedChunks) {
+        QHash<QPoint, Chunk>::iterator it = mChunks.find(position);
+        if (it != mChunks.end() && it.value().isEmpty())
+            mChunks.erase(it);
+    }
 }
 
 void TileLayer::flip(FlipDirection direction)
 {
-    QVector<Cell> newGrid(mWidth * mHeight);
+    QHash<QPoint, Chunk> newChunks;
 
     Q_ASSERT(direction == FlipHorizontally || direction == FlipVertically);
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            Cell &dest = newGrid[x + y * mWidth];
-            if (direction == FlipHorizontally) {
-                const Cell &source = cellAt(mWidth - x - 1, y);
-                dest = source;
-                dest.setFlippedHorizontally(!source.flippedHorizontally());
-            } else if (direction == FlipVertically) {
-                const Cell &source = cellAt(x, mHeight - y - 1);
-                dest = source;
-                dest.setFlippedVertically(!source.flippedVertically());
+    for (auto it = mChunks.begin(), it_end = mChunks.end(); it != it_end; ++it) {
+        const QPoint &position = it.key();
+        const Chunk &chunk = it.value();
+
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const quint32 packed = chunk.packedCellAt(x, y);
+                if (packed == 0)
+                    continue;
+
+                int destX = position.x() + x;
+                int destY = position.y() + y;
+                quint32 flag;
+
+                if (direction == FlipHorizontally) {
+                    destX = mWidth - destX - 1;
+                    flag = PackedFlippedHorizontallyFlag;
+                } else {
+                    destY = mHeight - destY - 1;
+                    flag = PackedFlippedVerticallyFlag;
+                }
+
+                Chunk &destChunk = newChunks[chunkPosition(destX, destY)];
+
+                if (packed == PackedOverflowCell) {
+                    Cell dest = chunk.overflowCellAt(x, y);
+                    if (direction == FlipHorizontally)
+                        dest.setFlippedHorizontally(!dest.flippedHorizontally());
+                    else
+                        dest.setFlippedVertically(!dest.flippedVertically());
+                    destChunk.setOverflowCell(destX & CHUNK_MASK, destY & CHUNK_MASK, dest);
+                } else {
+                    destChunk.setPackedCell(destX & CHUNK_MASK, destY & CHUNK_MASK,
+                                            packed ^ flag);
+                }
             }
         }
     }
 
-    mGrid = newGrid;
+    mChunks.swap(newChunks);
 }
 
 void TileLayer::rotate(RotateDirection direction)
@@ -227,87 +639,182 @@ void TileLayer::rotate(RotateDirection direction)
 
     int newWidth = mHeight;
     int newHeight = mWidth;
-    QVector<Cell> newGrid(newWidth * newHeight);
+    QHash<QPoint, Chunk> newChunks;
+
+    for (auto it = mChunks.begin(), it_end = mChunks.end(); it != it_end; ++it) {
+        const QPoint &position = it.key();
+        const Chunk &chunk = it.value();
+
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const quint32 packed = chunk.packedCellAt(x, y);
+                if (packed == 0)
+                    continue;
+
+                const int sourceX = position.x() + x;
+                const int sourceY = position.y() + y;
+                int destX, destY;
+
+                if (direction == RotateRight) {
+                    destX = mHeight - sourceY - 1;
+                    destY = sourceX;
+                } else {
+                    destX = sourceY;
+                    destY = mWidth - sourceX - 1;
+                }
+
+                Chunk &destChunk = newChunks[chunkPosition(destX, destY)];
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            const Cell &source = cellAt(x, y);
-            Cell dest = source;
+                if (packed == PackedOverflowCell) {
+                    Cell dest = chunk.overflowCellAt(x, y);
 
-            unsigned char mask =
-                    (dest.flippedHorizontally() << 2) |
-                    (dest.flippedVertically() << 1) |
-                    (dest.flippedAntiDiagonally() << 0);
+                    unsigned char mask =
+                            (dest.flippedHorizontally() << 2) |
+                            (dest.flippedVertically() << 1) |
+                            (dest.flippedAntiDiagonally() << 0);
 
-            mask = rotateMask[mask];
+                    mask = rotateMask[mask];
 
-            dest.setFlippedHorizontally((mask & 4) != 0);
-            dest.setFlippedVertically((mask & 2) != 0);
-            dest.setFlippedAntiDiagonally((mask & 1) != 0);
+                    dest.setFlippedHorizontally((mask & 4) != 0);
+                    dest.setFlippedVertically((mask & 2) != 0);
+                    dest.setFlippedAntiDiagonally((mask & 1) != 0);
 
-            if (direction == RotateRight)
-                newGrid[x * newWidth + (mHeight - y - 1)] = dest;
-            else
-                newGrid[(mWidth - x - 1) * newWidth + y] = dest;
+                    destChunk.setOverflowCell(destX & CHUNK_MASK, destY & CHUNK_MASK, dest);
+                } else {
+                    // The packed flip flags match the layout of the mask
+                    const quint32 mask = rotateMask[packed >> PackedFlagsShift];
+                    destChunk.setPackedCell(destX & CHUNK_MASK, destY & CHUNK_MASK,
+                                            (packed & ~PackedFlagsMask) |
+                                            (mask << PackedFlagsShift));
+                }
+            }
         }
     }
 
     mWidth = newWidth;
     mHeight = newHeight;
-    mGrid = newGrid;
+    mChunks.swap(newChunks);
 }
 
 
 QSet<SharedTileset> TileLayer::usedTilesets() const
 {
-    if (mUsedTilesetsDirty) {
-        QSet<SharedTileset> tilesets;
+    QSet<SharedTileset> tilesets;
 
-        for (const Cell &cell : mGrid)
-            if (const Tile *tile = cell.tile())
-                tilesets.insert(tile->sharedTileset());
+    // Index 0 is used by empty cells
+    for (int index = 1; index < mTilesetCellCounts.size(); ++index)
+        if (mTilesetCellCounts.at(index) > 0)
+            tilesets.insert(mTilesetTable.at(index)->sharedPointer());
 
-        mUsedTilesets.swap(tilesets);
-        mUsedTilesetsDirty = false;
+    for (auto it = mOverflowTilesetCellCounts.begin(),
+         it_end = mOverflowTilesetCellCounts.end(); it != it_end; ++it) {
+        tilesets.insert(it.key()->sharedPointer());
     }
 
-    return mUsedTilesets;
+    return tilesets;
 }
 
 bool TileLayer::hasCell(std::function<bool (const Cell &)> condition) const
 {
-    for (const Cell &cell : mGrid)
-        if (condition(cell))
-            return true;
+    const QRect bounds(0, 0, mWidth, mHeight);
+
+    for (auto it = mChunks.begin(), it_end = mChunks.end(); it != it_end; ++it) {
+        // Chunks at the edges extend beyond the layer
+        const QRect rect = bounds & QRect(it.key(), QSize(CHUNK_SIZE, CHUNK_SIZE));
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+            for (int x = rect.left(); x <= rect.right(); ++x)
+                if (condition(unpack(it.value(), x & CHUNK_MASK, y & CHUNK_MASK)))
+                    return true;
+    }
+
+    // Unallocated chunks consist entirely of empty cells
+    const qint64 columns = (mWidth + CHUNK_MASK) / CHUNK_SIZE;
+    const qint64 rows = (mHeight + CHUNK_MASK) / CHUNK_SIZE;
+    if (mChunks.size() < columns * rows)
+        return condition(Cell::empty);
 
     return false;
 }
 
 bool TileLayer::referencesTileset(const Tileset *tileset) const
 {
-    return usedTilesets().contains(tileset->sharedPointer());
+    Tileset *key = const_cast<Tileset*>(tileset);
+
+    const int index = mTilesetTable.indexOf(key, 1);
+    if (index != -1)
+        return mTilesetCellCounts.at(index) > 0;
+
+    return mOverflowTilesetCellCounts.contains(key);
 }
 
 void TileLayer::removeReferencesToTileset(Tileset *tileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        if (mGrid.at(i).tileset() == tileset)
-            mGrid.replace(i, Cell());
+    const int index = mTilesetTable.indexOf(tileset, 1);
+
+    for (auto it = mChunks.begin(); it != mChunks.end(); ) {
+        Chunk &chunk = it.value();
+
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const quint32 packed = chunk.packedCellAt(x, y);
+                if (packed == PackedOverflowCell) {
+                    if (chunk.overflowCellAt(x, y).tileset() == tileset)
+                        chunk.setPackedCell(x, y, 0);
+                } else if (packed != 0 && index != -1 &&
+                           int((packed & PackedTilesetMask) >> PackedTilesetShift) == index) {
+                    chunk.setPackedCell(x, y, 0);
+                }
+            }
+        }
+
+        if (chunk.isEmpty())
+            it = mChunks.erase(it);
+        else
+            ++it;
     }
 
-    mUsedTilesets.remove(tileset->sharedPointer());
+    recountTilesets();
 }
 
 void TileLayer::replaceReferencesToTileset(Tileset *oldTileset,
                                            Tileset *newTileset)
 {
-    for (Cell &cell : mGrid) {
-        if (cell.tileset() == oldTileset)
-            cell.setTile(newTileset, cell.tileId());
+    const int oldIndex = mTilesetTable.indexOf(oldTileset, 1);
+    const int newIndex = mTilesetTable.indexOf(newTileset, 1);
+
+    // When the new tileset is not yet in the table, the packed cells can be
+    // updated by only replacing the tileset in the table
+    if (oldIndex != -1 && newIndex == -1)
+        mTilesetTable[oldIndex] = newTileset;
+
+    // Nothing else to do when no overflow cells refer to the old tileset
+    if ((oldIndex == -1 || newIndex == -1) &&
+            !mOverflowTilesetCellCounts.contains(oldTileset)) {
+        mDrawMarginsDirty = true;
+        return;
+    }
+
+    for (Chunk &chunk : mChunks) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                const quint32 packed = chunk.packedCellAt(x, y);
+                if (packed == PackedOverflowCell) {
+                    Cell cell = chunk.overflowCellAt(x, y);
+                    if (cell.tileset() == oldTileset) {
+                        cell.setTile(newTileset, cell.tileId());
+                        chunk.setOverflowCell(x, y, cell);
+                    }
+                } else if (packed != 0 && oldIndex != -1 && newIndex != -1 &&
+                           int((packed & PackedTilesetMask) >> PackedTilesetShift) == oldIndex) {
+                    chunk.setPackedCell(x, y, (packed & ~PackedTilesetMask) |
+                                        (quint32(newIndex) << PackedTilesetShift));
+                }
+            }
+        }
     }
 
-    if (mUsedTilesets.remove(oldTileset->sharedPointer()))
-        mUsedTilesets.insert(newTileset->sharedPointer());
+    recountTilesets();
 }
 
 void TileLayer::resize(const QSize &size, const QPoint &offset)
@@ -315,68 +822,88 @@ void TileLayer::resize(const QSize &size, const QPoint &offset)
     if (this->size() == size && offset.isNull())
         return;
 
-    QVector<Cell> newGrid(size.width() * size.height());
+    QHash<QPoint, Chunk> newChunks;
 
     // Copy over the preserved part
-    const int startX = qMax(0, -offset.x());
-    const int startY = qMax(0, -offset.y());
-    const int endX = qMin(mWidth, size.width() - offset.x());
-    const int endY = qMin(mHeight, size.height() - offset.y());
-
-    for (int y = startY; y < endY; ++y) {
-        for (int x = startX; x < endX; ++x) {
-            const int index = x + offset.x() + (y + offset.y()) * size.width();
-            newGrid[index] = cellAt(x, y);
+    const QRect newBounds(QPoint(0, 0), size);
+
+    for (auto it = mChunks.begin(), it_end = mChunks.end(); it != it_end; ++it) {
+        const QPoint &position = it.key();
+        const Chunk &chunk = it.value();
+
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                if (chunk.packedCellAt(x, y) == 0)
+                    continue;
+
+                const int destX = position.x() + x + offset.x();
+                const int destY = position.y() + y + offset.y();
+                if (!newBounds.contains(destX, destY))
+                    continue;
+
+                copyCell(chunk, x, y,
+                         newChunks[chunkPosition(destX, destY)],
+                         destX & CHUNK_MASK, destY & CHUNK_MASK);
+            }
         }
     }
 
-    mGrid = newGrid;
+    mChunks.swap(newChunks);
     setSize(size);
+    recountTilesets();
+}
+
+static int wrap(int value, int start, int length)
+{
+    const int remainder = (value - start) % length;
+    return start + (remainder < 0 ? remainder + length : remainder);
 }
 
 void TileLayer::offsetTiles(const QPoint &offset,
                             const QRect &bounds,
                             bool wrapX, bool wrapY)
 {
-    QVector<Cell> newGrid(mWidth * mHeight);
-
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            // Skip out of bounds tiles
-            if (!bounds.contains(x, y)) {
-                newGrid[x + y * mWidth] = cellAt(x, y);
-                continue;
-            }
-
-            // Get position to pull tile value from
-            int oldX = x - offset.x();
-            int oldY = y - offset.y();
-
-            // Wrap x value that will be pulled from
-            if (wrapX && bounds.width() > 0) {
-                while (oldX < bounds.left())
-                    oldX += bounds.width();
-                while (oldX > bounds.right())
-                    oldX -= bounds.width();
-            }
+    QHash<QPoint, Chunk> newChunks;
+
+    // Push each tile to its new position, which is equivalent to pulling each
+    // position's tile from its old position but skips the empty areas
+    for (auto it = mChunks.begin(), it_end = mChunks.end(); it != it_end; ++it) {
+        const QPoint &position = it.key();
+        const Chunk &chunk = it.value();
+
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                if (chunk.packedCellAt(x, y) == 0)
+                    continue;
+
+                const int oldX = position.x() + x;
+                const int oldY = position.y() + y;
+                int newX = oldX;
+                int newY = oldY;
+
+                // Tiles out of bounds stay where they are
+                if (bounds.contains(oldX, oldY)) {
+                    newX += offset.x();
+                    newY += offset.y();
+
+                    if (wrapX && bounds.width() > 0)
+                        newX = wrap(newX, bounds.left(), bounds.width());
+                    if (wrapY && bounds.height() > 0)
+                        newY = wrap(newY, bounds.top(), bounds.height());
+
+                    if (!contains(newX, newY) || !bounds.contains(newX, newY))
+                        continue;
+                }
 
-            // Wrap y value that will be pulled from
-            if (wrapY && bounds.height() > 0) {
-                while (oldY < bounds.top())
-                    oldY += bounds.height();
-                while (oldY > bounds.bottom())
-                    oldY -= bounds.height();
+                copyCell(chunk, x, y,
+                         newChunks[chunkPosition(newX, newY)],
+                         newX & CHUNK_MASK, newY & CHUNK_MASK);
             }
-
-            // Set the new tile
-            if (contains(oldX, oldY) && bounds.contains(oldX, oldY))
-                newGrid[x + y * mWidth] = cellAt(oldX, oldY);
-            else
-                newGrid[x + y * mWidth] = Cell();
         }
     }
 
-    mGrid = newGrid;
+    mChunks.swap(newChunks);
+    recountTilesets();
 }
 
 bool TileLayer::canMergeWith(Layer *other) const
@@ -407,18 +934,50 @@ QRegion TileLayer::computeDiffRegion(const TileLayer *other) const
     QRect r = QRect(0, 0, width(), height());
     r &= QRect(dx, dy, other->width(), other->height());
 
-    for (int y = r.top(); y <= r.bottom(); ++y) {
-        for (int x = r.left(); x <= r.right(); ++x) {
-            if (cellAt(x, y) != other->cellAt(x - dx, y - dy)) {
-                const int rangeStart = x;
-                while (x <= r.right() &&
-                       cellAt(x, y) != other->cellAt(x - dx, y - dy)) {
-                    ++x;
+    // Differences can only occur where either layer has allocated chunks
+    const QRegion candidates = chunksRegion(r, QPoint()) |
+            other->chunksRegion(r, QPoint(dx, dy));
+    const QVector<QRect> rects = candidates.rects();
+
+    // When both layers use the same tileset table, cells can be compared in
+    // their packed form
+    const bool samePacking = mTilesetTable == other->mTilesetTable;
+    auto differs = [&] (int x, int y) -> bool {
+        if (samePacking) {
+            const quint32 packed = packedCellAt(x, y);
+            if (packed != other->packedCellAt(x - dx, y - dy))
+                return true;
+            if (packed != PackedOverflowCell)
+                return false;
+        }
+        return cellAt(x, y) != other->cellAt(x - dx, y - dy);
+    };
+
+    // The rects are y-x banded, so scan each band row by row to produce the
+    // resulting rects in order
+    for (int band = 0; band < rects.size(); ) {
+        int bandEnd = band + 1;
+        while (bandEnd < rects.size() && rects.at(bandEnd).top() == rects.at(band).top())
+            ++bandEnd;
+
+        for (int y = rects.at(band).top(); y <= rects.at(band).bottom(); ++y) {
+            for (int i = band; i < bandEnd; ++i) {
+                const QRect &rect = rects.at(i);
+
+                for (int x = rect.left(); x <= rect.right(); ++x) {
+                    if (differs(x, y)) {
+                        const int rangeStart = x;
+                        while (x <= rect.right() && differs(x, y)) {
+                            ++x;
+                        }
+                        const int rangeEnd = x;
+                        ret += QRect(rangeStart, y, rangeEnd - rangeStart, 1);
+                    }
                 }
-                const int rangeEnd = x;
-                ret += QRect(rangeStart, y, rangeEnd - rangeStart, 1);
             }
         }
+
+        band = bandEnd;
     }
 
     return ret;
@@ -426,11 +985,11 @@ QRegion TileLayer::computeDiffRegion(const TileLayer *other) const
 
 bool TileLayer::isEmpty() const
 {
-    for (const Cell &cell : mGrid)
-        if (!cell.isEmpty())
+    for (int count : mTilesetCellCounts)
+        if (count > 0)
             return false;
 
-    return true;
+    return mOverflowTilesetCellCounts.isEmpty();
 }
 
 /**
@@ -446,8 +1005,12 @@ Layer *TileLayer::clone() const
 TileLayer *TileLayer::initializeClone(TileLayer *clone) const
 {
     Layer::initializeClone(clone);
-    clone->mGrid = mGrid;
-    clone->mUsedTilesets = mUsedTilesets;
-    clone->mUsedTilesetsDirty = mUsedTilesetsDirty;
+    clone->mChunks = mChunks;
+    clone->mTilesetTable = mTilesetTable;
+    clone->mLastTilesetIndex = mLastTilesetIndex;
+    clone->mTilesetCellCounts = mTilesetCellCounts;
+    clone->mOverflowTilesetCellCounts = mOverflowTilesetCellCounts;
+    clone->mDrawMargins = mDrawMargins;
+    clone->mDrawMarginsDirty = mDrawMarginsDirty;
     return clone;
 }
@@ -36,7 +36,9 @@
 #include "tile.h"
 #include "tileset.h"
 
+#include <QHash>
 #include <QMargins>
+#include <QPoint>
 #include <QString>
 #include <QVector>
 #include <QSharedPointer>
@@ -45,76 +47,101 @@
 
 namespace Tiled {
 
+inline uint qHash(const QPoint &key, uint seed = 0) Q_DECL_NOTHROW
+{
+    uint h1 = ::qHash(key.x(), seed);
+    uint h2 = ::qHash(key.y(), seed);
+    return ((h1 << 16) | (h1 >> 16)) ^ h2 ^ seed;
+}
+
+} // namespace Tiled
+
+// QHash only finds the hash function of QPoint keys through argument
+// dependent lookup, which searches the global namespace of QPoint
+using Tiled::qHash;
+
+namespace Tiled {
+
+class GidMapper;
 class Tile;
 
 /**
  * A cell on a tile layer grid.
+ *
+ * Besides the tileset, a cell stores its tile ID and flip flags packed into
+ * 32 bits, so that cells can be compared with two integer comparisons. The
+ * flags take the top three bits, like they do in a GID.
  */
-class Cell
+class TILEDSHARED_EXPORT Cell
 {
 public:
+    static const Cell empty;
+
     Cell() :
         _tileset(nullptr),
-        _tileId(-1),
-        _flippedHorizontally(false),
-        _flippedVertically(false),
-        _flippedAntiDiagonally(false)
+        _value(TileIdMask)      // tile ID -1
     {}
 
     explicit Cell(Tile *tile) :
-        _tileset(tile ? tile->tileset() : nullptr),
-        _tileId(tile ? tile->id() : -1),
-        _flippedHorizontally(false),
-        _flippedVertically(false),
-        _flippedAntiDiagonally(false)
-    {}
+        _tileset(nullptr),
+        _value(TileIdMask)
+    {
+        setTile(tile);
+    }
 
     bool isEmpty() const { return _tileset == nullptr; }
 
     bool operator == (const Cell &other) const
     {
-        return _tileset == other._tileset
-                && _tileId == other._tileId
-                && _flippedHorizontally == other._flippedHorizontally
-                && _flippedVertically == other._flippedVertically
-                && _flippedAntiDiagonally == other._flippedAntiDiagonally;
+        return _tileset == other._tileset && _value == other._value;
     }
 
     bool operator != (const Cell &other) const
     {
-        return _tileset != other._tileset
-                || _tileId != other._tileId
-                || _flippedHorizontally != other._flippedHorizontally
-                || _flippedVertically != other._flippedVertically
-                || _flippedAntiDiagonally != other._flippedAntiDiagonally;
+        return _tileset != other._tileset || _value != other._value;
     }
 
     Tileset *tileset() const { return _tileset; }
-    int tileId() const { return _tileId; }
 
-    bool flippedHorizontally() const { return _flippedHorizontally; }
-    bool flippedVertically() const { return _flippedVertically; }
-    bool flippedAntiDiagonally() const { return _flippedAntiDiagonally; }
+    // Sign-extends the 29-bit tile ID
+    int tileId() const { return int(_value << 3) >> 3; }
 
-    void setFlippedHorizontally(bool f) { _flippedHorizontally = f; }
-    void setFlippedVertically(bool f) { _flippedVertically = f; }
-    void setFlippedAntiDiagonally(bool f) { _flippedAntiDiagonally = f; }
+    bool flippedHorizontally() const { return _value & FlippedHorizontallyFlag; }
+    bool flippedVertically() const { return _value & FlippedVerticallyFlag; }
+    bool flippedAntiDiagonally() const { return _value & FlippedAntiDiagonallyFlag; }
+
+    void setFlippedHorizontally(bool f) { setFlag(FlippedHorizontallyFlag, f); }
+    void setFlippedVertically(bool f) { setFlag(FlippedVerticallyFlag, f); }
+    void setFlippedAntiDiagonally(bool f) { setFlag(FlippedAntiDiagonallyFlag, f); }
 
     Tile *tile() const;
     void setTile(Tile *tile);
     void setTile(Tileset *tileset, int tileId);
 
 private:
+    enum : quint32 {
+        FlippedHorizontallyFlag     = 0x80000000,
+        FlippedVerticallyFlag       = 0x40000000,
+        FlippedAntiDiagonallyFlag   = 0x20000000,
+        FlagsMask                   = 0xE0000000,
+        TileIdMask                  = 0x1FFFFFFF
+    };
+
+    void setFlag(quint32 flag, bool enabled)
+    {
+        if (enabled)
+            _value |= flag;
+        else
+            _value &= ~flag;
+    }
+
     Tileset *_tileset;
-    int _tileId;
-    bool _flippedHorizontally;
-    bool _flippedVertically;
-    bool _flippedAntiDiagonally;
+    quint32 _value;
 };
 
 inline Tile *Cell::tile() const
 {
-    return _tileset ? _tileset->findTile(_tileId) : nullptr;
+    return _tileset ? _tileset->findTile(tileId()) : nullptr;
 }
 
 inline void Cell::setTile(Tile *tile)
@@ -128,7 +155,85 @@ inline void Cell::setTile(Tile *tile)
 inline void Cell::setTile(Tileset *tileset, int tileId)
 {
     _tileset = tileset;
-    _tileId = tileId;
+    _value = (_value & FlagsMask) | (quint32(tileId) & TileIdMask);
+}
+
+static const int CHUNK_BITS = 4;
+static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+static const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+/*
+ * Tile layers store their cells packed into 32 bits. The flip flags take the
+ * top three bits, like they do in a GID, followed by an index into the
+ * tileset table of the layer and the tile ID. The value 0 is an empty cell.
+ *
+ * Cells that don't fit in this layout are stored unpacked in their chunk and
+ * marked with PackedOverflowCell.
+ */
+static const quint32 PackedFlippedHorizontallyFlag   = 0x80000000;
+static const quint32 PackedFlippedVerticallyFlag     = 0x40000000;
+static const quint32 PackedFlippedAntiDiagonallyFlag = 0x20000000;
+static const quint32 PackedFlagsMask                 = 0xE0000000;
+static const int     PackedFlagsShift                = 29;
+static const quint32 PackedTilesetMask               = 0x1FF00000;
+static const int     PackedTilesetShift              = 20;
+static const quint32 PackedTileIdMask                = 0x000FFFFF;
+static const int     OverflowTilesetIndex            = PackedTilesetMask >> PackedTilesetShift;
+static const quint32 PackedOverflowCell              = PackedTilesetMask;
+
+/**
+ * A square block of CHUNK_SIZE x CHUNK_SIZE cells. Tile layers store their
+ * cells in chunks, which are only allocated once a tile is placed in them.
+ *
+ * The chunk stores packed cells. Unpacking them requires the tileset table
+ * of the tile layer that owns the chunk.
+ */
+class TILEDSHARED_EXPORT Chunk
+{
+public:
+    Chunk() :
+        mGrid(CHUNK_SIZE * CHUNK_SIZE)
+    {}
+
+    quint32 packedCellAt(int x, int y) const;
+    const Cell &overflowCellAt(int x, int y) const;
+
+    void setPackedCell(int x, int y, quint32 packedCell);
+    void setOverflowCell(int x, int y, const Cell &cell);
+
+    bool isEmpty() const;
+
+    const QVector<quint32> &packedCells() const { return mGrid; }
+
+private:
+    QVector<quint32> mGrid;
+    QHash<int, Cell> mOverflowCells;
+};
+
+inline quint32 Chunk::packedCellAt(int x, int y) const
+{
+    return mGrid.at(x + y * CHUNK_SIZE);
+}
+
+inline const Cell &Chunk::overflowCellAt(int x, int y) const
+{
+    QHash<int, Cell>::const_iterator it = mOverflowCells.find(x + y * CHUNK_SIZE);
+    return it != mOverflowCells.end() ? it.value() : Cell::empty;
+}
+
+inline void Chunk::setPackedCell(int x, int y, quint32 packedCell)
+{
+    Q_ASSERT(packedCell != PackedOverflowCell);
+    quint32 &existing = mGrid[x + y * CHUNK_SIZE];
+    if (existing == PackedOverflowCell)
+        mOverflowCells.remove(x + y * CHUNK_SIZE);
+    existing = packedCell;
+}
+
+inline void Chunk::setOverflowCell(int x, int y, const Cell &cell)
+{
+    mGrid[x + y * CHUNK_SIZE] = PackedOverflowCell;
+    mOverflowCells.insert(x + y * CHUNK_SIZE, cell);
 }
 
 
@@ -138,10 +243,56 @@ inline void Cell::setTile(Tileset *tileset, int tileId)
  *
  * Coordinates and regions passed to function parameters are in local
  * coordinates and do not take into account the position of the layer.
+ *
+ * The cells are stored in chunks of CHUNK_SIZE x CHUNK_SIZE, which are only
+ * allocated when a tile is placed in them. Empty areas cost no memory and
+ * most operations scale with the number of allocated chunks rather than with
+ * the size of the layer.
  */
 class TILEDSHARED_EXPORT TileLayer : public Layer
 {
 public:
+    /**
+     * Iterates the cells of all allocated chunks. Since cells are stored
+     * packed, they are returned by value.
+     */
+    class const_iterator
+    {
+    public:
+        const_iterator(const TileLayer *layer,
+                       QHash<QPoint, Chunk>::const_iterator it)
+            : mLayer(layer)
+            , mChunkPointer(it)
+            , mIndex(0)
+        {}
+
+        const_iterator &operator++()
+        {
+            if (++mIndex == CHUNK_SIZE * CHUNK_SIZE) {
+                ++mChunkPointer;
+                mIndex = 0;
+            }
+            return *this;
+        }
+
+        Cell operator*() const
+        {
+            return mLayer->unpack(mChunkPointer.value(),
+                                  mIndex & CHUNK_MASK,
+                                  mIndex >> CHUNK_BITS);
+        }
+
+        bool operator==(const const_iterator &other) const
+        { return mChunkPointer == other.mChunkPointer && mIndex == other.mIndex; }
+        bool operator!=(const const_iterator &other) const
+        { return !(*this == other); }
+
+    private:
+        const TileLayer *mLayer;
+        QHash<QPoint, Chunk>::const_iterator mChunkPointer;
+        int mIndex;
+    };
+
     /**
      * Constructor.
      */
@@ -170,6 +321,7 @@ public:
     QRect bounds() const { return QRect(mX, mY, mWidth, mHeight); }
 
     QMargins drawMargins() const;
+    void invalidateDrawMargins();
 
     bool contains(int x, int y) const;
     bool contains(const QPoint &point) const;
@@ -186,8 +338,8 @@ public:
      */
     QRegion region() const;
 
-    const Cell &cellAt(int x, int y) const;
-    const Cell &cellAt(const QPoint &point) const;
+    Cell cellAt(int x, int y) const;
+    Cell cellAt(const QPoint &point) const;
 
     void setCell(int x, int y, const Cell &cell);
 
@@ -237,7 +389,7 @@ public:
     void rotate(RotateDirection direction);
 
     /**
-     * Computes and returns the set of tilesets used by this tile layer.
+     * Returns the set of tilesets used by this tile layer.
      */
     QSet<SharedTileset> usedTilesets() const override;
 
@@ -297,24 +449,64 @@ public:
 
     virtual Layer *clone() const override;
 
-    // Enable easy iteration over cells with range-based for
-    QVector<Cell>::iterator begin() { return mGrid.begin(); }
-    QVector<Cell>::iterator end() { return mGrid.end(); }
-    QVector<Cell>::const_iterator begin() const { return mGrid.begin(); }
-    QVector<Cell>::const_iterator end() const { return mGrid.end(); }
+    /**
+     * Returns the allocated chunks of this layer, keyed by the position of
+     * their top-left cell.
+     */
+    const QHash<QPoint, Chunk> &chunks() const { return mChunks; }
+
+    // Enable easy iteration over the cells of all allocated chunks with
+    // range-based for. Cells in unallocated chunks are not visited.
+    const_iterator begin() const { return const_iterator(this, mChunks.begin()); }
+    const_iterator end() const { return const_iterator(this, mChunks.end()); }
 
 protected:
     TileLayer *initializeClone(TileLayer *clone) const;
 
 private:
+    friend class GidMapper; // for writing decoded layer data directly
+
+    static QPoint chunkPosition(int x, int y)
+    { return QPoint(x & ~CHUNK_MASK, y & ~CHUNK_MASK); }
+
+    const Chunk *findChunk(int x, int y) const;
+    Chunk &chunk(int x, int y);
+
+    quint32 packedCellAt(int x, int y) const;
+    Cell unpack(const Chunk &chunk, int x, int y) const;
+    quint32 pack(const Cell &cell);
+    int tilesetIndex(Tileset *tileset);
+
+    void countCell(quint32 packed, Tileset *overflowTileset, int delta);
+    void countTileset(Tileset *tileset, int delta);
+    void adjustCellCount(int index, int delta);
+    void releaseUnusedTilesetSlots();
+    void recountTilesets();
+
+    QVector<QPoint> sortedChunkPositions() const;
+    QRegion chunksRegion(const QRect &clip, const QPoint &offset) const;
+
     int mWidth;
     int mHeight;
-    QVector<Cell> mGrid;
-    mutable QSet<SharedTileset> mUsedTilesets;
-    mutable bool mUsedTilesetsDirty;
+    QHash<QPoint, Chunk> mChunks;
+    QVector<Tileset*> mTilesetTable;
+    QVector<int> mTilesetCellCounts;                // cells per table entry
+    QHash<Tileset*, int> mOverflowTilesetCellCounts; // when the table is full
+    int mLastTilesetIndex;
+    mutable QMargins mDrawMargins;
+    mutable bool mDrawMarginsDirty;
 };
 
 
+/**
+ * Makes sure the draw margins are recomputed when they are next requested.
+ * Needed after the tile offset or tile size of a used tileset has changed.
+ */
+inline void TileLayer::invalidateDrawMargins()
+{
+    mDrawMarginsDirty = true;
+}
+
 /**
  * Sets the size of this layer.
  */
@@ -343,20 +535,65 @@ inline QRegion TileLayer::region() const
 }
 
 /**
- * Returns a read-only reference to the cell at the given coordinates. The
- * coordinates have to be within this layer.
+ * Returns the cell at the given coordinates. The coordinates have to be
+ * within this layer.
  */
-inline const Cell &TileLayer::cellAt(int x, int y) const
+inline Cell TileLayer::cellAt(int x, int y) const
 {
     Q_ASSERT(contains(x, y));
-    return mGrid.at(x + y * mWidth);
+    if (const Chunk *chunk = findChunk(x, y))
+        return unpack(*chunk, x & CHUNK_MASK, y & CHUNK_MASK);
+    return Cell();
 }
 
-inline const Cell &TileLayer::cellAt(const QPoint &point) const
+inline Cell TileLayer::cellAt(const QPoint &point) const
 {
     return cellAt(point.x(), point.y());
 }
 
+/**
+ * Returns the chunk containing the given cell, or null when that chunk has
+ * not been allocated.
+ */
+inline const Chunk *TileLayer::findChunk(int x, int y) const
+{
+    QHash<QPoint, Chunk>::const_iterator it = mChunks.find(chunkPosition(x, y));
+    return it != mChunks.end() ? &it.value() : nullptr;
+}
+
+/**
+ * Returns the packed cell at the given coordinates, or 0 when its chunk has
+ * not been allocated.
+ */
+inline quint32 TileLayer::packedCellAt(int x, int y) const
+{
+    if (const Chunk *chunk = findChunk(x, y))
+        return chunk->packedCellAt(x & CHUNK_MASK, y & CHUNK_MASK);
+    return 0;
+}
+
+/**
+ * Unpacks the cell at the given chunk-local coordinates, using the tileset
+ * table of this layer.
+ */
+inline Cell TileLayer::unpack(const Chunk &chunk, int x, int y) const
+{
+    const quint32 packed = chunk.packedCellAt(x, y);
+    Cell cell;
+
+    if (packed == 0)
+        return cell;
+    if (packed == PackedOverflowCell)
+        return chunk.overflowCellAt(x, y);
+
+    cell.setTile(mTilesetTable.at((packed & PackedTilesetMask) >> PackedTilesetShift),
+                 packed & PackedTileIdMask);
+    cell.setFlippedHorizontally((packed & PackedFlippedHorizontallyFlag) != 0);
+    cell.setFlippedVertically((packed & PackedFlippedVerticallyFlag) != 0);
+    cell.setFlippedAntiDiagonally((packed & PackedFlippedAntiDiagonallyFlag) != 0);
+    return cell;
+}
+
 typedef QSharedPointer<TileLayer> SharedTileLayer;
 
 } // namespace Tiled
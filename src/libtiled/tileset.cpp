@@ -28,11 +28,15 @@
  */
 
 #include "tileset.h"
+
+#include "imagecache.h"
 #include "tile.h"
 #include "terrain.h"
 
 #include <QBitmap>
 
+#include <climits>
+
 using namespace Tiled;
 
 Tileset::Tileset(QString name, int tileWidth, int tileHeight,
@@ -50,6 +54,9 @@ Tileset::Tileset(QString name, int tileWidth, int tileHeight,
     mExpectedRowCount(0),
     mNextTileId(0),
     mTerrainDistancesDirty(false),
+    mAnimatedTilesDirty(false),
+    mPendingAnimationTime(0),
+    mNextFrameTime(INT_MAX),
     mLoaded(true)
 {
     Q_ASSERT(tileSpacing >= 0);
@@ -174,24 +181,30 @@ bool Tileset::loadFromImage(const QImage &image,
     const int stopWidth = image.width() - tileSize.width();
     const int stopHeight = image.height() - tileSize.height();
 
+    // All tiles share the tileset image, which allows them to be rendered in
+    // a single batch. Other tilesets using the same image share it as well.
+    QPixmap pixmap = ImageCache::toPixmap(image, fileName);
+    const QColor &transparent = mImageReference.transparentColor;
+
+    if (transparent.isValid()) {
+        const QImage mask = image.createMaskFromColor(transparent.rgb());
+        pixmap.setMask(QBitmap::fromImage(mask));
+    }
+
     int tileNum = 0;
 
     for (int y = margin; y <= stopHeight; y += tileSize.height() + spacing) {
         for (int x = margin; x <= stopWidth; x += tileSize.width() + spacing) {
-            const QImage tileImage = image.copy(x, y, tileSize.width(), tileSize.height());
-            QPixmap tilePixmap = QPixmap::fromImage(tileImage);
-            const QColor &transparent = mImageReference.transparentColor;
-
-            if (transparent.isValid()) {
-                const QImage mask = tileImage.createMaskFromColor(transparent.rgb());
-                tilePixmap.setMask(QBitmap::fromImage(mask));
-            }
+            const QRect imageRect(x, y, tileSize.width(), tileSize.height());
 
             auto it = mTiles.find(tileNum);
-            if (it != mTiles.end())
-                it.value()->setImage(tilePixmap);
-            else
-                mTiles.insert(tileNum, new Tile(tilePixmap, tileNum, this));
+            if (it != mTiles.end()) {
+                it.value()->setImage(pixmap, imageRect);
+            } else {
+                Tile *tile = new Tile(tileNum, this);
+                tile->setImage(pixmap, imageRect);
+                mTiles.insert(tileNum, tile);
+            }
 
             ++tileNum;
         }
@@ -407,6 +420,20 @@ int Tileset::terrainTransitionPenalty(int terrainType0, int terrainType1) const
     return mTerrainTypes.at(terrainType0)->transitionDistance(terrainType1);
 }
 
+/**
+ * Rebuilds the list of tiles that have animation frames.
+ */
+void Tileset::updateAnimatedTiles()
+{
+    mAnimatedTiles.clear();
+
+    for (Tile *tile : mTiles)
+        if (tile->isAnimated())
+            mAnimatedTiles.append(tile);
+
+    mAnimatedTilesDirty = false;
+}
+
 /**
  * Calculates the transition distance matrix for all terrain types.
  */
@@ -523,6 +550,7 @@ void Tileset::addTiles(const QList<Tile *> &tiles)
     }
 
     updateTileSize();
+    markAnimatedTilesDirty();
 }
 
 /**
@@ -538,6 +566,7 @@ void Tileset::removeTiles(const QList<Tile *> &tiles)
     }
 
     updateTileSize();
+    markAnimatedTilesDirty();
 }
 
 /**
@@ -546,6 +575,70 @@ void Tileset::removeTiles(const QList<Tile *> &tiles)
 void Tileset::deleteTile(int id)
 {
     delete mTiles.take(id);
+    markAnimatedTilesDirty();
+}
+
+/**
+ * Returns the tiles of this tileset that have animation frames.
+ */
+const QList<Tile *> &Tileset::animatedTiles() const
+{
+    if (mAnimatedTilesDirty)
+        const_cast<Tileset*>(this)->updateAnimatedTiles();
+
+    return mAnimatedTiles;
+}
+
+/**
+ * Resets the animations of all animated tiles. Returns whether this caused
+ * any of their current frames to change.
+ */
+bool Tileset::resetAnimations()
+{
+    bool imageChanged = false;
+
+    for (Tile *tile : animatedTiles())
+        imageChanged |= tile->resetAnimation();
+
+    mPendingAnimationTime = 0;
+    mNextFrameTime = 0;
+
+    return imageChanged;
+}
+
+/**
+ * Advances the animations of all animated tiles by the given amount of
+ * milliseconds. Returns whether this caused any of their current frames to
+ * change.
+ *
+ * The time is accumulated until the earliest frame change is due, so that
+ * ticks in between don't need to touch any of the tiles.
+ */
+bool Tileset::advanceAnimations(int ms)
+{
+    // Without animated tiles there is nothing to accumulate time for
+    if (!mAnimatedTilesDirty && mNextFrameTime == INT_MAX) {
+        mPendingAnimationTime = 0;
+        return false;
+    }
+
+    mPendingAnimationTime += ms;
+
+    if (!mAnimatedTilesDirty && mPendingAnimationTime < mNextFrameTime)
+        return false;
+
+    bool imageChanged = false;
+    int nextFrameTime = INT_MAX;
+
+    for (Tile *tile : animatedTiles()) {
+        imageChanged |= tile->advanceAnimation(mPendingAnimationTime);
+        nextFrameTime = qMin(nextFrameTime, tile->remainingFrameTime());
+    }
+
+    mPendingAnimationTime = 0;
+    mNextFrameTime = nextFrameTime;
+
+    return imageChanged;
 }
 
 /**
@@ -562,26 +655,35 @@ void Tileset::setTileImage(Tile *tile,
     Q_ASSERT(isCollection());
     Q_ASSERT(mTiles.value(tile->id()) == tile);
 
-    const QSize previousImageSize = tile->image().size();
-    const QSize newImageSize = image.size();
+    const QSize previousImageSize = tile->size();
 
     tile->setImage(image);
     tile->setImageSource(source);
 
-    if (previousImageSize != newImageSize) {
-        // Update our max. tile size
-        if (previousImageSize.height() == mTileHeight ||
-                previousImageSize.width() == mTileWidth) {
-            // This used to be the max image; we have to recompute
-            updateTileSize();
-        } else {
-            // Check if we have a new maximum
-            if (mTileHeight < newImageSize.height())
-                mTileHeight = newImageSize.height();
-            if (mTileWidth < newImageSize.width())
-                mTileWidth = newImageSize.width();
-        }
-    }
+    updateTileSize(previousImageSize, image.size());
+}
+
+/**
+ * Sets the given \a tile to load its image from \a source once it is first
+ * needed. The given \a imageSize is taken as the size of the tile, so
+ * that the image doesn't need to be loaded for layout purposes.
+ *
+ * It is only expected to be used for image collection tilesets.
+ *
+ * \sa Tile::setDeferredImage()
+ */
+void Tileset::setDeferredTileImage(Tile *tile,
+                                   const QString &source,
+                                   const QSize &imageSize)
+{
+    Q_ASSERT(isCollection());
+    Q_ASSERT(mTiles.value(tile->id()) == tile);
+
+    const QSize previousImageSize = tile->size();
+
+    tile->setDeferredImage(source, imageSize);
+
+    updateTileSize(previousImageSize, imageSize);
 }
 
 void Tileset::swap(Tileset &other)
@@ -602,6 +704,10 @@ void Tileset::swap(Tileset &other)
     std::swap(mNextTileId, other.mNextTileId);
     std::swap(mTerrainTypes, other.mTerrainTypes);
     std::swap(mTerrainDistancesDirty, other.mTerrainDistancesDirty);
+    std::swap(mAnimatedTiles, other.mAnimatedTiles);
+    std::swap(mAnimatedTilesDirty, other.mAnimatedTilesDirty);
+    std::swap(mPendingAnimationTime, other.mPendingAnimationTime);
+    std::swap(mNextFrameTime, other.mNextFrameTime);
     std::swap(mLoaded, other.mLoaded);
     std::swap(mBackgroundColor, other.mBackgroundColor);
 
@@ -645,6 +751,7 @@ SharedTileset Tileset::clone() const
 
         c->mTiles.insert(id, tile->clone(c.data()));
     }
+    c->markAnimatedTilesDirty();
 
     c->mTerrainTypes.reserve(mTerrainTypes.size());
     for (Terrain *terrain : mTerrainTypes)
@@ -671,6 +778,29 @@ void Tileset::updateTileSize()
     mTileHeight = maxHeight;
 }
 
+/**
+ * Updates the tile size after the image of one of the tiles changed from
+ * \a previousImageSize to \a newImageSize.
+ */
+void Tileset::updateTileSize(const QSize &previousImageSize,
+                             const QSize &newImageSize)
+{
+    if (previousImageSize == newImageSize)
+        return;
+
+    if (previousImageSize.height() == mTileHeight ||
+            previousImageSize.width() == mTileWidth) {
+        // This used to be the max image; we have to recompute
+        updateTileSize();
+    } else {
+        // Check if we have a new maximum
+        if (mTileHeight < newImageSize.height())
+            mTileHeight = newImageSize.height();
+        if (mTileWidth < newImageSize.width())
+            mTileWidth = newImageSize.width();
+    }
+}
+
 
 QString Tileset::orientationToString(Tileset::Orientation orientation)
 {
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include "imagecache.h"
 #include "imagereference.h"
 #include "object.h"
 
@@ -191,9 +192,17 @@ public:
     void setTileImage(Tile *tile,
                       const QPixmap &image,
                       const QString &source = QString());
+    void setDeferredTileImage(Tile *tile,
+                              const QString &source,
+                              const QSize &imageSize);
 
     void markTerrainDistancesDirty();
 
+    const QList<Tile*> &animatedTiles() const;
+    void markAnimatedTilesDirty();
+    bool resetAnimations();
+    bool advanceAnimations(int ms);
+
     SharedTileset sharedPointer() const;
 
     void setLoaded(bool loaded);
@@ -223,7 +232,10 @@ public:
 
 private:
     void updateTileSize();
+    void updateTileSize(const QSize &previousImageSize,
+                        const QSize &newImageSize);
     void recalculateTerrainDistances();
+    void updateAnimatedTiles();
 
     QString mName;
     QString mFileName;
@@ -242,6 +254,10 @@ private:
     int mNextTileId;
     QList<Terrain*> mTerrainTypes;
     bool mTerrainDistancesDirty;
+    QList<Tile*> mAnimatedTiles;
+    bool mAnimatedTilesDirty;
+    int mPendingAnimationTime;
+    int mNextFrameTime;
     bool mLoaded;
     QColor mBackgroundColor;
 
@@ -501,7 +517,7 @@ inline void Tileset::setBackgroundColor(QColor color)
  */
 inline bool Tileset::loadFromImage(const QString &fileName)
 {
-    return loadFromImage(QImage(fileName), fileName);
+    return loadFromImage(ImageCache::loadImage(fileName), fileName);
 }
 
 /**
@@ -580,6 +596,15 @@ inline void Tileset::markTerrainDistancesDirty()
     mTerrainDistancesDirty = true;
 }
 
+/**
+ * Used by the Tile class when its animation frames change, and whenever tiles
+ * are added or removed.
+ */
+inline void Tileset::markAnimatedTilesDirty()
+{
+    mAnimatedTilesDirty = true;
+}
+
 inline SharedTileset Tileset::sharedPointer() const
 {
     return SharedTileset(mWeakPointer);
@@ -30,6 +30,7 @@
 #include "tilesetmanager.h"
 
 #include "filesystemwatcher.h"
+#include "imagecache.h"
 #include "tileanimationdriver.h"
 #include "tile.h"
 
@@ -135,8 +136,12 @@ void TilesetManager::reloadImages(const SharedTileset &tileset)
         return;
 
     if (tileset->isCollection()) {
-        for (Tile *tile : tileset->tiles())
-            tile->setImage(QPixmap(tile->imageSource()));
+        for (Tile *tile : tileset->tiles()) {
+            if (tile->isImageDeferred())
+                tile->setDeferredImage(tile->imageSource(), tile->size());
+            else
+                tile->setImage(ImageCache::loadPixmap(tile->imageSource()));
+        }
         emit tilesetImagesChanged(tileset.data());
     } else {
         if (tileset->loadImage())
@@ -180,6 +185,9 @@ void TilesetManager::tilesetImageSourceChanged(const Tileset &tileset,
 
 void TilesetManager::fileChanged(const QString &path)
 {
+    // The cached image is out of date either way
+    ImageCache::remove(path);
+
     if (!mReloadTilesetsOnChange)
         return;
 
@@ -210,35 +218,19 @@ void TilesetManager::fileChangedTimeout()
  */
 void TilesetManager::resetTileAnimations()
 {
-    const QList<SharedTileset> &_tilesets = tilesets();
-
-    // TODO: This could be more optimal by keeping track of the list of
-    // actually animated tiles
-    for (const SharedTileset &tileset : _tilesets) {
-        bool imageChanged = false;
-
-        for (Tile *tile : tileset->tiles())
-            imageChanged |= tile->resetAnimation();
-
-        if (imageChanged)
-            emit repaintTileset(tileset.data());
+    for (auto it = mTilesets.cbegin(), end = mTilesets.cend(); it != end; ++it) {
+        Tileset *tileset = it.key().data();
+        if (tileset->resetAnimations())
+            emit repaintTileset(tileset);
     }
 }
 
 void TilesetManager::advanceTileAnimations(int ms)
 {
-    const QList<SharedTileset> &_tilesets = tilesets();
-
-    // TODO: This could be more optimal by keeping track of the list of
-    // actually animated tiles
-    for (const SharedTileset &tileset : _tilesets) {
-        bool imageChanged = false;
-
-        for (Tile *tile : tileset->tiles())
-            imageChanged |= tile->advanceAnimation(ms);
-
-        if (imageChanged)
-            emit repaintTileset(tileset.data());
+    for (auto it = mTilesets.cbegin(), end = mTilesets.cend(); it != end; ++it) {
+        Tileset *tileset = it.key().data();
+        if (tileset->advanceAnimations(ms))
+            emit repaintTileset(tileset);
     }
 }
 
@@ -22,6 +22,7 @@
 #include "varianttomapconverter.h"
 
 #include "grouplayer.h"
+#include "imagecache.h"
 #include "imagelayer.h"
 #include "map.h"
 #include "objectgroup.h"
@@ -32,6 +33,7 @@
 #include "tileset.h"
 #include "tilesetformat.h"
 
+#include <QDebug>
 #include <QScopedPointer>
 
 namespace Tiled {
@@ -278,7 +280,7 @@ SharedTileset VariantToMapConverter::toTileset(const QVariant &variant)
         imageVariant = tileVar[QLatin1String("image")];
         if (!imageVariant.isNull()) {
             QString imagePath = resolvePath(mMapDir, imageVariant);
-            tileset->setTileImage(tile, QPixmap(imagePath), imagePath);
+            tileset->setTileImage(tile, ImageCache::loadPixmap(imagePath), imagePath);
         }
         QVariantMap objectGroupVariant = tileVar[QLatin1String("objectgroup")].toMap();
         if (!objectGroupVariant.isEmpty())
@@ -384,6 +386,20 @@ TileLayer *VariantToMapConverter::toTileLayer(const QVariantMap &variantMap)
     switch (layerDataFormat) {
     case Map::XML:
     case Map::CSV: {
+        // The layer data may already have been read in compact form
+        if (dataVariant.userType() == qMetaTypeId<QVector<unsigned>>()) {
+            const QVector<unsigned> gids = dataVariant.value<QVector<unsigned>>();
+
+            if (gids.size() != width * height) {
+                mError = tr("Corrupt layer data for layer '%1'").arg(name);
+                return nullptr;
+            }
+
+            if (!handleDecodeError(*tileLayer, mGidMapper.decodeLayerData(*tileLayer, gids), true))
+                return nullptr;
+            break;
+        }
+
         const QVariantList dataVariantList = dataVariant.toList();
 
         if (dataVariantList.size() != width * height) {
@@ -391,28 +407,24 @@ TileLayer *VariantToMapConverter::toTileLayer(const QVariantMap &variantMap)
             return nullptr;
         }
 
-        int x = 0;
-        int y = 0;
+        QVector<unsigned> gids;
+        gids.reserve(dataVariantList.size());
         bool ok;
 
         for (const QVariant &gidVariant : dataVariantList) {
             const unsigned gid = gidVariant.toUInt(&ok);
             if (!ok) {
+                const int index = gids.size();
                 mError = tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                        .arg(x).arg(y).arg(tileLayer->name());
+                        .arg(index % width).arg(index / width).arg(tileLayer->name());
                 return nullptr;
             }
 
-            const Cell cell = mGidMapper.gidToCell(gid, ok);
-
-            tileLayer->setCell(x, y, cell);
-
-            x++;
-            if (x >= tileLayer->width()) {
-                x = 0;
-                y++;
-            }
+            gids.append(gid);
         }
+
+        if (!handleDecodeError(*tileLayer, mGidMapper.decodeLayerData(*tileLayer, gids), true))
+            return nullptr;
         break;
     }
 
@@ -424,20 +436,8 @@ TileLayer *VariantToMapConverter::toTileLayer(const QVariantMap &variantMap)
                                                                   data,
                                                                   layerDataFormat);
 
-        switch (error) {
-        case GidMapper::CorruptLayerData:
-            mError = tr("Corrupt layer data for layer '%1'").arg(name);
-            return nullptr;
-        case GidMapper::TileButNoTilesets:
-            mError = tr("Tile used but no tilesets specified");
+        if (!handleDecodeError(*tileLayer, error))
             return nullptr;
-        case GidMapper::InvalidTile:
-            mError = tr("Invalid tile: %1").arg(mGidMapper.invalidTile());
-            return nullptr;
-        case GidMapper::NoError:
-            break;
-        }
-
         break;
     }
     }
@@ -445,6 +445,41 @@ TileLayer *VariantToMapConverter::toTileLayer(const QVariantMap &variantMap)
     return tileLayer.take();
 }
 
+/**
+ * Sets the error message for the given decode \a error. Returns whether no
+ * error occurred.
+ *
+ * When \a allowInvalidTiles is set, cells with an invalid GID have been left
+ * empty and only a warning is printed, so that such maps can still be opened.
+ */
+bool VariantToMapConverter::handleDecodeError(const TileLayer &tileLayer,
+                                              GidMapper::DecodeError error,
+                                              bool allowInvalidTiles)
+{
+    if (allowInvalidTiles && (error == GidMapper::TileButNoTilesets ||
+                              error == GidMapper::InvalidTile)) {
+        qWarning().noquote() << tr("Invalid tile %1 on layer '%2', leaving it empty")
+                                .arg(mGidMapper.invalidTile()).arg(tileLayer.name());
+        return true;
+    }
+
+    switch (error) {
+    case GidMapper::CorruptLayerData:
+        mError = tr("Corrupt layer data for layer '%1'").arg(tileLayer.name());
+        return false;
+    case GidMapper::TileButNoTilesets:
+        mError = tr("Tile used but no tilesets specified");
+        return false;
+    case GidMapper::InvalidTile:
+        mError = tr("Invalid tile: %1").arg(mGidMapper.invalidTile());
+        return false;
+    case GidMapper::NoError:
+        break;
+    }
+
+    return true;
+}
+
 ObjectGroup *VariantToMapConverter::toObjectGroup(const QVariantMap &variantMap)
 {
     typedef QScopedPointer<ObjectGroup> ObjectGroupPtr;
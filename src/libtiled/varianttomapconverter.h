@@ -82,6 +82,9 @@ private:
     SharedTileset toTileset(const QVariant &variant);
     Layer *toLayer(const QVariant &variant);
     TileLayer *toTileLayer(const QVariantMap &variantMap);
+    bool handleDecodeError(const TileLayer &tileLayer,
+                           GidMapper::DecodeError error,
+                           bool allowInvalidTiles = false);
     ObjectGroup *toObjectGroup(const QVariantMap &variantMap);
     ImageLayer *toImageLayer(const QVariantMap &variantMap);
     GroupLayer *toGroupLayer(const QVariantMap &variantMap);
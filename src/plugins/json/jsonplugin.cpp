@@ -57,6 +57,8 @@ Tiled::Map *JsonMapFormat::read(const QString &fileName)
     }
 
     JsonReader reader;
+    reader.setCompactArrayKey(QLatin1String("data"));
+
     QByteArray contents = file.readAll();
     if (mSubFormat == JavaScript && contents.size() > 0 && contents[0] != '{') {
         // Scan past JSONP prefix; look for an open curly at the start of the line
@@ -69,6 +71,7 @@ Tiled::Map *JsonMapFormat::read(const QString &fileName)
         }
     }
     reader.parse(contents);
+    contents.clear();   // no longer needed, free it before building the map
 
     const QVariant variant = reader.result();
 
@@ -96,17 +99,12 @@ bool JsonMapFormat::write(const Tiled::Map *map, const QString &fileName)
     }
 
     Tiled::MapToVariantConverter converter;
+    converter.setCompactTileLayerData(true);
     QVariant variant = converter.toVariant(*map, QFileInfo(fileName).dir());
 
     JsonWriter writer;
     writer.setAutoFormatting(true);
 
-    if (!writer.stringify(variant)) {
-        // This can only happen due to coding error
-        mError = writer.errorString();
-        return false;
-    }
-
     QTextStream out(file.device());
     if (mSubFormat == JavaScript) {
         // Trim and escape name
@@ -123,7 +121,12 @@ bool JsonMapFormat::write(const Tiled::Map *map, const QString &fileName)
         out << "  module.exports = data;\n";
         out << " }})(" << nameWriter.result() << ",\n";
     }
-    out << writer.result();
+    // Write straight to the file, to avoid holding the whole document in memory
+    if (!writer.stringify(variant, out)) {
+        // This can only happen due to coding error
+        mError = writer.errorString();
+        return false;
+    }
     if (mSubFormat == JavaScript) {
         out << ");";
     }
@@ -272,14 +275,12 @@ bool JsonTilesetFormat::write(const Tiled::Tileset &tileset,
     JsonWriter writer;
     writer.setAutoFormatting(true);
 
-    if (!writer.stringify(variant)) {
+    QTextStream out(file.device());
+    if (!writer.stringify(variant, out)) {
         // This can only happen due to coding error
         mError = writer.errorString();
         return false;
     }
-
-    QTextStream out(file.device());
-    out << writer.result();
     out.flush();
 
     if (file.error() != QFileDevice::NoError) {
@@ -11,6 +11,7 @@
 #include "jsonparser.cpp"
 
 #include <QTextCodec>
+#include <QTextStream>
 #include <qnumeric.h>
 
 /*!
@@ -134,6 +135,7 @@ bool JsonReader::parse(const QString &str)
 {
     JsonLexer lexer(str);
     JsonParser parser;
+    parser.setCompactArrayKey(m_compactArrayKey);
     if (!parser.parse(&lexer)) {
         m_errorString = parser.errorMessage();
         m_result = QVariant();
@@ -144,6 +146,26 @@ bool JsonReader::parse(const QString &str)
     return true;
 }
 
+/*!
+  Sets the \a key under which arrays of non-negative integers are returned as a
+  QVector<unsigned> instead of a QVariantList. Such arrays, like the tile layer
+  data, take a lot less memory that way.
+
+  By default, no key is set and all arrays are returned as QVariantList.
+ */
+void JsonReader::setCompactArrayKey(const QString &key)
+{
+    m_compactArrayKey = key;
+}
+
+/*!
+  Returns the key under which arrays of numbers are returned compactly.
+ */
+QString JsonReader::compactArrayKey() const
+{
+    return m_compactArrayKey;
+}
+
 /*!
   Returns the result of the last parse() call.
 
@@ -198,7 +220,7 @@ QString JsonReader::errorString() const
   Creates a JsonWriter.
  */
 JsonWriter::JsonWriter()
-    : m_autoFormatting(false), m_autoFormattingIndent(4, QLatin1Char(' '))
+    : m_out(0), m_autoFormatting(false), m_autoFormattingIndent(4, QLatin1Char(' '))
 {
 }
 
@@ -284,7 +306,7 @@ static QString escape(const QVariant &variant)
             res += QLatin1String("\\\\");
         } else if (str[i] == QLatin1Char('/')) {
             res += QLatin1String("\\/");
-        } else if (str[i].unicode() > 127) {
+        } else if (str[i].unicode() < 0x20 || str[i].unicode() > 127) {
             res += QLatin1String("\\u") + QString::number(str[i].unicode(), 16).rightJustified(4, QLatin1Char('0'));
         } else {
             res += str[i];
@@ -299,80 +321,93 @@ static QString escape(const QVariant &variant)
 void JsonWriter::stringify(const QVariant &variant, int depth)
 {
     if (variant.type() == QVariant::List || variant.type() == QVariant::StringList) {
-        m_result += QLatin1Char('[');
+        *m_out << QLatin1Char('[');
         QVariantList list = variant.toList();
         for (int i = 0; i < list.count(); i++) {
             if (i != 0) {
-                m_result += QLatin1Char(',');
+                *m_out << QLatin1Char(',');
                 if (m_autoFormatting)
-                    m_result += QLatin1Char(' ');
+                    *m_out << QLatin1Char(' ');
             }
             stringify(list[i], depth+1);
         }
-        m_result += QLatin1Char(']');
+        *m_out << QLatin1Char(']');
+    } else if (variant.userType() == qMetaTypeId<QVector<unsigned> >()) {
+        // Compact form of a large array of numbers, like tile layer data
+        const QVector<unsigned> numbers = variant.value<QVector<unsigned> >();
+        *m_out << QLatin1Char('[');
+        for (int i = 0; i < numbers.size(); i++) {
+            if (i != 0) {
+                *m_out << QLatin1Char(',');
+                if (m_autoFormatting)
+                    *m_out << QLatin1Char(' ');
+            }
+            *m_out << numbers.at(i);
+        }
+        *m_out << QLatin1Char(']');
     } else if (variant.type() == QVariant::Map) {
         QString indent = m_autoFormattingIndent.repeated(depth);
         QVariantMap map = variant.toMap();
         if (m_autoFormatting && depth != 0) {
-            m_result += QLatin1Char('\n');
-            m_result += indent;
-            m_result += QLatin1String("{\n");
+            *m_out << QLatin1Char('\n');
+            *m_out << indent;
+            *m_out << QLatin1String("{\n");
         } else {
-            m_result += QLatin1Char('{');
+            *m_out << QLatin1Char('{');
         }
         for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
             if (it != map.constBegin()) {
-                m_result += QLatin1Char(',');
+                *m_out << QLatin1Char(',');
                 if (m_autoFormatting)
-                    m_result += QLatin1Char('\n');
+                    *m_out << QLatin1Char('\n');
             }
             if (m_autoFormatting)
-                m_result += indent + QLatin1Char(' ');
-            m_result += QLatin1Char('\"') + escape(it.key()) + QLatin1String("\":");
+                *m_out << indent + QLatin1Char(' ');
+            *m_out << QLatin1Char('\"') + escape(it.key()) + QLatin1String("\":");
             stringify(it.value(), depth+1);
         }
         if (m_autoFormatting) {
-            m_result += QLatin1Char('\n');
-            m_result += indent;
+            *m_out << QLatin1Char('\n');
+            *m_out << indent;
         }
-        m_result += QLatin1Char('}');
+        *m_out << QLatin1Char('}');
     } else if (variant.type() == QVariant::String || variant.type() == QVariant::ByteArray) {
-        m_result += QLatin1Char('\"') + escape(variant) + QLatin1Char('\"');
+        *m_out << QLatin1Char('\"') + escape(variant) + QLatin1Char('\"');
     } else if (variant.type() == QVariant::Double || (int)variant.type() == (int)QMetaType::Float) {
         double d = variant.toDouble();
         if (qIsFinite(d))
-            m_result += QString::number(variant.toDouble(), 'g', 15);
+            *m_out << QString::number(variant.toDouble(), 'g', 15);
         else
-            m_result += QLatin1String("null");
+            *m_out << QLatin1String("null");
     } else if (variant.type() == QVariant::Bool) {
-        m_result += variant.toBool() ? QLatin1String("true") : QLatin1String("false");
+        *m_out << (variant.toBool() ? QLatin1String("true") : QLatin1String("false"));
     } else if (variant.type() == QVariant::Invalid) {
-        m_result += QLatin1String("null");
+        *m_out << QLatin1String("null");
     } else if (variant.type() == QVariant::ULongLong) {
-        m_result += QString::number(variant.toULongLong());
+        *m_out << QString::number(variant.toULongLong());
     } else if (variant.type() == QVariant::LongLong) {
-        m_result += QString::number(variant.toLongLong());
+        *m_out << QString::number(variant.toLongLong());
     } else if (variant.type() == QVariant::Int) {
-        m_result += QString::number(variant.toInt());
+        *m_out << QString::number(variant.toInt());
     } else if (variant.type() == QVariant::UInt) {
-        m_result += QString::number(variant.toUInt());
+        *m_out << QString::number(variant.toUInt());
     } else if (variant.type() == QVariant::Char) {
         QChar c = variant.toChar();
         if (c.unicode() > 127)
-            m_result += QLatin1String("\"\\u") + QString::number(c.unicode(), 16).rightJustified(4, QLatin1Char('0')) + QLatin1Char('\"');
+            *m_out << QLatin1String("\"\\u") + QString::number(c.unicode(), 16).rightJustified(4, QLatin1Char('0')) + QLatin1Char('\"');
         else
-            m_result += QLatin1Char('\"') + c + QLatin1Char('\"');
+            *m_out << QLatin1Char('\"') + c + QLatin1Char('\"');
     } else if (variant.canConvert<qlonglong>()) {
-        m_result += QString::number(variant.toLongLong());
+        *m_out << QString::number(variant.toLongLong());
     } else if (variant.canConvert<QString>()) {
-        m_result += QLatin1Char('\"') + escape(variant) + QLatin1Char('\"');
+        *m_out << QLatin1Char('\"') + escape(variant) + QLatin1Char('\"');
     } else {
         if (!m_errorString.isEmpty())
             m_errorString.append(QLatin1Char('\n'));
         QString msg = QString::fromLatin1("Unsupported type %1 (id: %2)").arg(QString::fromUtf8(variant.typeName())).arg(variant.userType());
         m_errorString.append(msg);
         qWarning() << "JsonWriter::stringify - " << msg;
-        m_result += QLatin1String("null");
+        *m_out << QLatin1String("null");
     }
 }
 
@@ -412,14 +447,32 @@ void JsonWriter::stringify(const QVariant &variant, int depth)
   As a fallback, the writer attempts to convert a type not listed above into a long long or a
   QString using QVariant::canConvert. See the QVariant documentation for possible conversions.
 
+  In addition, a QVector<unsigned> is converted into a JSON array of numbers. This allows
+  large arrays of numbers to be stored compactly.
+
   JsonWriter does not support stringizing custom user types stored in the QVariant. Any such
   value would be converted into JSON null.
  */
 bool JsonWriter::stringify(const QVariant &var)
 {
-    m_errorString.clear();
     m_result.clear();
+    QTextStream out(&m_result);
+    return stringify(var, out);
+}
+
+/*!
+  Converts the variant \a var into JSON, writing it directly to the given \a out stream.
+
+  Unlike stringify(), this does not keep the result in memory, so result() will not
+  return it.
+ */
+bool JsonWriter::stringify(const QVariant &var, QTextStream &out)
+{
+    m_errorString.clear();
+    m_out = &out;
     stringify(var, 0 /* depth */);
+    m_out->flush();
+    m_out = 0;
     return m_errorString.isEmpty();
 }
 
@@ -12,6 +12,8 @@
 #include <QByteArray>
 #include <QVariant>
 
+class QTextStream;
+
 class JsonReader
 {
 public:
@@ -25,9 +27,13 @@ public:
 
     QString errorString() const;
 
+    void setCompactArrayKey(const QString &key);
+    QString compactArrayKey() const;
+
 private:
     QVariant m_result;
     QString m_errorString;
+    QString m_compactArrayKey;
 };
 
 class JsonWriter
@@ -37,6 +43,7 @@ public:
     ~JsonWriter();
 
     bool stringify(const QVariant &variant);
+    bool stringify(const QVariant &variant, QTextStream &out);
 
     QString result() const;
 
@@ -52,6 +59,7 @@ private:
     void stringify(const QVariant &variant, int depth);
 
     QString m_result;
+    QTextStream *m_out;
     QString m_errorString;
     bool m_autoFormatting;
     QString m_autoFormattingIndent;
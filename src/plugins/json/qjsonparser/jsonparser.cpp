@@ -1,4 +1,11 @@
 // This file was generated by qlalr - DO NOT EDIT!
+//
+// NOTE: This file has since diverged from its grammar (json.g, which is not
+// part of this tree). The parser was extended by hand to collect arrays under
+// the compact array key into a QVector<unsigned> (see appendToArray(), the
+// shift action and the reduce actions of rules 12 to 14). Regenerating this
+// file from the grammar would drop those changes, so they need to be ported
+// to the grammar first.
 #ifndef JSONPARSER_CPP
 #define JSONPARSER_CPP
 
@@ -194,6 +201,8 @@ public:
 
     bool parse(JsonLexer *lex);
     QVariant result() const { return m_result; }
+
+    void setCompactArrayKey(const QString &key) { m_compactArrayKey = key; }
     QString errorMessage() const { return QString::fromLatin1("%1 at line %2 pos %3").arg(m_errorMessage).arg(m_errorLineNumber).arg(m_errorPos); }
 
 private:
@@ -206,11 +215,22 @@ private:
     inline QVariantList &list(int index)
     { return m_listStack[m_tos + index - 1]; }
 
+    void appendToArray(QVariantList &list, const QVariant &value);
+
+    struct Array {
+        bool compact;
+        QVector<unsigned> numbers;
+    };
+
     int m_tos;
     QVector<int> m_stateStack;
     QVector<QVariant> m_symStack;
     QVector<QVariantMap> m_mapStack;
     QVector<QVariantList> m_listStack;
+    QVector<Array> m_arrayStack;
+    QString m_compactArrayKey;
+    int m_lastToken;
+    QString m_lastKey;
     QString m_errorMessage;
     int m_errorLineNumber;
     int m_errorPos;
@@ -401,6 +421,7 @@ int JsonLexer::lex()
 
 JsonParser::JsonParser()
     : m_tos(0)
+    , m_lastToken(-1)
     , m_errorLineNumber(-1)
     , m_errorPos(-1)
 {
@@ -424,6 +445,34 @@ void JsonParser::reallocateStack()
     m_stateStack.resize(size);
 }
 
+/*
+  Appends \a value to the innermost array. Arrays of non-negative integers under
+  the compact array key are collected as a QVector<unsigned>, which takes a lot
+  less memory than a QVariantList. They fall back to a QVariantList when another
+  value is encountered.
+ */
+void JsonParser::appendToArray(QVariantList &list, const QVariant &value)
+{
+    Array &array = m_arrayStack.last();
+
+    if (array.compact) {
+        bool ok = value.type() == QVariant::LongLong;
+        const qlonglong number = value.toLongLong();
+        if (ok && number >= 0 && number <= 0xFFFFFFFFLL) {
+            array.numbers.append(unsigned(number));
+            return;
+        }
+
+        list.reserve(array.numbers.size() + 1);
+        for (unsigned n : array.numbers)
+            list.append(QVariant(qlonglong(n)));
+        array.numbers.clear();
+        array.compact = false;
+    }
+
+    list.append(value);
+}
+
 bool JsonParser::parse(JsonLexer *lexer)
 {
     const int INITIAL_STATE = 0;
@@ -445,6 +494,18 @@ bool JsonParser::parse(JsonLexer *lexer)
                 reallocateStack();
             m_stateStack[m_tos] = act;
             m_symStack[m_tos] = lexer->symbol();
+
+            // Not generated: tracks arrays to collect compactly
+            if (yytoken == T_COLON) {
+                m_lastKey = m_symStack[m_tos - 1].toString();
+            } else if (yytoken == T_LSQUAREBRACKET) {
+                Array array;
+                array.compact = !m_compactArrayKey.isEmpty() &&
+                        m_lastToken == T_COLON && m_lastKey == m_compactArrayKey;
+                m_arrayStack.append(array);
+            }
+            m_lastToken = yytoken;
+
             yytoken = -1;
         } else if (act < 0) {
             int r = -act-1;
@@ -467,11 +528,18 @@ bool JsonParser::parse(JsonLexer *lexer)
 #line 352 "json.g"
           case 6: { sym(1) = QVariant(true); break; } 
 #line 361 "json.g"
-          case 12: { sym(1) = list(2); break; } 
+          case 12: { // Not generated: compact arrays
+              Array array = m_arrayStack.takeLast();
+              if (array.compact)
+                  sym(1) = QVariant::fromValue(array.numbers);
+              else
+                  sym(1) = list(2);
+              break;
+          }
 #line 364 "json.g"
-          case 13: { QVariantList l; l.append(sym(1)); list(1) = l; break; } 
+          case 13: { QVariantList l; appendToArray(l, sym(1)); list(1) = l; break; } 
 #line 367 "json.g"
-          case 14: { list(1).append(sym(3)); break; } 
+          case 14: { appendToArray(list(1), sym(3)); break; } 
 #line 370 "json.g"
           case 15: { list(1) = QVariantList(); break; } 
 #line 372 "json.g"
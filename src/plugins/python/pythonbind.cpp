@@ -2959,7 +2959,7 @@ _wrap_PyTiledTile_image(PyTiledTile *self)
     PyObject *py_retval;
     PyQPixmap *py_QPixmap;
 
-    QPixmap const & retval = self->obj->image();
+    QPixmap const retval = self->obj->image().copy(self->obj->imageRect());
     py_QPixmap = PyObject_New(PyQPixmap, &PyQPixmap_Type);
     py_QPixmap->flags = PYBINDGEN_WRAPPER_FLAG_NONE;
     py_QPixmap->obj = new QPixmap(retval);
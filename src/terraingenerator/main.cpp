@@ -381,7 +381,7 @@ int main(int argc, char *argv[])
         int nextTileId = targetTileset->nextTileId();
         for (int id = nextTileId - 1; id >= 0; --id) {
             if (Tile *tile = targetTileset->findTile(id)) {
-                if (isEmpty(tile->image().toImage())) {
+                if (isEmpty(tile->image().copy(tile->imageRect()).toImage())) {
                     targetTileset->deleteTile(id);
                     nextTileId = id;
                     continue;
@@ -481,7 +481,7 @@ int main(int argc, char *argv[])
     foreach (Terrain *terrain, terrains) {
         if (!hasTerrain(*targetTileset, terrain->name())) {
             Tile *terrainTile = terrain->imageTile();
-            QPixmap terrainImage = terrainTile->image();
+            QPixmap terrainImage = terrainTile->image().copy(terrainTile->imageRect());
 
             Tile *newTerrainTile = targetTileset->addTile(terrainImage);
 
@@ -545,8 +545,8 @@ int main(int argc, char *argv[])
 
             // Draw the lowest terrain to avoid pixel gaps
             QString baseTerrain = terrainList.first();
-            QPixmap baseImage = terrains[baseTerrain]->imageTile()->image();
-            painter.drawPixmap(0, 0, baseImage);
+            const Tile *baseTile = terrains[baseTerrain]->imageTile();
+            painter.drawPixmap(QPoint(0, 0), baseTile->image(), baseTile->imageRect());
 
             foreach (const QString &terrainName, terrainList) {
                 TileTerrainNames filtered = terrainNames.filter(terrainName);
@@ -556,7 +556,7 @@ int main(int argc, char *argv[])
                     continue;
                 }
 
-                painter.drawPixmap(0, 0, tile->image());
+                painter.drawPixmap(QPoint(0, 0), tile->image(), tile->imageRect());
             }
 
             image = QPixmap::fromImage(tileImage);
@@ -564,7 +564,7 @@ int main(int argc, char *argv[])
             qWarning() << "Copying" << terrainNames << "from"
                        << QFileInfo(tile->tileset()->fileName()).fileName();
 
-            image = tile->image();
+            image = tile->image().copy(tile->imageRect());
         }
 
         Tile *newTile = targetTileset->addTile(image);
@@ -597,7 +597,7 @@ int main(int argc, char *argv[])
         foreach (Tile *tile, targetTileset->tiles()) {
             int x = (tile->id() % 16) * targetTileset->tileWidth();
             int y = (tile->id() / 16) * targetTileset->tileHeight();
-            painter.drawPixmap(x, y, tile->image());
+            painter.drawPixmap(QPoint(x, y), tile->image(), tile->imageRect());
         }
 
         QString imageFileName = QFileInfo(options.target).completeBaseName();
@@ -27,6 +27,7 @@
 #include "maprenderer.h"
 #include "mapscene.h"
 #include "objectgroup.h"
+#include "objectgroupitem.h"
 #include "raiselowerhelper.h"
 #include "resizemapobject.h"
 #include "tile.h"
@@ -134,10 +135,44 @@ MapObjectItem *AbstractObjectTool::topMostObjectItemAt(QPointF pos) const
     for (QGraphicsItem *item : items) {
         if (MapObjectItem *objectItem = qgraphicsitem_cast<MapObjectItem*>(item))
             return objectItem;
+
+        // Batched object groups paint their objects without items
+        if (ObjectGroupItem *ogItem = dynamic_cast<ObjectGroupItem*>(item)) {
+            if (!ogItem->isBatched())
+                continue;
+            if (MapObject *object = ogItem->topMostObjectAt(ogItem->mapFromScene(pos)))
+                return mMapScene->itemForObject(object);
+        }
     }
     return nullptr;
 }
 
+/**
+ * Returns the map object items among the given scene \a items. For batched
+ * object groups among them, items are created for their objects within
+ * \a rect, which is in scene coordinates.
+ */
+QSet<MapObjectItem*> AbstractObjectTool::objectItemsIn(const QList<QGraphicsItem*> &items,
+                                                       const QRectF &rect) const
+{
+    QSet<MapObjectItem*> objectItems;
+
+    for (QGraphicsItem *item : items) {
+        if (MapObjectItem *objectItem = qgraphicsitem_cast<MapObjectItem*>(item)) {
+            objectItems.insert(objectItem);
+        } else if (ObjectGroupItem *ogItem = dynamic_cast<ObjectGroupItem*>(item)) {
+            if (!ogItem->isBatched())
+                continue;
+
+            const QRectF localRect = ogItem->mapRectFromScene(rect);
+            for (MapObject *object : ogItem->objectsIntersecting(localRect))
+                objectItems.insert(mMapScene->itemForObject(object));
+        }
+    }
+
+    return objectItems;
+}
+
 void AbstractObjectTool::duplicateObjects()
 {
     mapDocument()->duplicateObjects(mapDocument()->selectedObjects());
@@ -22,6 +22,10 @@
 
 #include "abstracttool.h"
 
+#include <QSet>
+
+class QGraphicsItem;
+
 namespace Tiled {
 
 class MapObject;
@@ -66,6 +70,8 @@ protected:
     MapScene *mapScene() const { return mMapScene; }
     ObjectGroup *currentObjectGroup() const;
     MapObjectItem *topMostObjectItemAt(QPointF pos) const;
+    QSet<MapObjectItem*> objectItemsIn(const QList<QGraphicsItem*> &items,
+                                       const QRectF &rect) const;
 
 private slots:
     void duplicateObjects();
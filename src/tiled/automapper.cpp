@@ -37,7 +37,13 @@
 #include "tilelayer.h"
 #include "tilesetmanager.h"
 
+#include <QBitArray>
 #include <QDebug>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <algorithm>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -319,9 +325,165 @@ bool AutoMapper::setupRuleList()
         Q_ASSERT(coherentRegions(checkCoherent).size() == 1);
     }
 
+    compileRules();
+
     return true;
 }
 
+/**
+ * Returns a list of all cells which can be found within all tile layers
+ * within the given region.
+ */
+static QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
+                                   const QRegion &r)
+{
+    QVector<Cell> cells;
+    foreach (const TileLayer *tilelayer, list) {
+        foreach (const QRect &rect, r.rects()) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                    const Cell &cell = tilelayer->cellAt(x, y);
+                    if (!cells.contains(cell))
+                        cells.append(cell);
+                }
+            }
+        }
+    }
+    return cells;
+}
+
+static CompiledInputLayer compileInputLayer(const QString &name,
+                                            const InputIndexName &lists,
+                                            const QVector<QPoint> &positions,
+                                            const QRegion &ruleRegion)
+{
+    CompiledInputLayer layer;
+    layer.name = name;
+    layer.setLayer = nullptr;
+    layer.yesCount = lists.listYes.size();
+    layer.noCount = lists.listNo.size();
+
+    // With both lists empty, no condition is given
+    layer.valid = layer.yesCount > 0 || layer.noCount > 0;
+
+    layer.yesCells.reserve(positions.size() * layer.yesCount);
+    layer.noCells.reserve(positions.size() * layer.noCount);
+
+    for (const QPoint &position : positions) {
+        for (const TileLayer *ruleLayer : lists.listYes) {
+            if (!ruleLayer->contains(position))
+                layer.valid = false;
+            layer.yesCells.append(ruleLayer->cellAt(position));
+        }
+        for (const TileLayer *ruleLayer : lists.listNo) {
+            if (!ruleLayer->contains(position))
+                layer.valid = false;
+            layer.noCells.append(ruleLayer->cellAt(position));
+        }
+    }
+
+    if (lists.listYes.isEmpty())
+        layer.ruleCells = cellsInRegion(lists.listNo, ruleRegion);
+    if (lists.listNo.isEmpty())
+        layer.ruleCells = cellsInRegion(lists.listYes, ruleRegion);
+
+    return layer;
+}
+
+/**
+ * Returns how far around a changed rectangle the rule with the given input
+ * and output bounds can change the map, or extend the region handed to the
+ * next rule. This mirrors the candidate positions used by applyRule().
+ */
+static QMargins ruleReach(const QRect &input, const QRect &output)
+{
+    const QRect affected = output.isEmpty() ? input : input.united(output);
+
+    const int left = input.right() - affected.left();
+    const int top = input.bottom() - affected.top();
+    const int right = affected.right() - input.left() + input.width() - 1;
+    const int bottom = affected.bottom() - input.top() + input.height() - 1;
+
+    return QMargins(qMax(0, left), qMax(0, top),
+                    qMax(0, right), qMax(0, bottom));
+}
+
+void AutoMapper::compileRules()
+{
+    mCompiledRules.resize(mRulesInput.size());
+    mRulesReach = QMargins();
+
+    for (int ruleIndex = 0; ruleIndex < mRulesInput.size(); ++ruleIndex) {
+        const QRegion &ruleInput = mRulesInput.at(ruleIndex);
+        CompiledRule &rule = mCompiledRules[ruleIndex];
+        rule.modifiesInput = true;    // until resolveCompiledRuleLayers()
+
+        const QMargins reach = ruleReach(ruleInput.boundingRect(),
+                                         mRulesOutput.at(ruleIndex).boundingRect());
+        mRulesReach = QMargins(qMax(mRulesReach.left(), reach.left()),
+                               qMax(mRulesReach.top(), reach.top()),
+                               qMax(mRulesReach.right(), reach.right()),
+                               qMax(mRulesReach.bottom(), reach.bottom()));
+
+        for (const QRect &rect : ruleInput.rects())
+            for (int y = rect.top(); y <= rect.bottom(); ++y)
+                for (int x = rect.left(); x <= rect.right(); ++x)
+                    rule.positions.append(QPoint(x, y));
+
+        foreach (const QString &index, mInputRules.indexes) {
+            const InputIndex &ii = mInputRules[index];
+
+            QVector<CompiledInputLayer> layers;
+            foreach (const QString &name, ii.names)
+                layers.append(compileInputLayer(name, ii[name], rule.positions, ruleInput));
+
+            rule.indexes.append(layers);
+        }
+    }
+}
+
+void AutoMapper::replaceTilesetInCompiledRules(Tileset *oldTileset,
+                                               Tileset *newTileset)
+{
+    auto replace = [=] (QVector<Cell> &cells) {
+        for (Cell &cell : cells)
+            if (cell.tileset() == oldTileset)
+                cell.setTile(newTileset, cell.tileId());
+    };
+
+    for (CompiledRule &rule : mCompiledRules) {
+        for (QVector<CompiledInputLayer> &layers : rule.indexes) {
+            for (CompiledInputLayer &layer : layers) {
+                replace(layer.yesCells);
+                replace(layer.noCells);
+                replace(layer.ruleCells);
+            }
+        }
+    }
+}
+
+void AutoMapper::resolveCompiledRuleLayers()
+{
+    QSet<const Layer*> outputLayers;
+    for (const RuleOutput *translationTable : mLayerList)
+        for (int index : *translationTable)
+            outputLayers.insert(mMapWork->layerAt(index));
+
+    for (CompiledRule &rule : mCompiledRules) {
+        rule.modifiesInput = false;
+
+        for (QVector<CompiledInputLayer> &layers : rule.indexes) {
+            for (CompiledInputLayer &layer : layers) {
+                const int i = mMapWork->indexOfLayer(layer.name, Layer::TileLayerType);
+                layer.setLayer = i == -1 ? nullptr : mMapWork->layerAt(i)->asTileLayer();
+
+                if (outputLayers.contains(layer.setLayer))
+                    rule.modifiesInput = true;
+            }
+        }
+    }
+}
+
 bool AutoMapper::prepareAutoMap()
 {
     mError.clear();
@@ -428,6 +590,8 @@ bool AutoMapper::setupTilesets(Map *src, Map *dst)
         if (src->replaceTileset(tileset, replacement))
             tilesetManager->addReference(replacement);
 
+        replaceTilesetInCompiledRules(tileset.data(), replacement.data());
+
         tilesetManager->removeReference(tileset);
     }
     return true;
@@ -436,6 +600,8 @@ bool AutoMapper::setupTilesets(Map *src, Map *dst)
 void AutoMapper::autoMap(QRegion *where)
 {
     Q_ASSERT(mRulesInput.size() == mRulesOutput.size());
+    resolveCompiledRuleLayers();
+
     // first resize the active area
     if (mAutoMappingRadius) {
         QRegion region;
@@ -450,12 +616,11 @@ void AutoMapper::autoMap(QRegion *where)
 
     // delete all the relevant area, if the property "DeleteTiles" is set
     if (mDeleteTiles) {
-        const QRegion setLayersRegion = getSetLayersRegion();
+        const QRegion region = getSetLayersRegion(*where);
         for (RuleOutput *translationTable : mLayerList) {
             foreach (Layer *layer, translationTable->keys()) {
                 const int index = translationTable->value(layer);
                 Layer *dstLayer = mMapWork->layerAt(index);
-                const QRegion region = setLayersRegion.intersected(*where);
                 TileLayer *dstTileLayer = dstLayer->asTileLayer();
                 if (dstTileLayer)
                     dstTileLayer->erase(region);
@@ -471,156 +636,361 @@ void AutoMapper::autoMap(QRegion *where)
     // This needs to be done, so you can rely on the order of the rules at all
     // locations
     QRegion ret;
-    foreach (const QRect &rect, where->rects())
-        for (int i = 0; i < mRulesInput.size(); ++i) {
-            // at the moment the parallel execution does not work yet
-            // TODO: make multithreading available!
-            // either by dividing the rules or the region to multiple threads
-            ret = ret.united(applyRule(i, rect));
-        }
+    for (int i = 0; i < mRulesInput.size(); ++i)
+        ret = ret.united(applyRule(i, *where));
     *where = where->united(ret);
 }
 
-const QRegion AutoMapper::getSetLayersRegion()
+QMargins AutoMapper::reach() const
 {
-    QRegion result;
+    const int r = mAutoMappingRadius;
+    return mRulesReach + QMargins(r, r, r, r);
+}
+
+const QRegion AutoMapper::getSetLayersRegion(const QRegion &where)
+{
+    QVector<const TileLayer*> setLayers;
     foreach (const QString &name, mInputRules.names) {
         const int index = mMapWork->indexOfLayer(name, Layer::TileLayerType);
-        if (index == -1)
-            continue;
-        TileLayer *setLayer = mMapWork->layerAt(index)->asTileLayer();
-        result |= setLayer->region();
+        if (index != -1)
+            setLayers.append(mMapWork->layerAt(index)->asTileLayer());
+    }
+
+    QRegion result;
+    if (setLayers.isEmpty())
+        return result;
+
+    // The region may have been grown beyond the bounds of the set layers
+    auto occupied = [&] (int x, int y) {
+        for (const TileLayer *setLayer : setLayers) {
+            const QPoint pos(x - setLayer->x(), y - setLayer->y());
+            if (setLayer->contains(pos) && !setLayer->cellAt(pos).isEmpty())
+                return true;
+        }
+        return false;
+    };
+
+    // Only the given region is scanned, collecting runs of occupied cells
+    for (const QRect &rect : where.rects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            int runStart = rect.left();
+            bool running = false;
+            for (int x = rect.left(); x <= rect.right() + 1; ++x) {
+                const bool inRun = x <= rect.right() && occupied(x, y);
+                if (inRun && !running) {
+                    runStart = x;
+                    running = true;
+                } else if (!inRun && running) {
+                    result |= QRect(runStart, y, x - runStart, 1);
+                    running = false;
+                }
+            }
+        }
     }
     return result;
 }
 
-static bool compareLayerTo(const TileLayer *setLayer,
-                           const QVector<TileLayer*> &listYes,
-                           const QVector<TileLayer*> &listNo,
-                           const QRegion &ruleRegion, const QPoint &offset);
+static bool compareLayerTo(const CompiledInputLayer &input,
+                           const QVector<QPoint> &positions,
+                           const QPoint &offset);
+
+/**
+ * Returns whether the \a rule matches when its input region is moved by
+ * \a offset.
+ */
+static bool ruleMatches(const CompiledRule &rule, const QPoint &offset)
+{
+    for (const QVector<CompiledInputLayer> &inputLayers : rule.indexes) {
+        bool allLayerNamesMatch = true;
+        for (const CompiledInputLayer &inputLayer : inputLayers) {
+            if (!compareLayerTo(inputLayer, rule.positions, offset)) {
+                allLayerNamesMatch = false;
+                break;
+            }
+        }
+        if (allLayerNamesMatch)
+            return true;
+    }
+    return false;
+}
+
+namespace {
 
-QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
+/**
+ * Collects the positions within a band of rows at which a rule matches.
+ */
+class MatchRuleTask : public QRunnable
+{
+public:
+    MatchRuleTask(const CompiledRule &rule, const QRect &band,
+                  QVector<QPoint> &matches, QSemaphore &done)
+        : mRule(rule)
+        , mBand(band)
+        , mMatches(matches)
+        , mDone(done)
+    {}
+
+    void run() override
+    {
+        for (int y = mBand.top(); y <= mBand.bottom(); ++y)
+            for (int x = mBand.left(); x <= mBand.right(); ++x)
+                if (ruleMatches(mRule, QPoint(x, y)))
+                    mMatches.append(QPoint(x, y));
+
+        mDone.release();
+    }
+
+private:
+    const CompiledRule &mRule;
+    const QRect mBand;
+    QVector<QPoint> &mMatches;
+    QSemaphore &mDone;
+};
+
+} // anonymous namespace
+
+/**
+ * Returns the positions within \a candidates at which the \a rule matches,
+ * in scan order.
+ *
+ * Matching only reads from the map, so large areas are split up into bands
+ * of rows which are matched in parallel.
+ */
+static QVector<QPoint> findMatches(const CompiledRule &rule,
+                                   const QRect &candidates)
+{
+    // Small areas, like the ones touched while drawing, are not worth the
+    // overhead of distributing the work
+    const int minimumParallelArea = 64 * 64;
+
+    QThreadPool *threadPool = QThreadPool::globalInstance();
+    const int threadCount = threadPool->maxThreadCount();
+
+    int bandCount = 1;
+    if (threadCount > 1 && candidates.width() * candidates.height() >= minimumParallelArea)
+        bandCount = qMin(threadCount * 4, candidates.height());
+
+    const int bandHeight = (candidates.height() + bandCount - 1) / bandCount;
+
+    QVector<QVector<QPoint>> bandMatches(bandCount);
+    QSemaphore done;
+
+    if (bandCount == 1) {
+        MatchRuleTask(rule, candidates, bandMatches[0], done).run();
+        return bandMatches.first();
+    }
+
+    int started = 0;
+    for (int i = 0; i < bandCount; ++i) {
+        const QRect band = QRect(candidates.left(),
+                                 candidates.top() + i * bandHeight,
+                                 candidates.width(),
+                                 bandHeight) & candidates;
+        if (band.isEmpty())
+            break;
+
+        MatchRuleTask *task = new MatchRuleTask(rule, band, bandMatches[i], done);
+        threadPool->start(task);
+        ++started;
+    }
+
+    done.acquire(started);
+
+    QVector<QPoint> matches;
+    for (const QVector<QPoint> &m : bandMatches)
+        matches += m;
+    return matches;
+}
+
+/**
+ * Returns a pseudo-random number for applying the rule at \a ruleIndex at the
+ * given position. Unlike a global random number generator, the result does
+ * not depend on the order in which matches are processed, which keeps the
+ * results reproducible.
+ */
+static quint32 positionRandom(int ruleIndex, int x, int y)
+{
+    quint32 h = quint32(x) * 0x9E3779B1u;
+    h ^= quint32(y) * 0x85EBCA77u;
+    h ^= quint32(ruleIndex) * 0xC2B2AE3Du;
+
+    // Finalization mix of MurmurHash3
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+/**
+ * Returns whether \a a comes before \a b when scanning the map row by row.
+ */
+static bool scanOrderLessThan(const QPoint &a, const QPoint &b)
+{
+    return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+}
+
+/**
+ * Returns the cells within \a ruleOutput that are covered in each of the
+ * rules map layers of the \a translationTable, in the order of its keys.
+ */
+static QVector<QVector<QPoint>> outputCellsPerLayer(const RuleOutput *translationTable,
+                                                    const QRegion &ruleOutput)
+{
+    QVector<QVector<QPoint>> cellsPerLayer;
+
+    for (auto it = translationTable->begin(), end = translationTable->end(); it != end; ++it) {
+        const Layer *layer = it.key();
+        QVector<QPoint> cells;
+
+        if (const TileLayer *tileLayer = layer->asTileLayer()) {
+            for (const QRect &rect : ruleOutput.rects())
+                for (int y = rect.top(); y <= rect.bottom(); ++y)
+                    for (int x = rect.left(); x <= rect.right(); ++x)
+                        if (!tileLayer->cellAt(x, y).isEmpty())
+                            cells.append(QPoint(x, y));
+        } else {
+            const QRegion appliedPlace = tileRegionOfObjectGroup(layer->asObjectGroup());
+            for (const QRect &rect : appliedPlace.intersected(ruleOutput).rects())
+                for (int y = rect.top(); y <= rect.bottom(); ++y)
+                    for (int x = rect.left(); x <= rect.right(); ++x)
+                        cells.append(QPoint(x, y));
+        }
+
+        cellsPerLayer.append(cells);
+    }
+
+    return cellsPerLayer;
+}
+
+QRect AutoMapper::applyRule(const int ruleIndex, const QRegion &where)
 {
     QRect ret;
 
     if (mLayerList.isEmpty())
         return ret;
 
+    const CompiledRule &rule = mCompiledRules.at(ruleIndex);
     const QRegion ruleInput = mRulesInput.at(ruleIndex);
     const QRegion ruleOutput = mRulesOutput.at(ruleIndex);
     QRect rbr = ruleInput.boundingRect();
 
     // Since the rule itself is translated, we need to adjust the borders of the
     // loops. Decrease the size at all sides by one: There must be at least one
-    // tile overlap to the rule.
-    const int minX = where.left() - rbr.left() - rbr.width() + 1;
-    const int minY = where.top() - rbr.top() - rbr.height() + 1;
+    // tile overlap to the rule. Overlapping candidates of the different
+    // rectangles are only visited once.
+    QRegion candidates;
+    for (const QRect &rect : where.rects()) {
+        const int minX = rect.left() - rbr.left() - rbr.width() + 1;
+        const int minY = rect.top() - rbr.top() - rbr.height() + 1;
 
-    const int maxX = where.right() - rbr.left() + rbr.width() - 1;
-    const int maxY = where.bottom() - rbr.top() + rbr.height() - 1;
+        const int maxX = rect.right() - rbr.left() + rbr.width() - 1;
+        const int maxY = rect.bottom() - rbr.top() + rbr.height() - 1;
 
-    // In this list of regions it is stored which parts or the map have already
-    // been altered by exactly this rule. We store all the altered parts to
-    // make sure there are no overlaps of the same rule applied to
-    // (neighbouring) places
-    QVector<QRegion> appliedRegions;
-    if (mNoOverlappingRules)
-        appliedRegions.resize(mMapWork->layerCount());
-
-    for (int y = minY; y <= maxY; ++y)
-    for (int x = minX; x <= maxX; ++x) {
-        bool anymatch = false;
-        foreach (const QString &index, mInputRules.indexes) {
-            const InputIndex &ii = mInputRules[index];
+        candidates |= QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+    }
 
-            bool allLayerNamesMatch = true;
-            foreach (const QString &name, ii.names) {
-                const int i = mMapWork->indexOfLayer(name, Layer::TileLayerType);
-                if (i == -1) {
-                    allLayerNamesMatch = false;
-                } else {
-                    const TileLayer *setLayer = mMapWork->layerAt(i)->asTileLayer();
-                    allLayerNamesMatch &= compareLayerTo(setLayer,
-                                                         ii[name].listYes,
-                                                         ii[name].listNo,
-                                                         ruleInput,
-                                                         QPoint(x, y));
-                }
-            }
-            if (allLayerNamesMatch) {
-                anymatch = true;
-                break;
-            }
-        }
+    // In these bitmaps it is stored which cells of the map have already
+    // been altered by exactly this rule. We store all the altered cells to
+    // make sure there are no overlaps of the same rule applied to
+    // (neighbouring) places. The bitmaps cover the area the rule output can
+    // reach from any of the candidate positions.
+    QRect appliedBounds;
+    QVector<QBitArray> appliedCells;
+    QVector<QVector<QVector<QPoint>>> outputCells;
+    if (mNoOverlappingRules) {
+        const QRect outputBounds = ruleOutput.boundingRect();
+        const QRect candidateBounds = candidates.boundingRect();
+        appliedBounds = QRect(outputBounds.topLeft() + candidateBounds.topLeft(),
+                              outputBounds.bottomRight() + candidateBounds.bottomRight());
+        appliedCells.resize(mMapWork->layerCount());
+        outputCells.resize(mLayerList.size());
+    }
 
-        if (anymatch) {
-            // choose by chance which group of rule_layers should be used:
-            const int r = qrand() % mLayerList.size();
-            const RuleOutput *translationTable = mLayerList.at(r);
+    auto bitIndex = [&] (const QPoint &cell) {
+        return (cell.y() - appliedBounds.top()) * appliedBounds.width() +
+                cell.x() - appliedBounds.left();
+    };
 
-            if (!mNoOverlappingRules) {
-                copyMapRegion(ruleOutput, QPoint(x, y), translationTable);
-                ret = ret.united(rbr.translated(QPoint(x, y)));
-                continue;
-            }
+    auto applyAt = [&] (int x, int y) {
+        // choose by chance which group of rule_layers should be used:
+        const int r = positionRandom(ruleIndex, x, y) % mLayerList.size();
+        const RuleOutput *translationTable = mLayerList.at(r);
 
-            bool missmatch = false;
-            QList<Layer*> layers = translationTable->keys();
+        if (!mNoOverlappingRules) {
+            copyMapRegion(ruleOutput, QPoint(x, y), translationTable);
+            ret = ret.united(rbr.translated(QPoint(x, y)));
+            return;
+        }
 
-            // check if there are no overlaps within this rule.
-            QVector<QRegion> ruleRegionInLayer;
-            for (int i = 0; i < layers.size(); ++i) {
-                Layer *layer = layers.at(i);
+        // The output cells are the same for each position
+        QVector<QVector<QPoint>> &cellsPerLayer = outputCells[r];
+        if (cellsPerLayer.isEmpty())
+            cellsPerLayer = outputCellsPerLayer(translationTable, ruleOutput);
 
-                QRegion appliedPlace;
-                TileLayer *tileLayer = layer->asTileLayer();
-                if (tileLayer)
-                    appliedPlace = tileLayer->region();
-                else
-                    appliedPlace = tileRegionOfObjectGroup(layer->asObjectGroup());
+        const QPoint offset(x, y);
 
-                ruleRegionInLayer.append(appliedPlace.intersected(ruleOutput));
-                if (appliedRegions.at(i).intersects(
-                            ruleRegionInLayer[i].translated(x, y))) {
-                    missmatch = true;
-                    break;
-                }
-            }
-            if (missmatch)
+        // check if there are no overlaps within this rule.
+        for (int i = 0; i < cellsPerLayer.size(); ++i) {
+            const QBitArray &applied = appliedCells.at(i);
+            if (applied.isEmpty())
                 continue;
 
-            copyMapRegion(ruleOutput, QPoint(x, y), translationTable);
-            ret = ret.united(rbr.translated(QPoint(x, y)));
-            for (int i = 0; i < translationTable->size(); ++i) {
-                appliedRegions[i] +=
-                        ruleRegionInLayer[i].translated(x, y);
-            }
+            for (const QPoint &cell : cellsPerLayer.at(i))
+                if (applied.testBit(bitIndex(cell + offset)))
+                    return;
         }
-    }
 
-    return ret;
-}
+        copyMapRegion(ruleOutput, offset, translationTable);
+        ret = ret.united(rbr.translated(offset));
+        for (int i = 0; i < cellsPerLayer.size(); ++i) {
+            QBitArray &applied = appliedCells[i];
+            if (applied.isEmpty())
+                applied.resize(appliedBounds.width() * appliedBounds.height());
 
-/**
- * Returns a list of all cells which can be found within all tile layers
- * within the given region.
- */
-static QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
-                                   const QRegion &r)
-{
-    QVector<Cell> cells;
-    foreach (const TileLayer *tilelayer, list) {
-        foreach (const QRect &rect, r.rects()) {
-            for (int x = rect.left(); x <= rect.right(); ++x) {
-                for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                    const Cell &cell = tilelayer->cellAt(x, y);
-                    if (!cells.contains(cell))
-                        cells.append(cell);
-                }
-            }
+            for (const QPoint &cell : cellsPerLayer.at(i))
+                applied.setBit(bitIndex(cell + offset));
+        }
+    };
+
+    // The candidates are visited row by row, in the same order as when the
+    // rule is applied to the whole map. This matters for rules that modify
+    // their own input and when NoOverlappingRules is set.
+    const QVector<QRect> rects = candidates.rects();
+
+    if (rule.modifiesInput) {
+        // Applying the rule can affect where it matches next, so matching
+        // and applying need to alternate. The rects of a QRegion are stored
+        // in bands of equal height, sorted by x.
+        for (int bandStart = 0; bandStart < rects.size(); ) {
+            const QRect &first = rects.at(bandStart);
+            int bandEnd = bandStart + 1;
+            while (bandEnd < rects.size() && rects.at(bandEnd).top() == first.top())
+                ++bandEnd;
+
+            for (int y = first.top(); y <= first.bottom(); ++y)
+                for (int i = bandStart; i < bandEnd; ++i)
+                    for (int x = rects.at(i).left(); x <= rects.at(i).right(); ++x)
+                        if (ruleMatches(rule, QPoint(x, y)))
+                            applyAt(x, y);
+
+            bandStart = bandEnd;
         }
+    } else {
+        QVector<QPoint> matches;
+        for (const QRect &rect : rects)
+            matches += findMatches(rule, rect);
+
+        if (rects.size() > 1)
+            std::sort(matches.begin(), matches.end(), scanOrderLessThan);
+
+        for (const QPoint &match : matches)
+            applyAt(match.x(), match.y());
     }
-    return cells;
+
+    return ret;
 }
 
 /**
@@ -637,6 +1007,10 @@ static QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
  * The tile layer setLayer is examined at QRegion ruleRegion + offset
  * The tile layers within listYes and listNo are examined at QRegion ruleRegion.
  *
+ * The cells of the listYes and listNo layers at each of the \a positions of
+ * the rule region have been collected up front by compileInputLayer(), as
+ * well as the working map layer to compare against.
+ *
  * Basically all matches between setLayer and a layer of listYes are considered
  * good, while all matches between setLayer and listNo are considered bad and
  * lead to canceling the comparison, returning false.
@@ -685,92 +1059,76 @@ static QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
  *
  * @return bool, if the tile layer matches the given list of layers.
  */
-static bool compareLayerTo(const TileLayer *setLayer,
-                           const QVector<TileLayer*> &listYes,
-                           const QVector<TileLayer*> &listNo,
-                           const QRegion &ruleRegion, const QPoint &offset)
+static bool compareLayerTo(const CompiledInputLayer &input,
+                           const QVector<QPoint> &positions,
+                           const QPoint &offset)
 {
-    if (listYes.isEmpty() && listNo.isEmpty())
+    const TileLayer *setLayer = input.setLayer;
+    if (!setLayer || !input.valid)
         return false;
 
-    QVector<Cell> cells;
-    if (listYes.isEmpty())
-        cells = cellsInRegion(listNo, ruleRegion);
-    if (listNo.isEmpty())
-        cells = cellsInRegion(listYes, ruleRegion);
-
-    foreach (const QRect &rect, ruleRegion.rects()) {
-        for (int x = rect.left(); x <= rect.right(); ++x) {
-            for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                // this is only used in the case where only one list has layers
-                // it is needed for the exception mentioned above
-                bool ruleDefinedListYes = false;
+    const Cell *yesCell = input.yesCells.constData();
+    const Cell *noCell = input.noCells.constData();
 
-                bool matchListYes = false;
-                bool matchListNo  = false;
+    for (const QPoint &position : positions) {
+        const int x = position.x() + offset.x();
+        const int y = position.y() + offset.y();
 
-                if (!setLayer->contains(x + offset.x(), y + offset.y()))
-                    return false;
+        if (!setLayer->contains(x, y))
+            return false;
 
-                const Cell &c1 = setLayer->cellAt(x + offset.x(),
-                                                  y + offset.y());
+        const Cell c1 = setLayer->cellAt(x, y);
 
-                // ruleDefined will be set when there is a tile in at least
-                // one layer. if there is a tile in at least one layer, only
-                // the given tiles in the different listYes layers are valid.
-                // if there is given no tile at all in the listYes layers,
-                // consider all tiles valid.
+        // this is only used in the case where only one list has layers
+        // it is needed for the exception mentioned above
+        bool ruleDefinedListYes = false;
 
-                foreach (const TileLayer *comparedTileLayer, listYes) {
+        bool matchListYes = false;
+        bool matchListNo  = false;
 
-                    if (!comparedTileLayer->contains(x, y))
-                        return false;
-
-                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
-                    if (!c2.isEmpty())
-                        ruleDefinedListYes = true;
-
-                    if (!c2.isEmpty() && c1 == c2)
-                        matchListYes = true;
-                }
-                foreach (const TileLayer *comparedTileLayer, listNo) {
+        // ruleDefined will be set when there is a tile in at least
+        // one layer. if there is a tile in at least one layer, only
+        // the given tiles in the different listYes layers are valid.
+        // if there is given no tile at all in the listYes layers,
+        // consider all tiles valid.
 
-                    if (!comparedTileLayer->contains(x, y))
-                        return false;
-
-                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
-
-                    if (!c2.isEmpty() && c1 == c2)
-                        matchListNo = true;
-                }
-
-                // when there are only layers in the listNo
-                // check only if these layers are unmatched
-                // no need to check explicitly the exception in this case.
-                if (listYes.isEmpty()) {
-                    if (matchListNo)
-                        return false;
-                    else
-                        continue;
-                }
-                // when there are only layers in the listYes
-                // check if these layers are matched, or if the exception works
-                if (listNo.isEmpty()) {
-                    if (matchListYes)
-                        continue;
-                    if (!ruleDefinedListYes && !cells.contains(c1))
-                        continue;
-                    return false;
-                }
-
-                // there are layers in both lists:
-                // no need to consider ruleDefinedListXXX
-                if ((matchListYes || !ruleDefinedListYes) && !matchListNo)
-                    continue;
-                else
-                    return false;
+        for (int i = 0; i < input.yesCount; ++i, ++yesCell) {
+            if (!yesCell->isEmpty()) {
+                ruleDefinedListYes = true;
+                if (c1 == *yesCell)
+                    matchListYes = true;
             }
         }
+        for (int i = 0; i < input.noCount; ++i, ++noCell) {
+            if (!noCell->isEmpty() && c1 == *noCell)
+                matchListNo = true;
+        }
+
+        // when there are only layers in the listNo
+        // check only if these layers are unmatched
+        // no need to check explicitly the exception in this case.
+        if (input.yesCount == 0) {
+            if (matchListNo)
+                return false;
+            else
+                continue;
+        }
+        // when there are only layers in the listYes
+        // check if these layers are matched, or if the exception works
+        if (input.noCount == 0) {
+            if (matchListYes)
+                continue;
+            if (!ruleDefinedListYes && !input.ruleCells.contains(c1))
+                continue;
+            return false;
+        }
+
+        // there are layers in both lists:
+        // no need to consider ruleDefinedListXXX
+        if ((matchListYes || !ruleDefinedListYes) && !matchListNo)
+            continue;
+        else
+            return false;
     }
     return true;
 }
@@ -905,6 +1263,8 @@ void AutoMapper::cleanUpRulesMap()
     cleanUpRuleMapLayers();
     mRulesInput.clear();
     mRulesOutput.clear();
+    mCompiledRules.clear();
+    mRulesReach = QMargins();
 }
 
 void AutoMapper::cleanUpRuleMapLayers()
@@ -20,10 +20,12 @@
 
 #pragma once
 
+#include "tilelayer.h"
 #include "tileset.h"
 
 #include <QList>
 #include <QMap>
+#include <QMargins>
 #include <QRegion>
 #include <QSet>
 #include <QString>
@@ -67,6 +69,35 @@ public:
     QString index;
 };
 
+/**
+ * The cells of the input_<name> and inputnot_<name> layers of one index,
+ * taken at each position of a rule's input region.
+ */
+class CompiledInputLayer
+{
+public:
+    QString name;               // name of the matched layer in the working map
+    const TileLayer *setLayer;  // resolved at the start of autoMap()
+    bool valid;                 // false when this can never match
+    int yesCount;
+    int noCount;
+    QVector<Cell> yesCells;     // yesCount cells per position
+    QVector<Cell> noCells;      // noCount cells per position
+    QVector<Cell> ruleCells;    // all cells in the region, when one list is empty
+};
+
+/**
+ * A rule compiled into flat tables, to make matching it at a certain position
+ * of the working map cheap.
+ */
+class CompiledRule
+{
+public:
+    QVector<QPoint> positions;  // all positions of the input region
+    QVector<QVector<CompiledInputLayer>> indexes;
+    bool modifiesInput;         // whether the output may affect the matching
+};
+
 
 /**
  * This class does all the work for the automapping feature.
@@ -120,6 +151,13 @@ public:
      */
     void autoMap(QRegion *where);
 
+    /**
+     * Returns how far around the region passed to autoMap() the map may get
+     * changed, including the automapping radius. Determined when loading the
+     * rules.
+     */
+    QMargins reach() const;
+
     /**
      * This cleans all data structures, which are setup via prepareAutoMap,
      * so the auto mapper becomes ready for its next automatic mapping.
@@ -154,6 +192,25 @@ private:
      */
     bool setupRuleList();
 
+    /**
+     * Compiles the rules found by setupRuleList() into mCompiledRules.
+     */
+    void compileRules();
+
+    /**
+     * Makes the compiled rules refer to \a newTileset instead of
+     * \a oldTileset, after it got replaced in the rules map.
+     */
+    void replaceTilesetInCompiledRules(Tileset *oldTileset,
+                                       Tileset *newTileset);
+
+    /**
+     * Looks up the layers of the working map that the compiled rules are
+     * matched against, and determines whether applying a rule can affect
+     * where it matches.
+     */
+    void resolveCompiledRuleLayers();
+
     /**
      * Sets up the layers in the rules map, which are used for automapping.
      * The layers are detected and put in the internal data structures
@@ -183,9 +240,10 @@ private:
     bool setupTilesets(Map *src, Map *dst);
 
     /**
-     * Returns the conjunction of of all regions of all setlayers
+     * Returns the conjunction of of all regions of all setlayers, within
+     * the given region.
      */
-    const QRegion getSetLayersRegion();
+    const QRegion getSetLayersRegion(const QRegion &where);
 
     /**
      * This copies all Tiles from TileLayer src to TileLayer dst
@@ -233,7 +291,7 @@ private:
      *              of mMapWork will be looked up in mRulesInput and mRulesOutput
      * @return where: an rectangle where the rule actually got applied
      */
-    QRect applyRule(const int ruleIndex, const QRect &where);
+    QRect applyRule(const int ruleIndex, const QRegion &where);
 
     /**
      * Cleans up the data structures filled by setupRuleMapLayers(),
@@ -312,6 +370,16 @@ private:
      */
     QVector<QRegion> mRulesOutput;
 
+    /**
+     * The rules at mRulesInput compiled for matching, at matching indexes.
+     */
+    QVector<CompiledRule> mCompiledRules;
+
+    /**
+     * The largest reach of all compiled rules.
+     */
+    QMargins mRulesReach;
+
     /**
      * The inner set with layers to indexes is needed for translating
      * tile layers from mMapRules to mMapWork.
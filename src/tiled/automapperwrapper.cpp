@@ -46,10 +46,29 @@ AutoMapperWrapper::AutoMapperWrapper(MapDocument *mapDocument,
             autoMapper.remove(index);
         }
     }
+
+    // The automappers can only change the map within their reach around the
+    // given region, so only that part of the touched layers needs a snapshot.
+    // Each automapper extends the region for the following ones.
+    QMargins reach;
+    for (AutoMapper *a : autoMapper)
+        reach += a->reach();
+
+    QRegion affected;
+    for (const QRect &rect : where->rects())
+        affected += rect.marginsAdded(reach);
+
+    QVector<QRegion> snapshotAreas;
+    QVector<QMargins> drawMarginsBefore;
     foreach (const QString &layerName, touchedLayers) {
         const int layerIndex = map->indexOfLayer(layerName);
         Q_ASSERT(layerIndex != -1);
-        mLayersBefore.append(static_cast<TileLayer*>(map->layerAt(layerIndex)->clone()));
+        TileLayer *layer = static_cast<TileLayer*>(map->layerAt(layerIndex));
+        const QRegion area = affected.translated(-layer->position())
+                .intersected(QRect(0, 0, layer->width(), layer->height()));
+        mLayersBefore.append(layer->copy(area));
+        snapshotAreas.append(area);
+        drawMarginsBefore.append(layer->drawMargins());
     }
 
     for (AutoMapper *a : autoMapper)
@@ -60,25 +79,31 @@ AutoMapperWrapper::AutoMapperWrapper(MapDocument *mapDocument,
         const int layerIndex = map->indexOfLayer(layerName);
         // layer index exists, because AutoMapper is still alive, don't check
         Q_ASSERT(layerIndex != -1);
+        const QRegion &area = snapshotAreas.at(beforeIndex);
         TileLayer *before = mLayersBefore.at(beforeIndex);
-        TileLayer *after = static_cast<TileLayer*>(map->layerAt(layerIndex));
+        TileLayer *layer = static_cast<TileLayer*>(map->layerAt(layerIndex));
+        TileLayer *after = layer->copy(area);
 
-        if (before->drawMargins() != after->drawMargins())
-            mMapDocument->emitTileLayerDrawMarginsChanged(after);
+        if (drawMarginsBefore.at(beforeIndex) != layer->drawMargins())
+            mMapDocument->emitTileLayerDrawMarginsChanged(layer);
 
         // reduce memory usage by saving only diffs
         QRect diffRegion = before->computeDiffRegion(after).boundingRect();
         TileLayer *before1 = before->copy(diffRegion);
         TileLayer *after1 = after->copy(diffRegion);
 
-        before1->setPosition(diffRegion.topLeft());
-        after1->setPosition(diffRegion.topLeft());
-        before1->setName(before->name());
-        after1->setName(after->name());
+        // the snapshots start at the top-left of the snapshot area
+        const QPoint position = diffRegion.topLeft() +
+                area.boundingRect().topLeft() + layer->position();
+        before1->setPosition(position);
+        after1->setPosition(position);
+        before1->setName(layer->name());
+        after1->setName(layer->name());
         mLayersBefore.replace(beforeIndex, before1);
         mLayersAfter.append(after1);
 
         delete before;
+        delete after;
         ++beforeIndex;
     }
 
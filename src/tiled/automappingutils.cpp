@@ -22,6 +22,7 @@
 #include "automappingutils.h"
 
 #include "addremovemapobject.h"
+#include "map.h"
 #include "mapdocument.h"
 #include "mapobject.h"
 #include "maprenderer.h"
@@ -37,8 +38,23 @@ void eraseRegionObjectGroup(MapDocument *mapDocument,
                             const QRegion &where)
 {
     QUndoStack *undo = mapDocument->undoStack();
+    const MapRenderer *renderer = mapDocument->renderer();
 
-    const auto objects = layer->objects();
+    // Only objects near the region need to be checked. Convert its bounds to
+    // pixel space, allowing for one tile of inaccuracy of the conversion.
+    const QRect whereBounds = where.boundingRect();
+    QPolygonF pixelCorners;
+    pixelCorners << renderer->tileToPixelCoords(whereBounds.topLeft())
+                 << renderer->tileToPixelCoords(whereBounds.topRight() + QPoint(1, 0))
+                 << renderer->tileToPixelCoords(whereBounds.bottomRight() + QPoint(1, 1))
+                 << renderer->tileToPixelCoords(whereBounds.bottomLeft() + QPoint(0, 1));
+    const Map *map = mapDocument->map();
+    const QRectF candidateRect = pixelCorners.boundingRect().adjusted(-map->tileWidth(),
+                                                                      -map->tileHeight(),
+                                                                      map->tileWidth(),
+                                                                      map->tileHeight());
+
+    const auto objects = layer->objectsIntersecting(candidateRect);
     for (MapObject *obj : objects) {
         // TODO: we are checking bounds, which is only correct for rectangles and
         // tile objects. polygons and polylines are not covered correctly by this
@@ -80,7 +96,11 @@ const QList<MapObject*> objectsInRegion(const ObjectGroup *layer,
                                         const QRegion &where)
 {
     QList<MapObject*> ret;
-    for (MapObject *obj : layer->objects()) {
+
+    // Allow for the rounding of toAlignedRect() below
+    const QRectF candidateRect = QRectF(where.boundingRect()).adjusted(-1, -1, 1, 1);
+
+    for (MapObject *obj : layer->objectsIntersecting(candidateRect)) {
         // TODO: we are checking bounds, which is only correct for rectangles and
         // tile objects. polygons and polylines are not covered correctly by this
         // erase method (we are in fact deleting too many objects)
@@ -176,6 +176,10 @@ void EditPolygonTool::deactivate(MapScene *scene)
     mHandles.clear();
     mSelectedHandles.clear();
     mClickedHandle = nullptr;
+    if (mClickedObjectItem) {
+        scene->unholdObjectItem(mClickedObjectItem);
+        mClickedObjectItem = nullptr;
+    }
 
     AbstractObjectTool::deactivate(scene);
 }
@@ -246,8 +250,12 @@ void EditPolygonTool::mousePressed(QGraphicsSceneMouseEvent *event)
                                                                Qt::DescendingOrder,
                                                                viewTransform(event));
 
+        if (mClickedObjectItem)
+            mapScene()->unholdObjectItem(mClickedObjectItem);
         mClickedObjectItem = first<MapObjectItem>(items);
         mClickedHandle = first<PointHandle>(items);
+        if (mClickedObjectItem)
+            mapScene()->holdObjectItem(mClickedObjectItem);
         break;
     }
     case Qt::RightButton: {
@@ -326,6 +334,10 @@ void EditPolygonTool::mouseReleased(QGraphicsSceneMouseEvent *event)
 
     mMousePressed = false;
     mClickedHandle = nullptr;
+    if (mClickedObjectItem) {
+        mapScene()->unholdObjectItem(mClickedObjectItem);
+        mClickedObjectItem = nullptr;
+    }
 }
 
 void EditPolygonTool::modifiersChanged(Qt::KeyboardModifiers modifiers)
@@ -438,17 +450,11 @@ void EditPolygonTool::updateSelection(QGraphicsSceneMouseEvent *event)
 
     if (oldSelection.isEmpty()) {
         // Allow selecting some map objects only when there aren't any selected
-        QSet<MapObjectItem*> selectedItems;
-
-        foreach (QGraphicsItem *item, mapScene()->items(rect,
-                                                        Qt::IntersectsItemShape,
-                                                        Qt::DescendingOrder,
-                                                        viewTransform(event))) {
-            MapObjectItem *mapObjectItem = dynamic_cast<MapObjectItem*>(item);
-            if (mapObjectItem)
-                selectedItems.insert(mapObjectItem);
-        }
-
+        const QList<QGraphicsItem*> items = mapScene()->items(rect,
+                                                              Qt::IntersectsItemShape,
+                                                              Qt::DescendingOrder,
+                                                              viewTransform(event));
+        QSet<MapObjectItem*> selectedItems = objectItemsIn(items, rect);
 
         QSet<MapObjectItem*> newSelection;
 
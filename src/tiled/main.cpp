@@ -21,6 +21,7 @@
  */
 
 #include "commandlineparser.h"
+#include "imagecache.h"
 #include "languagemanager.h"
 #include "mainwindow.h"
 #include "mapdocument.h"
@@ -33,12 +34,21 @@
 #include "stylehelper.h"
 #include "tiledapplication.h"
 #include "tileset.h"
+#include "tilesetformat.h"
 #include "winsparkleautoupdater.h"
 
 #include <QDebug>
+#include <QDir>
 #include <QFileInfo>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QMutex>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
 #include <QtPlugin>
 
 #ifdef TILED_LINUX_ARCHIVE
@@ -68,6 +78,8 @@ public:
     bool showedVersion;
     bool disableOpenGL;
     bool exportMap;
+    bool exportMaps;
+    bool exportFormat;
     bool newInstance;
 
 private:
@@ -75,6 +87,8 @@ private:
     void justQuit();
     void setDisableOpenGL();
     void setExportMap();
+    void setExportMaps();
+    void setExportFormat();
     void showExportFormats();
     void startNewInstance();
 
@@ -99,6 +113,8 @@ CommandLineHandler::CommandLineHandler()
     , showedVersion(false)
     , disableOpenGL(false)
     , exportMap(false)
+    , exportMaps(false)
+    , exportFormat(false)
     , newInstance(false)
 {
     option<&CommandLineHandler::showVersion>(
@@ -121,6 +137,16 @@ CommandLineHandler::CommandLineHandler()
                 QLatin1String("--export-map"),
                 tr("Export the specified tmx file to target"));
 
+    option<&CommandLineHandler::setExportMaps>(
+                QChar(),
+                QLatin1String("--export-maps"),
+                tr("Export the specified tmx files and directories to a target pattern, in which %1 is replaced by the name of each map"));
+
+    option<&CommandLineHandler::setExportFormat>(
+                QChar(),
+                QLatin1String("--export-format"),
+                tr("Take the export format from the first file argument of --export-maps (see --export-formats)"));
+
     option<&CommandLineHandler::showExportFormats>(
                 QChar(),
                 QLatin1String("--export-formats"),
@@ -157,6 +183,16 @@ void CommandLineHandler::setExportMap()
     exportMap = true;
 }
 
+void CommandLineHandler::setExportMaps()
+{
+    exportMaps = true;
+}
+
+void CommandLineHandler::setExportFormat()
+{
+    exportFormat = true;
+}
+
 void CommandLineHandler::showExportFormats()
 {
     PluginManager::instance()->loadPlugins();
@@ -177,6 +213,341 @@ void CommandLineHandler::startNewInstance()
 }
 
 
+namespace {
+
+/**
+ * Caches the external tilesets loaded while exporting maps, so that each
+ * tileset is only loaded once. Used by several threads at once.
+ */
+class TilesetCache
+{
+public:
+    ~TilesetCache()
+    {
+        qDeleteAll(mPendingReaders);
+    }
+
+    /**
+     * Returns the tileset read from \a fileName. In worker threads, the
+     * images of the tileset are assigned later by assignImages(). Tilesets
+     * read through plugins can't be read in worker threads, in which case
+     * \a needsGuiThread is set.
+     */
+    SharedTileset tileset(const QString &fileName, QString *error,
+                          bool *needsGuiThread)
+    {
+        QMutexLocker locker(&mMutex);
+
+        SharedTileset &tileset = mTilesets[fileName];
+        if (tileset)
+            return tileset;
+
+        if (isGuiThread()) {
+            tileset = readTileset(fileName, error);
+            return tileset;
+        }
+
+        for (TilesetFormat *format : PluginManager::objects<TilesetFormat>()) {
+            if (format->supportsFile(fileName)) {
+                *needsGuiThread = true;
+                return SharedTileset();
+            }
+        }
+
+        MapReader *reader = new MapReader;
+        reader->setAssignImages(false);
+
+        tileset = reader->readTileset(fileName);
+        if (tileset) {
+            mPendingReaders.append(reader);
+        } else {
+            *error = reader->errorString();
+            delete reader;
+        }
+
+        return tileset;
+    }
+
+    /**
+     * Assigns the images of the tilesets read in worker threads so far.
+     * Needs to be called in the GUI thread.
+     */
+    void assignImages()
+    {
+        QMutexLocker locker(&mMutex);
+
+        for (MapReader *reader : mPendingReaders) {
+            reader->assignImages();
+            delete reader;
+        }
+        mPendingReaders.clear();
+    }
+
+private:
+    QMutex mMutex;
+    QHash<QString, SharedTileset> mTilesets;
+    QVector<MapReader*> mPendingReaders;
+};
+
+class CachingMapReader : public MapReader
+{
+public:
+    explicit CachingMapReader(TilesetCache &tilesetCache)
+        : mTilesetCache(tilesetCache)
+        , mNeedsGuiThread(false)
+    {}
+
+    /**
+     * Returns whether the map could not be read, because it uses a tileset
+     * that can only be read in the GUI thread.
+     */
+    bool needsGuiThread() const { return mNeedsGuiThread; }
+
+protected:
+    SharedTileset readExternalTileset(const QString &source, QString *error) override
+    {
+        return mTilesetCache.tileset(source, error, &mNeedsGuiThread);
+    }
+
+private:
+    TilesetCache &mTilesetCache;
+    bool mNeedsGuiThread;
+};
+
+struct MapExport
+{
+    MapExport(const QString &sourceFile, const QString &targetFile,
+              TilesetCache &tilesetCache)
+        : sourceFile(sourceFile)
+        , targetFile(targetFile)
+        , reader(tilesetCache)
+    {}
+
+    QString sourceFile;
+    QString targetFile;
+    QString error;
+
+    CachingMapReader reader;
+    QScopedPointer<Map> map;
+    QSemaphore read;
+};
+
+/**
+ * Reads a map in a worker thread. The images are only decoded, since
+ * assigning them involves creating pixmaps, which is left to the GUI thread.
+ */
+class ReadMapTask : public QRunnable
+{
+public:
+    explicit ReadMapTask(MapExport &mapExport)
+        : mMapExport(mapExport)
+    {}
+
+    void run() override
+    {
+        CachingMapReader &reader = mMapExport.reader;
+        reader.setAssignImages(false);
+
+        mMapExport.map.reset(reader.readMap(mMapExport.sourceFile));
+        if (!mMapExport.map)
+            mMapExport.error = reader.errorString();
+
+        mMapExport.read.release();
+    }
+
+private:
+    MapExport &mMapExport;
+};
+
+/**
+ * Finishes reading the map of \a mapExport in the GUI thread and writes it
+ * out in the given \a format. Maps using tilesets that could not be read by
+ * a worker thread are read again here.
+ */
+void exportMap(MapExport &mapExport, MapFormat *format,
+               TilesetCache &tilesetCache)
+{
+    CachingMapReader &reader = mapExport.reader;
+
+    if (reader.needsGuiThread()) {
+        reader.setAssignImages(true);
+        mapExport.map.reset(reader.readMap(mapExport.sourceFile));
+        mapExport.error = mapExport.map ? QString() : reader.errorString();
+    } else if (mapExport.map) {
+        // The tilesets used by this map have been read by now
+        tilesetCache.assignImages();
+        reader.assignImages(mapExport.map.data());
+    }
+
+    if (mapExport.map && !format->write(mapExport.map.data(), mapExport.targetFile))
+        mapExport.error = format->errorString();
+
+    mapExport.map.reset();
+}
+
+} // anonymous namespace
+
+/**
+ * Finds the map format to export to, either by the given \a filter or based
+ * on the extension of the \a targetFile. Returns null when no format could
+ * be determined.
+ */
+static MapFormat *findExportFormat(const QString *filter, const QString &targetFile)
+{
+    MapFormat *chosenFormat = nullptr;
+    auto formats = PluginManager::objects<MapFormat>();
+
+    if (filter) {
+        // Find the map format supporting the given filter
+        for (MapFormat *format : formats) {
+            if (!format->hasCapabilities(MapFormat::Write))
+                continue;
+            if (format->nameFilter().compare(*filter, Qt::CaseInsensitive) == 0) {
+                chosenFormat = format;
+                break;
+            }
+        }
+        if (!chosenFormat)
+            qWarning().noquote() << QCoreApplication::translate("Command line", "Format not recognized (see --export-formats)");
+    } else {
+        // Find the map format based on target file extension
+        QString suffix = QFileInfo(targetFile).completeSuffix();
+        for (MapFormat *format : formats) {
+            if (!format->hasCapabilities(MapFormat::Write))
+                continue;
+            if (format->nameFilter().contains(suffix, Qt::CaseInsensitive)) {
+                if (chosenFormat) {
+                    qWarning().noquote() << QCoreApplication::translate("Command line", "Non-unique file extension. Can't determine correct export format.");
+                    return nullptr;
+                }
+                chosenFormat = format;
+            }
+        }
+        if (!chosenFormat)
+            qWarning().noquote() << QCoreApplication::translate("Command line", "No exporter found for target file.");
+    }
+
+    return chosenFormat;
+}
+
+/**
+ * Returns the map files referred to by \a source, which is either a file, a
+ * directory or a wildcard pattern matching files in a directory. Directories
+ * are searched for tmx files.
+ */
+static QStringList mapFiles(const QString &source)
+{
+    const QFileInfo fileInfo(source);
+    QDir dir;
+    QString nameFilter;
+
+    if (fileInfo.isDir()) {
+        dir.setPath(fileInfo.filePath());
+        nameFilter = QLatin1String("*.tmx");
+    } else if (fileInfo.fileName().contains(QLatin1Char('*')) ||
+               fileInfo.fileName().contains(QLatin1Char('?'))) {
+        dir.setPath(fileInfo.path());
+        nameFilter = fileInfo.fileName();
+    } else {
+        return QStringList(source);
+    }
+
+    QStringList files;
+    const auto entries = dir.entryList(QStringList(nameFilter),
+                                       QDir::Files, QDir::Name);
+    for (const QString &fileName : entries)
+        files.append(dir.filePath(fileName));
+    return files;
+}
+
+/**
+ * Exports a batch of maps. The arguments are the format when \a hasFormat is
+ * set, followed by the target pattern and the maps to export. All maps share
+ * the loaded plugins and external tilesets.
+ *
+ * The maps are read in parallel by the global thread pool, a limited number
+ * ahead of the map being written. Only assigning their images and writing
+ * them happens in the GUI thread.
+ *
+ * Prints the status of each map and returns the exit code.
+ */
+static int exportMaps(const QStringList &arguments, bool hasFormat)
+{
+    const QString placeholder = QLatin1String("%1");
+
+    int index = 0;
+    const QString *filter = nullptr;
+    if (hasFormat && !arguments.isEmpty())
+        filter = &arguments.at(index++);
+
+    if (arguments.length() - index < 2) {
+        qWarning().noquote() << QCoreApplication::translate("Command line", "Export syntax is --export-maps [--export-format <format>] <target pattern> <tmx files or directories>");
+        return 1;
+    }
+
+    const QString &targetPattern = arguments.at(index++);
+
+    MapFormat *format = findExportFormat(filter, targetPattern);
+    if (!format)
+        return 1;
+
+    TilesetCache tilesetCache;
+    QVector<MapExport*> mapExports;
+    QSet<QString> targetFiles;
+    bool success = true;
+
+    for (; index < arguments.length(); ++index) {
+        const QStringList files = mapFiles(arguments.at(index));
+        if (files.isEmpty()) {
+            qWarning().noquote() << QCoreApplication::translate("Command line", "No maps found in %1").arg(arguments.at(index));
+            success = false;
+        }
+
+        for (const QString &sourceFile : files) {
+            QString targetFile = targetPattern;
+            targetFile.replace(placeholder, QFileInfo(sourceFile).completeBaseName());
+
+            if (targetFiles.contains(targetFile)) {
+                qWarning().noquote() << QCoreApplication::translate("Command line", "%1: Skipped, %2 is already the target of another map")
+                                        .arg(sourceFile, targetFile);
+                success = false;
+                continue;
+            }
+
+            targetFiles.insert(targetFile);
+            mapExports.append(new MapExport(sourceFile, targetFile, tilesetCache));
+        }
+    }
+
+    // Limits the amount of maps held in memory
+    QThreadPool *threadPool = QThreadPool::globalInstance();
+    const int readAhead = qMax(2, threadPool->maxThreadCount() * 2);
+    int started = 0;
+
+    for (int i = 0; i < mapExports.size(); ++i) {
+        for (; started < mapExports.size() && started <= i + readAhead; ++started)
+            threadPool->start(new ReadMapTask(*mapExports.at(started)));
+
+        MapExport &mapExport = *mapExports.at(i);
+        mapExport.read.acquire();
+        exportMap(mapExport, format, tilesetCache);
+
+        if (mapExport.error.isEmpty()) {
+            qWarning().noquote() << QCoreApplication::translate("Command line", "%1: Exported to %2")
+                                    .arg(mapExport.sourceFile, mapExport.targetFile);
+        } else {
+            qWarning().noquote() << QCoreApplication::translate("Command line", "%1: Failed to export: %2")
+                                    .arg(mapExport.sourceFile, mapExport.error);
+            success = false;
+        }
+    }
+
+    qDeleteAll(mapExports);
+
+    return success ? 0 : 1;
+}
+
+
 int main(int argc, char *argv[])
 {
 #ifdef Q_OS_WIN
@@ -244,42 +615,9 @@ int main(int argc, char *argv[])
         const QString &sourceFile = commandLine.filesToOpen().at(index++);
         const QString &targetFile = commandLine.filesToOpen().at(index++);
 
-        MapFormat *chosenFormat = nullptr;
-        auto formats = PluginManager::objects<MapFormat>();
-
-        if (filter) {
-            // Find the map format supporting the given filter
-            for (MapFormat *format : formats) {
-                if (!format->hasCapabilities(MapFormat::Write))
-                    continue;
-                if (format->nameFilter().compare(*filter, Qt::CaseInsensitive) == 0) {
-                    chosenFormat = format;
-                    break;
-                }
-            }
-            if (!chosenFormat) {
-                qWarning().noquote() << QCoreApplication::translate("Command line", "Format not recognized (see --export-formats)");
-                return 1;
-            }
-        } else {
-            // Find the map format based on target file extension
-            QString suffix = QFileInfo(targetFile).completeSuffix();
-            for (MapFormat *format : formats) {
-                if (!format->hasCapabilities(MapFormat::Write))
-                    continue;
-                if (format->nameFilter().contains(suffix, Qt::CaseInsensitive)) {
-                    if (chosenFormat) {
-                        qWarning().noquote() << QCoreApplication::translate("Command line", "Non-unique file extension. Can't determine correct export format.");
-                        return 1;
-                    }
-                    chosenFormat = format;
-                }
-            }
-            if (!chosenFormat) {
-                qWarning().noquote() << QCoreApplication::translate("Command line", "No exporter found for target file.");
-                return 1;
-            }
-        }
+        MapFormat *chosenFormat = findExportFormat(filter, targetFile);
+        if (!chosenFormat)
+            return 1;
 
         // Load the source file
         MapReader reader;
@@ -299,6 +637,9 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (commandLine.exportMaps)
+        return exportMaps(commandLine.filesToOpen(), commandLine.exportFormat);
+
     if (!commandLine.filesToOpen().isEmpty() && !commandLine.newInstance) {
         // Convert files to absolute paths because the already running Tiled
         // instance likely does not have the same working directory.
@@ -286,6 +286,10 @@ signals:
     void tilesetTerrainAdded(Tileset *tileset, int terrainId);
     void tilesetTerrainAboutToBeRemoved(Tileset *tileset, Terrain *terrain);
     void tilesetTerrainRemoved(Tileset *tileset, Terrain *terrain);
+    void tilesetChanged(Tileset *tileset);
+    void tilesetTileOffsetChanged(Tileset *tileset);
+    void tileImageSourceChanged(Tile *tile);
+    void tileAnimationChanged(Tile *tile);
 
 private slots:
     void onObjectsRemoved(const QList<MapObject*> &objects);
@@ -135,9 +135,15 @@ void MapObjectItem::setPolygon(const QPolygonF &polygon)
 }
 
 QColor MapObjectItem::objectColor(const MapObject *object)
+{
+    return objectColor(object, Preferences::instance()->objectTypes());
+}
+
+QColor MapObjectItem::objectColor(const MapObject *object,
+                                  const ObjectTypes &objectTypes)
 {
     // See if this object type has a color associated with it
-    for (const ObjectType &type : Preferences::instance()->objectTypes()) {
+    for (const ObjectType &type : objectTypes) {
         if (type.name.compare(object->type(), Qt::CaseInsensitive) == 0)
             return type.color;
     }
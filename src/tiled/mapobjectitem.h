@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include "objecttypes.h"
+
 #include <QCoreApplication>
 #include <QGraphicsItem>
 
@@ -91,6 +93,14 @@ public:
      */
     static QColor objectColor(const MapObject *object);
 
+    /**
+     * Overload that looks up the object type in the given \a objectTypes,
+     * rather than in the ones from the preferences. Can be used outside of the
+     * GUI thread.
+     */
+    static QColor objectColor(const MapObject *object,
+                              const ObjectTypes &objectTypes);
+
 private:
     MapDocument *mapDocument() const { return mMapDocument; }
     QColor color() const { return mColor; }
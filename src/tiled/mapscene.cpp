@@ -68,7 +68,8 @@ MapScene::MapScene(QObject *parent):
     mUnderMouse(false),
     mCurrentModifiers(Qt::NoModifier),
     mDarkRectangle(new QGraphicsRectItem),
-    mObjectSelectionItem(nullptr)
+    mObjectSelectionItem(nullptr),
+    mReleaseUnusedObjectItemsScheduled(false)
 {
     updateDefaultBackgroundColor();
 
@@ -77,7 +78,7 @@ MapScene::MapScene(QObject *parent):
 
     TilesetManager *tilesetManager = TilesetManager::instance();
     connect(tilesetManager, &TilesetManager::tilesetImagesChanged,
-            this, &MapScene::repaintTileset);
+            this, &MapScene::tilesetImagesChanged);
     connect(tilesetManager, &TilesetManager::repaintTileset,
             this, &MapScene::repaintTileset);
 
@@ -145,13 +146,14 @@ void MapScene::setMapDocument(MapDocument *mapDocument)
                 this, &MapScene::imageLayerChanged);
         connect(mMapDocument, &MapDocument::currentLayerChanged,
                 this, &MapScene::currentLayerChanged);
-        // todo: possibly route this through the TilesetManager and
-        // have the MapScene check if the current map uses the changed tileset.
-        // possibly have it still trigger through the signal
-//        connect(mMapDocument, &MapDocument::tilesetTileOffsetChanged,
-//                this, &MapScene::adaptToTilesetTileSizeChanges);
-//        connect(mMapDocument, &MapDocument::tileImageSourceChanged,
-//                this, &MapScene::adaptToTileSizeChanges);
+        connect(mMapDocument, &MapDocument::tilesetChanged,
+                this, &MapScene::adaptToTilesetTileSizeChanges);
+        connect(mMapDocument, &MapDocument::tilesetTileOffsetChanged,
+                this, &MapScene::adaptToTilesetTileSizeChanges);
+        connect(mMapDocument, &MapDocument::tileImageSourceChanged,
+                this, &MapScene::adaptToTileSizeChanges);
+        connect(mMapDocument, &MapDocument::tileAnimationChanged,
+                this, &MapScene::adaptToTileSizeChanges);
         connect(mMapDocument, &MapDocument::tilesetReplaced,
                 this, &MapScene::tilesetReplaced);
         connect(mMapDocument, &MapDocument::objectsInserted,
@@ -190,6 +192,8 @@ void MapScene::refreshScene()
 {
     mLayerItems.clear();
     mObjectItems.clear();
+    mOnDemandObjectItems.clear();
+    mHeldObjectItems.clear();
 
     removeItem(mDarkRectangle);
     clear();
@@ -244,20 +248,15 @@ LayerItem *MapScene::createLayerItem(Layer *layer)
 
     case Layer::ObjectGroupType: {
         auto og = static_cast<ObjectGroup*>(layer);
-        const ObjectGroup::DrawOrder drawOrder = og->drawOrder();
-        ObjectGroupItem *ogItem = new ObjectGroupItem(og);
-        int objectIndex = 0;
-        for (MapObject *object : og->objects()) {
-            MapObjectItem *item = new MapObjectItem(object, mMapDocument,
-                                                    ogItem);
-            if (drawOrder == ObjectGroup::TopDownOrder)
-                item->setZValue(item->y());
-            else
-                item->setZValue(objectIndex);
-
-            mObjectItems.insert(object, item);
-            ++objectIndex;
+        ObjectGroupItem *ogItem = new ObjectGroupItem(og, mMapDocument);
+
+        // Batched object groups paint their objects themselves
+        if (!ogItem->isBatched()) {
+            int objectIndex = 0;
+            for (MapObject *object : og->objects())
+                createObjectItem(object, ogItem, objectIndex++);
         }
+
         layerItem = ogItem;
         break;
     }
@@ -288,6 +287,112 @@ LayerItem *MapScene::createLayerItem(Layer *layer)
     return layerItem;
 }
 
+MapObjectItem *MapScene::createObjectItem(MapObject *object,
+                                          ObjectGroupItem *ogItem,
+                                          int index)
+{
+    MapObjectItem *item = new MapObjectItem(object, mMapDocument, ogItem);
+    if (ogItem->objectGroup()->drawOrder() == ObjectGroup::TopDownOrder)
+        item->setZValue(item->y());
+    else
+        item->setZValue(index);
+
+    mObjectItems.insert(object, item);
+    ogItem->setHasObjectItem(object, true);
+    return item;
+}
+
+ObjectGroupItem *MapScene::objectGroupItem(ObjectGroup *objectGroup) const
+{
+    return static_cast<ObjectGroupItem*>(mLayerItems.value(objectGroup));
+}
+
+/**
+ * Updates the object group items that paint their objects themselves.
+ */
+void MapScene::syncObjectGroupItems()
+{
+    for (LayerItem *item : mLayerItems)
+        if (ObjectGroupItem *ogItem = dynamic_cast<ObjectGroupItem*>(item))
+            ogItem->syncWithObjects();
+}
+
+MapObjectItem *MapScene::itemForObject(MapObject *object)
+{
+    if (MapObjectItem *item = mObjectItems.value(object))
+        return item;
+
+    ObjectGroup *objectGroup = object->objectGroup();
+    if (!objectGroup)
+        return nullptr;
+
+    ObjectGroupItem *ogItem = objectGroupItem(objectGroup);
+    if (!ogItem || !ogItem->isBatched())
+        return nullptr;
+
+    MapObjectItem *item = createObjectItem(object, ogItem,
+                                           objectGroup->objects().indexOf(object));
+    mOnDemandObjectItems.insert(item);
+    scheduleReleaseUnusedObjectItems();
+    return item;
+}
+
+void MapScene::holdObjectItem(MapObjectItem *item)
+{
+    ++mHeldObjectItems[item];
+}
+
+void MapScene::unholdObjectItem(MapObjectItem *item)
+{
+    auto it = mHeldObjectItems.find(item);
+    if (it == mHeldObjectItems.end())
+        return;
+
+    if (--it.value() == 0) {
+        mHeldObjectItems.erase(it);
+        scheduleReleaseUnusedObjectItems();
+    }
+}
+
+void MapScene::scheduleReleaseUnusedObjectItems()
+{
+    if (mReleaseUnusedObjectItemsScheduled)
+        return;
+
+    mReleaseUnusedObjectItemsScheduled = true;
+    QMetaObject::invokeMethod(this, "releaseUnusedObjectItems",
+                              Qt::QueuedConnection);
+}
+
+/**
+ * Deletes the items that were created on demand for objects in batched object
+ * groups, once they are no longer selected or held. Their objects are painted
+ * by the object group item again.
+ *
+ * This is done from the event loop, so that items returned by itemForObject()
+ * stay valid while the current event is being handled.
+ */
+void MapScene::releaseUnusedObjectItems()
+{
+    mReleaseUnusedObjectItemsScheduled = false;
+
+    for (auto i = mOnDemandObjectItems.begin(); i != mOnDemandObjectItems.end(); ) {
+        MapObjectItem *item = *i;
+
+        if (mSelectedObjectItems.contains(item) || mHeldObjectItems.contains(item)) {
+            ++i;
+            continue;
+        }
+
+        auto ogItem = static_cast<ObjectGroupItem*>(item->parentItem());
+        ogItem->setHasObjectItem(item->mapObject(), false);
+
+        mObjectItems.remove(item->mapObject());
+        delete item;
+        i = mOnDemandObjectItems.erase(i);
+    }
+}
+
 void MapScene::updateDefaultBackgroundColor()
 {
     mDefaultBackgroundColor = QGuiApplication::palette().dark().color();
@@ -358,6 +463,7 @@ void MapScene::repaintRegion(const QRegion &region, Layer *layer)
 {
     const MapRenderer *renderer = mMapDocument->renderer();
     const QMargins margins = mMapDocument->map()->drawMargins();
+    auto tileLayerItem = dynamic_cast<TileLayerItem*>(mLayerItems.value(layer));
 
     for (const QRect &r : region.rects()) {
         QRectF boundingRect = renderer->boundingRect(r);
@@ -367,6 +473,9 @@ void MapScene::repaintRegion(const QRegion &region, Layer *layer)
                             margins.right(),
                             margins.bottom());
 
+        if (tileLayerItem)
+            tileLayerItem->invalidateCache(boundingRect);
+
         boundingRect.translate(layer->totalOffset());
 
         update(boundingRect);
@@ -426,6 +535,7 @@ void MapScene::mapChanged()
 
     for (MapObjectItem *item : mObjectItems)
         item->syncWithMapObject();
+    syncObjectGroupItems();
 
     const Map *map = mMapDocument->map();
     if (map->backgroundColor().isValid())
@@ -439,8 +549,36 @@ void MapScene::repaintTileset(Tileset *tileset)
     if (!mMapDocument)
         return;
 
-    if (contains(mMapDocument->map()->tilesets(), tileset))
+    if (contains(mMapDocument->map()->tilesets(), tileset)) {
+        // Only the cached parts showing animated tiles need to be rendered
+        // again
+        for (QGraphicsItem *item : mLayerItems)
+            if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+                if (tli->tileLayer()->referencesTileset(tileset))
+                    tli->invalidateAnimatedTiles(tileset);
+
         update();
+    }
+}
+
+void MapScene::tilesetImagesChanged(Tileset *tileset)
+{
+    if (!mMapDocument)
+        return;
+
+    Map *map = mMapDocument->map();
+    if (contains(map->tilesets(), tileset)) {
+        // The tile size may have changed along with the images
+        map->invalidateDrawMargins();
+        map->invalidateObjectIndexes();
+
+        for (QGraphicsItem *item : mLayerItems)
+            if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+                if (tli->tileLayer()->referencesTileset(tileset))
+                    tli->invalidateCache();
+
+        update();
+    }
 }
 
 void MapScene::tileLayerDrawMarginsChanged(TileLayer *tileLayer)
@@ -460,7 +598,21 @@ void MapScene::layerAdded(Layer *layer)
 
 void MapScene::layerRemoved(Layer *layer)
 {
-    delete mLayerItems.take(layer);
+    LayerItem *layerItem = mLayerItems.take(layer);
+
+    // Forget about the object items that are deleted along with the layer
+    for (auto i = mObjectItems.begin(); i != mObjectItems.end(); ) {
+        MapObjectItem *item = i.value();
+        if (layerItem && layerItem->isAncestorOf(item)) {
+            mOnDemandObjectItems.remove(item);
+            mHeldObjectItems.remove(item);
+            i = mObjectItems.erase(i);
+        } else {
+            ++i;
+        }
+    }
+
+    delete layerItem;
 }
 
 // Returns whether layerB is drawn above layerA
@@ -563,6 +715,7 @@ void MapScene::adaptToTilesetTileSizeChanges(Tileset *tileset)
         if (cell.tileset() == tileset)
             item->syncWithMapObject();
     }
+    syncObjectGroupItems();
 }
 
 void MapScene::adaptToTileSizeChanges(Tile *tile)
@@ -578,6 +731,7 @@ void MapScene::adaptToTileSizeChanges(Tile *tile)
         if (cell.tile() == tile)
             item->syncWithMapObject();
     }
+    syncObjectGroupItems();
 }
 
 void MapScene::tilesetReplaced(int index, Tileset *tileset)
@@ -591,33 +745,17 @@ void MapScene::tilesetReplaced(int index, Tileset *tileset)
  */
 void MapScene::objectsInserted(ObjectGroup *objectGroup, int first, int last)
 {
-    ObjectGroupItem *ogItem = nullptr;
-
-    // Find the object group item for the object group
-    for (QGraphicsItem *item : mLayerItems) {
-        if (ObjectGroupItem *ogi = dynamic_cast<ObjectGroupItem*>(item)) {
-            if (ogi->objectGroup() == objectGroup) {
-                ogItem = ogi;
-                break;
-            }
-        }
-    }
-
+    ObjectGroupItem *ogItem = objectGroupItem(objectGroup);
     Q_ASSERT(ogItem);
 
-    const ObjectGroup::DrawOrder drawOrder = objectGroup->drawOrder();
-
-    for (int i = first; i <= last; ++i) {
-        MapObject *object = objectGroup->objectAt(i);
-
-        MapObjectItem *item = new MapObjectItem(object, mMapDocument, ogItem);
-        if (drawOrder == ObjectGroup::TopDownOrder)
-            item->setZValue(item->y());
-        else
-            item->setZValue(i);
-
-        mObjectItems.insert(object, item);
+    if (ogItem->isBatched()) {
+        ogItem->objectsIndexChanged();
+        ogItem->objectsChanged(objectGroup->objects().mid(first, last - first + 1));
+        return;
     }
+
+    for (int i = first; i <= last; ++i)
+        createObjectItem(objectGroup->objectAt(i), ogItem, i);
 }
 
 /**
@@ -627,12 +765,24 @@ void MapScene::objectsRemoved(const QList<MapObject*> &objects)
 {
     for (MapObject *o : objects) {
         auto i = mObjectItems.find(o);
-        Q_ASSERT(i != mObjectItems.end());
+
+        // Objects painted by a batched object group item have no item
+        if (i == mObjectItems.end())
+            continue;
+
+        auto ogItem = static_cast<ObjectGroupItem*>(i.value()->parentItem());
+        ogItem->setHasObjectItem(o, false);
 
         mSelectedObjectItems.remove(i.value());
+        mOnDemandObjectItems.remove(i.value());
+        mHeldObjectItems.remove(i.value());
         delete i.value();
         mObjectItems.erase(i);
     }
+
+    for (LayerItem *item : mLayerItems)
+        if (ObjectGroupItem *ogItem = dynamic_cast<ObjectGroupItem*>(item))
+            ogItem->objectsIndexChanged();
 }
 
 /**
@@ -640,12 +790,21 @@ void MapScene::objectsRemoved(const QList<MapObject*> &objects)
  */
 void MapScene::objectsChanged(const QList<MapObject*> &objects)
 {
+    QHash<ObjectGroupItem*, QList<MapObject*>> batchedObjects;
+
     for (MapObject *object : objects) {
-        MapObjectItem *item = itemForObject(object);
-        Q_ASSERT(item);
+        if (MapObjectItem *item = mObjectItems.value(object))
+            item->syncWithMapObject();
 
-        item->syncWithMapObject();
+        // Also for objects with an on-demand item, since the object group
+        // item paints them again once their item is released
+        if (ObjectGroupItem *ogItem = objectGroupItem(object->objectGroup()))
+            if (ogItem->isBatched())
+                batchedObjects[ogItem].append(object);
     }
+
+    for (auto it = batchedObjects.begin(); it != batchedObjects.end(); ++it)
+        it.key()->objectsChanged(it.value());
 }
 
 /**
@@ -657,12 +816,11 @@ void MapScene::objectsIndexChanged(ObjectGroup *objectGroup,
     if (objectGroup->drawOrder() != ObjectGroup::IndexOrder)
         return;
 
-    for (int i = first; i <= last; ++i) {
-        MapObjectItem *item = itemForObject(objectGroup->objectAt(i));
-        Q_ASSERT(item);
+    objectGroupItem(objectGroup)->objectsIndexChanged();
 
-        item->setZValue(i);
-    }
+    for (int i = first; i <= last; ++i)
+        if (MapObjectItem *item = mObjectItems.value(objectGroup->objectAt(i)))
+            item->setZValue(i);
 }
 
 void MapScene::updateSelectedObjectItems()
@@ -679,12 +837,15 @@ void MapScene::updateSelectedObjectItems()
 
     mSelectedObjectItems = items;
     emit selectedObjectItemsChanged();
+
+    scheduleReleaseUnusedObjectItems();
 }
 
 void MapScene::syncAllObjectItems()
 {
     for (MapObjectItem *item : mObjectItems)
         item->syncWithMapObject();
+    syncObjectGroupItems();
 }
 
 /**
@@ -716,6 +877,7 @@ void MapScene::setObjectLineWidth(qreal lineWidth)
 
             update();
         }
+        syncObjectGroupItems();
     }
 }
 
@@ -728,8 +890,7 @@ void MapScene::setShowTileObjectOutlines(bool enabled)
 
     if (mMapDocument) {
         mMapDocument->renderer()->setFlag(ShowTileObjectOutlines, enabled);
-        if (!mObjectItems.isEmpty())
-            update();
+        update();
     }
 }
 
@@ -25,6 +25,7 @@
 
 #include <QColor>
 #include <QGraphicsScene>
+#include <QHash>
 #include <QMap>
 #include <QSet>
 
@@ -95,9 +96,18 @@ public:
 
     /**
      * Returns the MapObjectItem associated with the given \a mapObject.
+     *
+     * Objects in batched object groups get their item created on demand.
      */
-    MapObjectItem *itemForObject(MapObject *object) const
-    { return mObjectItems.value(object); }
+    MapObjectItem *itemForObject(MapObject *object);
+
+    /**
+     * Keeps the given on-demand \a item alive while it is not selected, for
+     * example while it is hovered or clicked by a tool. Each call needs to be
+     * balanced by a call to unholdObjectItem().
+     */
+    void holdObjectItem(MapObjectItem *item);
+    void unholdObjectItem(MapObjectItem *item);
 
     /**
      * Enables the selected tool at this map scene.
@@ -156,6 +166,7 @@ private slots:
 
     void mapChanged();
     void repaintTileset(Tileset *tileset);
+    void tilesetImagesChanged(Tileset *tileset);
     void tileLayerDrawMarginsChanged(TileLayer *tileLayer);
 
     void layerAdded(Layer *layer);
@@ -177,10 +188,16 @@ private slots:
 
     void updateSelectedObjectItems();
     void syncAllObjectItems();
+    void releaseUnusedObjectItems();
 
 private:
     void createLayerItems(const QList<Layer *> &layers);
     LayerItem *createLayerItem(Layer *layer);
+    MapObjectItem *createObjectItem(MapObject *object, ObjectGroupItem *ogItem,
+                                    int index);
+    ObjectGroupItem *objectGroupItem(ObjectGroup *objectGroup) const;
+    void syncObjectGroupItems();
+    void scheduleReleaseUnusedObjectItems();
 
     void updateDefaultBackgroundColor();
     void updateSceneRect();
@@ -205,6 +222,9 @@ private:
 
     QMap<MapObject*, MapObjectItem*> mObjectItems;
     QSet<MapObjectItem*> mSelectedObjectItems;
+    QSet<MapObjectItem*> mOnDemandObjectItems;
+    QHash<MapObjectItem*, int> mHeldObjectItems;
+    bool mReleaseUnusedObjectItemsScheduled;
 };
 
 } // namespace Internal
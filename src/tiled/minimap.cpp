@@ -22,24 +22,35 @@
 #include "minimap.h"
 
 #include "documentmanager.h"
+#include "grouplayer.h"
+#include "hexagonalrenderer.h"
+#include "imagecache.h"
 #include "imagelayer.h"
+#include "isometricrenderer.h"
 #include "map.h"
 #include "mapdocument.h"
 #include "mapobject.h"
 #include "mapobjectitem.h"
-#include "maprenderer.h"
 #include "mapview.h"
 #include "objectgroup.h"
+#include "orthogonalrenderer.h"
 #include "preferences.h"
+#include "staggeredrenderer.h"
+#include "tile.h"
 #include "tilelayer.h"
+#include "tileset.h"
 #include "utils.h"
 #include "zoomable.h"
 
+#include <QAtomicInt>
 #include <QCursor>
 #include <QPainter>
 #include <QResizeEvent>
+#include <QRunnable>
+#include <QScopedPointer>
 #include <QScrollBar>
-#include <QUndoStack>
+#include <QSet>
+#include <QThreadPool>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -50,6 +61,7 @@ MiniMap::MiniMap(QWidget *parent)
     , mDragging(false)
     , mMouseMoveCursorState(false)
     , mRedrawMapImage(false)
+    , mRedrawWholeMap(true)
     , mRenderFlags(DrawTiles | DrawObjects | DrawImages | IgnoreInvisibleLayer)
 {
     setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
@@ -63,6 +75,11 @@ MiniMap::MiniMap(QWidget *parent)
             SLOT(redrawTimeout()));
 }
 
+MiniMap::~MiniMap()
+{
+    cancelRenderJob();
+}
+
 void MiniMap::setMapDocument(MapDocument *map)
 {
     const DocumentManager *dm = DocumentManager::instance();
@@ -77,11 +94,41 @@ void MiniMap::setMapDocument(MapDocument *map)
         }
     }
 
+    cancelRenderJob();
     mMapDocument = map;
+    mObjectAreas.clear();
+    mImageCache.clear();
 
     if (mMapDocument) {
-        connect(mMapDocument->undoStack(), SIGNAL(indexChanged(int)),
-                this, SLOT(scheduleMapImageUpdate()));
+        // Changes to the map structure require the whole image to be redrawn
+        connect(mMapDocument, &MapDocument::mapChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::layerAdded,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::layerRemoved,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::layerChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::tileLayerDrawMarginsChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::objectGroupChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::imageLayerChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::tilesetReplaced,
+                this, &MiniMap::scheduleMapImageUpdate);
+
+        // Other changes only need the affected area to be redrawn
+        connect(mMapDocument, &MapDocument::regionChanged,
+                this, &MiniMap::regionChanged);
+        connect(mMapDocument, &MapDocument::objectsInserted,
+                this, &MiniMap::objectsInserted);
+        connect(mMapDocument, &MapDocument::objectsRemoved,
+                this, &MiniMap::objectsChanged);
+        connect(mMapDocument, &MapDocument::objectsChanged,
+                this, &MiniMap::objectsChanged);
+        connect(mMapDocument, &MapDocument::objectsIndexChanged,
+                this, &MiniMap::objectsInserted);
 
         if (MapView *mapView = dm->viewForDocument(mMapDocument)) {
             connect(mapView->horizontalScrollBar(), SIGNAL(valueChanged(int)), SLOT(update()));
@@ -100,6 +147,16 @@ QSize MiniMap::sizeHint() const
 
 void MiniMap::scheduleMapImageUpdate()
 {
+    mRedrawWholeMap = true;
+    mDirtyArea = QRegion();
+    mMapImageUpdateTimer.start(100);
+}
+
+void MiniMap::scheduleMapAreaUpdate(const QRectF &area)
+{
+    if (!mRedrawWholeMap)
+        mDirtyArea |= area.toAlignedRect();
+
     mMapImageUpdateTimer.start(100);
 }
 
@@ -108,8 +165,17 @@ void MiniMap::paintEvent(QPaintEvent *pe)
     QFrame::paintEvent(pe);
 
     if (mRedrawMapImage) {
-        renderMapToImage();
         mRedrawMapImage = false;
+
+        if (mRedrawWholeMap || (mMapImage.isNull() && !mRenderJob)) {
+            mRedrawWholeMap = false;
+            mDirtyArea = QRegion();
+            renderMapToImage();
+        } else if (!mRenderJob) {
+            renderAreaToImage(mDirtyArea);
+            mDirtyArea = QRegion();
+        }
+        // Otherwise the dirty area is redrawn once the running render is done
     }
 
     if (mMapImage.isNull() || mImageRect.isEmpty())
@@ -169,8 +235,419 @@ static bool objectLessThan(const MapObject *a, const MapObject *b)
     return a->y() < b->y();
 }
 
+/**
+ * Returns the area covered by the given \a object in pixels, not including
+ * the offset of its layer.
+ */
+static QRectF objectArea(const MapRenderer *renderer, const MapObject *object)
+{
+    QRectF area = renderer->boundingRect(object);
+
+    if (object->rotation() != qreal(0)) {
+        const QPointF origin = renderer->pixelToScreenCoords(object->position());
+        QTransform transform;
+        transform.translate(origin.x(), origin.y());
+        transform.rotate(object->rotation());
+        transform.translate(-origin.x(), -origin.y());
+        area = transform.mapRect(area);
+    }
+
+    return area;
+}
+
+/**
+ * Draws the layers of the \a map, limited to the \a exposed rectangle unless
+ * it is null.
+ *
+ * When \a objectAreas is given, it is updated with the area where each object
+ * was drawn. When \a cancelled is given, drawing stops as soon as it is set.
+ */
+static void drawLayers(QPainter &painter,
+                       const Map *map,
+                       MapRenderer *renderer,
+                       MiniMap::MiniMapRenderFlags renderFlags,
+                       const ObjectTypes &objectTypes,
+                       const QRectF &exposed,
+                       QHash<const MapObject*, QRectF> *objectAreas = nullptr,
+                       const QAtomicInt *cancelled = nullptr)
+{
+    bool drawObjects = renderFlags.testFlag(MiniMap::DrawObjects);
+    bool drawTiles = renderFlags.testFlag(MiniMap::DrawTiles);
+    bool drawImages = renderFlags.testFlag(MiniMap::DrawImages);
+    bool visibleLayersOnly = renderFlags.testFlag(MiniMap::IgnoreInvisibleLayer);
+
+    LayerIterator iterator(map);
+    while (const Layer *layer = iterator.next()) {
+        if (cancelled && cancelled->load())
+            return;
+
+        if (visibleLayersOnly && layer->isHidden())
+            continue;
+
+        const auto offset = layer->totalOffset();
+        const QRectF layerExposed = exposed.translated(-offset);
+
+        painter.setOpacity(layer->affectiveOpacity());
+        painter.translate(offset);
+
+        const TileLayer *tileLayer = dynamic_cast<const TileLayer*>(layer);
+        const ObjectGroup *objGroup = dynamic_cast<const ObjectGroup*>(layer);
+        const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
+
+        if (tileLayer && drawTiles) {
+            renderer->drawTileLayer(&painter, tileLayer, layerExposed);
+        } else if (objGroup && drawObjects) {
+            QList<MapObject*> objects = objGroup->objects();
+
+            if (objGroup->drawOrder() == ObjectGroup::TopDownOrder)
+                qStableSort(objects.begin(), objects.end(), objectLessThan);
+
+            foreach (const MapObject *object, objects) {
+                if (!object->isVisible()) {
+                    if (objectAreas)
+                        objectAreas->remove(object);
+                    continue;
+                }
+
+                if (objectAreas || !layerExposed.isNull()) {
+                    const QRectF area = objectArea(renderer, object);
+
+                    if (objectAreas)
+                        objectAreas->insert(object, area.translated(offset));
+
+                    if (!layerExposed.isNull() && !area.intersects(layerExposed))
+                        continue;
+                }
+
+                if (object->rotation() != qreal(0)) {
+                    QPointF origin = renderer->pixelToScreenCoords(object->position());
+                    painter.save();
+                    painter.translate(origin);
+                    painter.rotate(object->rotation());
+                    painter.translate(-origin);
+                }
+
+                const QColor color = MapObjectItem::objectColor(object, objectTypes);
+                renderer->drawMapObject(&painter, object, color);
+
+                if (object->rotation() != qreal(0))
+                    painter.restore();
+            }
+        } else if (imageLayer && drawImages) {
+            renderer->drawImageLayer(&painter, imageLayer, layerExposed);
+        }
+
+        painter.translate(-offset);
+    }
+}
+
+static MapRenderer *createRenderer(Map *map)
+{
+    switch (map->orientation()) {
+    case Map::Isometric:
+        return new IsometricRenderer(map);
+    case Map::Staggered:
+        return new StaggeredRenderer(map);
+    case Map::Hexagonal:
+        return new HexagonalRenderer(map);
+    default:
+        return new OrthogonalRenderer(map);
+    }
+}
+
+/**
+ * The part of a map drawn by the mini-map, copied so that it can be rendered
+ * outside of the GUI thread.
+ *
+ * The layers are copied along with light copies of the tilesets they use,
+ * which only contain the size of each tile. The images of the tiles and image
+ * layers are drawn from QImage copies, since pixmaps can only be used in the
+ * GUI thread.
+ */
+struct MiniMapSnapshot
+{
+    QScopedPointer<Map> map;
+    RenderImages images;
+
+    // Deferred tile images, loaded by the render job when they are used
+    QHash<const Tile*, QString> deferredImages;
+};
+
+/**
+ * Copies the given \a layer when it is drawn by the mini-map. Group layers
+ * only include their drawn children.
+ */
+static Layer *snapshotLayer(const Layer *layer,
+                            MiniMap::MiniMapRenderFlags renderFlags)
+{
+    if (renderFlags.testFlag(MiniMap::IgnoreInvisibleLayer) && !layer->isVisible())
+        return nullptr;
+
+    switch (layer->layerType()) {
+    case Layer::TileLayerType:
+        if (renderFlags.testFlag(MiniMap::DrawTiles))
+            return layer->clone();  // implicitly shares the tile data
+        break;
+    case Layer::ObjectGroupType:
+        if (renderFlags.testFlag(MiniMap::DrawObjects))
+            return layer->clone();
+        break;
+    case Layer::ImageLayerType:
+        if (renderFlags.testFlag(MiniMap::DrawImages))
+            return layer->clone();
+        break;
+    case Layer::GroupLayerType: {
+        GroupLayer *groupLayer = new GroupLayer(layer->name(), layer->x(), layer->y());
+        groupLayer->setOpacity(layer->opacity());
+        groupLayer->setVisible(layer->isVisible());
+        groupLayer->setOffset(layer->offset());
+
+        for (const Layer *childLayer : *static_cast<const GroupLayer*>(layer))
+            if (Layer *copy = snapshotLayer(childLayer, renderFlags))
+                groupLayer->addLayer(copy);
+
+        return groupLayer;
+    }
+    }
+
+    return nullptr;
+}
+
+/**
+ * Creates the snapshot of the given \a map that is drawn with the given
+ * \a renderFlags.
+ *
+ * The pixmaps are converted to images only when they are not in
+ * \a imageCache yet. Afterwards, the cache only holds the images used by the
+ * snapshot.
+ */
+static MiniMapSnapshot *createSnapshot(const Map *map,
+                                       MiniMap::MiniMapRenderFlags renderFlags,
+                                       QHash<qint64, QImage> &imageCache)
+{
+    MiniMapSnapshot *snapshot = new MiniMapSnapshot;
+    snapshot->map.reset(new Map(map->orientation(),
+                                map->width(), map->height(),
+                                map->tileWidth(), map->tileHeight()));
+
+    Map *snapshotMap = snapshot->map.data();
+    snapshotMap->setRenderOrder(map->renderOrder());
+    snapshotMap->setHexSideLength(map->hexSideLength());
+    snapshotMap->setStaggerAxis(map->staggerAxis());
+    snapshotMap->setStaggerIndex(map->staggerIndex());
+
+    for (const Layer *layer : map->layers())
+        if (Layer *copy = snapshotLayer(layer, renderFlags))
+            snapshotMap->addLayer(copy);
+
+    const QHash<qint64, QImage> previousImageCache = imageCache;
+    imageCache.clear();
+
+    auto toImage = [&] (const QPixmap &pixmap) -> QImage {
+        if (pixmap.isNull())
+            return QImage();
+
+        const qint64 key = pixmap.cacheKey();
+        QImage image = previousImageCache.value(key);
+        if (image.isNull())
+            image = pixmap.toImage();
+
+        imageCache.insert(key, image);
+        return image;
+    };
+
+    QSet<SharedTileset> usedTilesets;
+
+    LayerIterator iterator(snapshotMap);
+    while (Layer *layer = iterator.next()) {
+        if (ImageLayer *imageLayer = layer->asImageLayer()) {
+            snapshot->images.imageLayers.insert(imageLayer, toImage(imageLayer->image()));
+            imageLayer->setImage(QPixmap());
+        } else if (!layer->isGroupLayer()) {
+            usedTilesets |= layer->usedTilesets();
+        }
+    }
+
+    for (const SharedTileset &tileset : usedTilesets) {
+        SharedTileset copy = Tileset::create(tileset->name(),
+                                             tileset->tileWidth(),
+                                             tileset->tileHeight());
+        copy->setTileOffset(tileset->tileOffset());
+
+        QList<Tile*> tiles;
+
+        for (const Tile *tile : tileset->tiles()) {
+            Tile *tileCopy = new Tile(tile->id(), copy.data());
+            tileCopy->setImage(QPixmap(), tile->imageRect());
+            tiles.append(tileCopy);
+
+            // The snapshot is rendered with the animation frames current at
+            // this time
+            const Tile *frameTile = tile->currentFrameTile();
+            if (!frameTile)
+                continue;
+
+            if (frameTile->isImageDeferred()) {
+                snapshot->deferredImages.insert(tileCopy, frameTile->imageSource());
+            } else {
+                const RenderImages::TileImage image = {
+                    toImage(frameTile->image()),
+                    frameTile->imageRect()
+                };
+                snapshot->images.tiles.insert(tileCopy, image);
+            }
+        }
+
+        copy->addTiles(tiles);
+        snapshotMap->addTileset(copy);
+
+        for (Layer *layer : snapshotMap->layers())
+            layer->replaceReferencesToTileset(tileset.data(), copy.data());
+    }
+
+    return snapshot;
+}
+
+/**
+ * Loads the deferred images of the tiles used by the \a snapshot. Images
+ * can be loaded from any thread.
+ */
+static void loadDeferredImages(MiniMapSnapshot *snapshot,
+                               const QAtomicInt &cancelled)
+{
+    QHash<const Tile*, QString> &deferredImages = snapshot->deferredImages;
+
+    auto loadImage = [&] (const Cell &cell) {
+        const Tile *tile = cell.tile();
+        if (!tile)
+            return;
+
+        auto it = deferredImages.find(tile);
+        if (it == deferredImages.end())
+            return;
+
+        const QImage image = ImageCache::loadImage(it.value());
+        const RenderImages::TileImage tileImage = { image, image.rect() };
+        snapshot->images.tiles.insert(tile, tileImage);
+
+        deferredImages.erase(it);
+    };
+
+    LayerIterator iterator(snapshot->map.data());
+    while (const Layer *layer = iterator.next()) {
+        if (deferredImages.isEmpty() || cancelled.load())
+            return;
+
+        if (layer->isTileLayer()) {
+            for (const Cell &cell : *static_cast<const TileLayer*>(layer))
+                loadImage(cell);
+        } else if (layer->isObjectGroup()) {
+            for (const MapObject *object : static_cast<const ObjectGroup*>(layer)->objects())
+                loadImage(object->cell());
+        }
+    }
+}
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Renders the whole mini-map image from a snapshot of the map, in a thread
+ * from the global thread pool. Deletes itself when done.
+ *
+ * The job lives in the GUI thread, so that the snapshot is also deleted
+ * there.
+ */
+class MiniMapRenderJob : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    MiniMapRenderJob(MiniMapSnapshot *snapshot,
+                     const MapRenderer *mapRenderer,
+                     MiniMap::MiniMapRenderFlags renderFlags,
+                     const QSize &imageSize,
+                     const QTransform &transform)
+        : mSnapshot(snapshot)
+        , mRenderer(createRenderer(snapshot->map.data()))
+        , mRenderFlags(renderFlags)
+        , mObjectTypes(Preferences::instance()->objectTypes())
+        , mGridColor(Preferences::instance()->gridColor())
+        , mImageSize(imageSize)
+        , mTransform(transform)
+    {
+        setAutoDelete(false);
+        mRenderer->setObjectLineWidth(mapRenderer->objectLineWidth());
+        mRenderer->setRenderImages(&snapshot->images);
+    }
+
+    ~MiniMapRenderJob()
+    {
+        delete mRenderer;
+        delete mSnapshot;
+    }
+
+    /**
+     * Makes the job stop as soon as possible, without reporting a result.
+     */
+    void cancel() { mCancelled.store(1); }
+
+    const QTransform &transform() const { return mTransform; }
+
+    void run() override
+    {
+        loadDeferredImages(mSnapshot, mCancelled);
+
+        QImage image(mImageSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        QPainter painter(&image);
+        painter.setRenderHints(QPainter::SmoothPixmapTransform);
+        painter.setTransform(mTransform);
+        mRenderer->setPainterScale(mTransform.m11());
+
+        drawLayers(painter, mSnapshot->map.data(), mRenderer, mRenderFlags, mObjectTypes,
+                   QRectF(), nullptr, &mCancelled);
+
+        if (mRenderFlags.testFlag(MiniMap::DrawGrid)) {
+            mRenderer->drawGrid(&painter, QRectF(QPointF(), mRenderer->mapSize()),
+                                mGridColor);
+        }
+
+        painter.end();
+
+        if (!mCancelled.load())
+            emit finished(image);
+
+        deleteLater();
+    }
+
+signals:
+    void finished(const QImage &image);
+
+private:
+    MiniMapSnapshot *mSnapshot;
+    MapRenderer *mRenderer;
+    const MiniMap::MiniMapRenderFlags mRenderFlags;
+    const ObjectTypes mObjectTypes;
+    const QColor mGridColor;
+    const QSize mImageSize;
+    const QTransform mTransform;
+    QAtomicInt mCancelled;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+/**
+ * Starts rendering the whole map image in the background. The current image
+ * is displayed until the new one is done.
+ */
 void MiniMap::renderMapToImage()
 {
+    cancelRenderJob();
+    mObjectAreas.clear();
+
     if (!mMapDocument) {
         mMapImage = QImage();
         return;
@@ -197,82 +674,135 @@ void MiniMap::renderMapToImage()
     qreal scale = qMin((qreal) viewSize.width() / mapSize.width(),
                        (qreal) viewSize.height() / mapSize.height());
 
-    // Allocate a new image when the size changed
     const QSize imageSize = mapSize * scale;
-    if (mMapImage.size() != imageSize) {
-        mMapImage = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
+    if (imageSize.isEmpty()) {
+        mMapImage = QImage();
         updateImageRect();
+        return;
+    }
+
+    QTransform transform = QTransform::fromScale(scale, scale);
+    transform.translate(margins.left(), margins.top());
+
+    MiniMapSnapshot *snapshot = createSnapshot(mMapDocument->map(), mRenderFlags,
+                                               mImageCache);
+
+    MiniMapRenderJob *job = new MiniMapRenderJob(snapshot, renderer, mRenderFlags,
+                                                 imageSize, transform);
+    connect(job, &MiniMapRenderJob::finished,
+            this, &MiniMap::mapImageRendered);
+
+    mRenderJob = job;
+    QThreadPool::globalInstance()->start(job);
+}
+
+void MiniMap::cancelRenderJob()
+{
+    if (mRenderJob) {
+        mRenderJob->disconnect(this);
+        mRenderJob->cancel();
+        mRenderJob = nullptr;
     }
+}
 
-    if (imageSize.isEmpty())
+void MiniMap::mapImageRendered(const QImage &image)
+{
+    if (sender() != mRenderJob.data())
         return;
 
-    bool drawObjects = mRenderFlags.testFlag(DrawObjects);
-    bool drawTiles = mRenderFlags.testFlag(DrawTiles);
-    bool drawImages = mRenderFlags.testFlag(DrawImages);
-    bool drawTileGrid = mRenderFlags.testFlag(DrawGrid);
-    bool visibleLayersOnly = mRenderFlags.testFlag(IgnoreInvisibleLayer);
+    mMapImage = image;
+    mImageTransform = mRenderJob->transform();
+    mRenderJob = nullptr;
 
-    // Remember the current render flags
-    const Tiled::RenderFlags renderFlags = renderer->flags();
-    renderer->setFlag(ShowTileObjectOutlines, false);
+    updateImageRect();
+    updateObjectAreas();
 
-    mMapImage.fill(Qt::transparent);
-    QPainter painter(&mMapImage);
-    painter.setRenderHints(QPainter::SmoothPixmapTransform);
-    painter.setTransform(QTransform::fromScale(scale, scale));
-    painter.translate(margins.left(), margins.top());
-    renderer->setPainterScale(scale);
+    // Catch up with changes made while the image was being rendered
+    if (!mDirtyArea.isEmpty())
+        mRedrawMapImage = true;
+
+    update();
+}
+
+/**
+ * Remembers where each object is drawn on the map image, so that the area
+ * can be updated when the object changes.
+ */
+void MiniMap::updateObjectAreas()
+{
+    mObjectAreas.clear();
+
+    if (!mMapDocument || !mRenderFlags.testFlag(DrawObjects))
+        return;
+
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const bool visibleLayersOnly = mRenderFlags.testFlag(IgnoreInvisibleLayer);
 
     LayerIterator iterator(mMapDocument->map());
     while (const Layer *layer = iterator.next()) {
         if (visibleLayersOnly && layer->isHidden())
             continue;
 
-        const auto offset = layer->totalOffset();
-
-        painter.setOpacity(layer->affectiveOpacity());
-        painter.translate(offset);
-
-        const TileLayer *tileLayer = dynamic_cast<const TileLayer*>(layer);
-        const ObjectGroup *objGroup = dynamic_cast<const ObjectGroup*>(layer);
-        const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
+        if (!layer->isObjectGroup())
+            continue;
 
-        if (tileLayer && drawTiles) {
-            renderer->drawTileLayer(&painter, tileLayer);
-        } else if (objGroup && drawObjects) {
-            QList<MapObject*> objects = objGroup->objects();
+        const ObjectGroup *objectGroup = static_cast<const ObjectGroup*>(layer);
 
-            if (objGroup->drawOrder() == ObjectGroup::TopDownOrder)
-                qStableSort(objects.begin(), objects.end(), objectLessThan);
+        const auto offset = objectGroup->totalOffset();
 
-            foreach (const MapObject *object, objects) {
-                if (object->isVisible()) {
-                    if (object->rotation() != qreal(0)) {
-                        QPointF origin = renderer->pixelToScreenCoords(object->position());
-                        painter.save();
-                        painter.translate(origin);
-                        painter.rotate(object->rotation());
-                        painter.translate(-origin);
-                    }
-
-                    const QColor color = MapObjectItem::objectColor(object);
-                    renderer->drawMapObject(&painter, object, color);
-
-                    if (object->rotation() != qreal(0))
-                        painter.restore();
-                }
-            }
-        } else if (imageLayer && drawImages) {
-            renderer->drawImageLayer(&painter, imageLayer);
+        for (const MapObject *object : objectGroup->objects()) {
+            if (object->isVisible())
+                mObjectAreas.insert(object, objectArea(renderer, object).translated(offset));
         }
+    }
+}
 
-        painter.translate(-offset);
+/**
+ * Redraws only the given \a area of the map image, which is given in pixels
+ * as rendered by the map renderer. Relies on the scale and position of the
+ * map within the image to be unchanged since the last renderMapToImage().
+ */
+void MiniMap::renderAreaToImage(const QRegion &area)
+{
+    if (!mMapDocument || area.isEmpty())
+        return;
+
+    // Include some extra pixels around each rect, to cover for antialiasing
+    // and the outlines of objects
+    QRegion imageArea;
+    for (const QRect &rect : area.rects()) {
+        const QRectF mapped = mImageTransform.mapRect(QRectF(rect));
+        imageArea |= mapped.toAlignedRect().adjusted(-2, -2, 2, 2);
     }
+    imageArea &= mMapImage.rect();
 
-    if (drawTileGrid) {
-        Preferences *prefs = Preferences::instance();
-        renderer->drawGrid(&painter, QRectF(QPointF(), renderer->mapSize()),
+    if (imageArea.isEmpty())
+        return;
+
+    MapRenderer *renderer = mMapDocument->renderer();
+    Preferences *prefs = Preferences::instance();
+
+    // Remember the current render flags
+    const Tiled::RenderFlags renderFlags = renderer->flags();
+    renderer->setFlag(ShowTileObjectOutlines, false);
+
+    QPainter painter(&mMapImage);
+    painter.setClipRegion(imageArea);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(mMapImage.rect(), Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    painter.setRenderHints(QPainter::SmoothPixmapTransform);
+    painter.setTransform(mImageTransform);
+    renderer->setPainterScale(mImageTransform.m11());
+
+    const QRectF exposed = mImageTransform.inverted().mapRect(QRectF(imageArea.boundingRect()));
+    drawLayers(painter, mMapDocument->map(), renderer, mRenderFlags,
+               prefs->objectTypes(), exposed, &mObjectAreas);
+
+    if (mRenderFlags.testFlag(DrawGrid)) {
+        const QRectF mapRect(QPointF(), renderer->mapSize());
+        renderer->drawGrid(&painter, mapRect.intersected(exposed),
                            prefs->gridColor());
     }
 
@@ -297,6 +827,47 @@ void MiniMap::redrawTimeout()
     update();
 }
 
+void MiniMap::regionChanged(const QRegion &region, Layer *layer)
+{
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const QMargins margins = mMapDocument->map()->drawMargins();
+
+    for (const QRect &r : region.rects()) {
+        QRectF boundingRect = renderer->boundingRect(r);
+
+        boundingRect.adjust(-margins.left(),
+                            -margins.top(),
+                            margins.right(),
+                            margins.bottom());
+
+        boundingRect.translate(layer->totalOffset());
+
+        scheduleMapAreaUpdate(boundingRect);
+    }
+}
+
+void MiniMap::objectsChanged(const QList<MapObject*> &objects)
+{
+    for (const MapObject *object : objects) {
+        // Clear the area where the object was last drawn
+        const auto it = mObjectAreas.constFind(object);
+        if (it != mObjectAreas.constEnd())
+            scheduleMapAreaUpdate(it.value());
+
+        if (ObjectGroup *objectGroup = object->objectGroup()) {
+            const QRectF area = objectArea(mMapDocument->renderer(), object);
+            scheduleMapAreaUpdate(area.translated(objectGroup->totalOffset()));
+        } else {
+            mObjectAreas.remove(object);
+        }
+    }
+}
+
+void MiniMap::objectsInserted(ObjectGroup *objectGroup, int first, int last)
+{
+    objectsChanged(objectGroup->objects().mid(first, last - first + 1));
+}
+
 void MiniMap::wheelEvent(QWheelEvent *event)
 {    
     if (event->orientation() == Qt::Vertical) {
@@ -400,3 +971,5 @@ QPointF MiniMap::mapToScene(QPoint p) const
     return QPointF(p.x() * (sceneRect.width() / mImageRect.width()) + sceneRect.x(),
                    p.y() * (sceneRect.height() / mImageRect.height()) + sceneRect.y());
 }
+
+#include "minimap.moc"
@@ -22,13 +22,23 @@
 #pragma once
 
 #include <QFrame>
+#include <QHash>
 #include <QImage>
+#include <QPointer>
+#include <QRegion>
 #include <QTimer>
+#include <QTransform>
 
 namespace Tiled {
+
+class Layer;
+class MapObject;
+class ObjectGroup;
+
 namespace Internal {
 
 class MapDocument;
+class MiniMapRenderJob;
 
 class MiniMap : public QFrame
 {
@@ -45,6 +55,7 @@ public:
     Q_DECLARE_FLAGS(MiniMapRenderFlags, MiniMapRenderFlag)
 
     MiniMap(QWidget *parent);
+    ~MiniMap();
 
     void setMapDocument(MapDocument *);
 
@@ -57,6 +68,12 @@ public slots:
     /** Schedules a redraw of the minimap image. */
     void scheduleMapImageUpdate();
 
+    /**
+     * Schedules a redraw of only the given \a area of the minimap image. The
+     * area is given in pixels, as rendered by the map renderer.
+     */
+    void scheduleMapAreaUpdate(const QRectF &area);
+
 protected:
     void paintEvent(QPaintEvent *) override;
     void resizeEvent(QResizeEvent *) override;
@@ -67,6 +84,11 @@ protected:
 
 private slots:
     void redrawTimeout();
+    void mapImageRendered(const QImage &image);
+
+    void regionChanged(const QRegion &region, Layer *layer);
+    void objectsChanged(const QList<MapObject*> &objects);
+    void objectsInserted(ObjectGroup *objectGroup, int first, int last);
 
 private:
     MapDocument *mMapDocument;
@@ -77,12 +99,21 @@ private:
     QPoint mDragOffset;
     bool mMouseMoveCursorState;
     bool mRedrawMapImage;
+    bool mRedrawWholeMap;
+    QRegion mDirtyArea;
+    QTransform mImageTransform;
+    QHash<const MapObject*, QRectF> mObjectAreas;
+    QPointer<MiniMapRenderJob> mRenderJob;
+    QHash<qint64, QImage> mImageCache;  // images of pixmaps, by cache key
     MiniMapRenderFlags mRenderFlags;
 
     QRect viewportRect() const;
     QPointF mapToScene(QPoint p) const;
     void updateImageRect();
     void renderMapToImage();
+    void cancelRenderJob();
+    void updateObjectAreas();
+    void renderAreaToImage(const QRegion &area);
     void centerViewOnLocalPixel(QPoint centerPos, int delta = 0);
 };
 
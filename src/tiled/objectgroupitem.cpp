@@ -20,23 +20,247 @@
 
 #include "objectgroupitem.h"
 
+#include "map.h"
+#include "mapdocument.h"
+#include "mapobject.h"
+#include "mapobjectitem.h"
+#include "maprenderer.h"
+#include "mapview.h"
+#include "tileset.h"
+#include "zoomable.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include <algorithm>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
-ObjectGroupItem::ObjectGroupItem(ObjectGroup *objectGroup, QGraphicsItem *parent)
+// Object groups with at least this many objects are drawn in batched mode
+static const int BatchedObjectThreshold = 1000;
+
+ObjectGroupItem::ObjectGroupItem(ObjectGroup *objectGroup,
+                                 MapDocument *mapDocument,
+                                 QGraphicsItem *parent)
     : LayerItem(objectGroup, parent)
+    , mMapDocument(mapDocument)
+    , mBatched(mapDocument && objectGroup->objectCount() >= BatchedObjectThreshold)
+{
+    if (mBatched) {
+        setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+        syncWithObjects();
+    } else {
+        // Since we don't do any painting, we can spare us the call to paint()
+        setFlag(QGraphicsItem::ItemHasNoContents);
+    }
+}
+
+/**
+ * Sets whether the given \a object is displayed by its own MapObjectItem,
+ * in which case it is no longer painted by this item.
+ */
+void ObjectGroupItem::setHasObjectItem(MapObject *object, bool hasItem)
+{
+    if (hasItem)
+        mObjectsWithItem.insert(object);
+    else
+        mObjectsWithItem.remove(object);
+
+    if (mBatched)
+        update(objectBoundingRect(object));
+}
+
+/**
+ * Recomputes the bounding rect of the batched objects.
+ */
+void ObjectGroupItem::syncWithObjects()
+{
+    if (!mBatched)
+        return;
+
+    QRectF boundingRect;
+    for (const MapObject *object : objectGroup()->objects())
+        boundingRect |= objectBoundingRect(object);
+
+    if (mBoundingRect != boundingRect) {
+        prepareGeometryChange();
+        mBoundingRect = boundingRect;
+    }
+
+    mObjectIndexes.clear();
+    update();
+}
+
+void ObjectGroupItem::objectsChanged(const QList<MapObject*> &objects)
 {
-    // Since we don't do any painting, we can spare us the call to paint()
-    setFlag(QGraphicsItem::ItemHasNoContents);
+    if (!mBatched)
+        return;
+
+    QRectF boundingRect = mBoundingRect;
+    for (const MapObject *object : objects)
+        boundingRect |= objectBoundingRect(object);
+
+    if (mBoundingRect != boundingRect) {
+        prepareGeometryChange();
+        mBoundingRect = boundingRect;
+    }
+
+    update();
+}
+
+void ObjectGroupItem::objectsIndexChanged()
+{
+    if (!mBatched)
+        return;
+
+    mObjectIndexes.clear();
+    update();
+}
+
+/**
+ * Returns the top-most visible object at \a pos, in item coordinates.
+ */
+MapObject *ObjectGroupItem::topMostObjectAt(const QPointF &pos) const
+{
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const QList<MapObject*> objects = objectsNear(QRectF(pos, QSizeF(0, 0)));
+
+    for (int i = objects.size() - 1; i >= 0; --i) {
+        MapObject *object = objects.at(i);
+        const QPainterPath shape = objectTransform(object).map(renderer->shape(object));
+        if (shape.contains(pos))
+            return object;
+    }
+
+    return nullptr;
+}
+
+/**
+ * Returns the visible objects whose shape intersects the given \a rect, in
+ * item coordinates.
+ */
+QList<MapObject*> ObjectGroupItem::objectsIntersecting(const QRectF &rect) const
+{
+    const MapRenderer *renderer = mMapDocument->renderer();
+    QList<MapObject*> objects = objectsNear(rect);
+
+    auto missesRect = [&] (MapObject *object) {
+        const QPainterPath shape = objectTransform(object).map(renderer->shape(object));
+        return !shape.intersects(rect);
+    };
+    objects.erase(std::remove_if(objects.begin(), objects.end(), missesRect),
+                  objects.end());
+
+    return objects;
 }
 
 QRectF ObjectGroupItem::boundingRect() const
 {
-    return QRectF();
+    return mBoundingRect;
 }
 
-void ObjectGroupItem::paint(QPainter *,
-                            const QStyleOptionGraphicsItem *,
-                            QWidget *)
+void ObjectGroupItem::paint(QPainter *painter,
+                            const QStyleOptionGraphicsItem *option,
+                            QWidget *widget)
+{
+    if (!mBatched)
+        return;
+
+    MapRenderer *renderer = mMapDocument->renderer();
+    qreal scale = static_cast<MapView*>(widget->parent())->zoomable()->scale();
+    renderer->setPainterScale(scale);
+
+    for (MapObject *object : objectsNear(option->exposedRect)) {
+        if (mObjectsWithItem.contains(object))
+            continue;
+
+        painter->save();
+        painter->setTransform(objectTransform(object), true);
+        renderer->drawMapObject(painter, object, MapObjectItem::objectColor(object));
+        painter->restore();
+    }
+}
+
+/**
+ * Returns the visible objects that may be drawn within \a rect, in item
+ * coordinates, in the order in which they are drawn.
+ */
+QList<MapObject*> ObjectGroupItem::objectsNear(const QRectF &rect) const
+{
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const Map *map = mMapDocument->map();
+
+    // Look up the objects in pixel coordinates, with a margin for the parts
+    // of tile objects that are drawn outside of their bounds
+    int margin = qMax(map->tileWidth(), map->tileHeight());
+    for (const SharedTileset &tileset : map->tilesets())
+        margin = qMax(margin, qMax(tileset->tileWidth(), tileset->tileHeight()));
+
+    QPolygonF corners;
+    corners << renderer->screenToPixelCoords(rect.topLeft())
+            << renderer->screenToPixelCoords(rect.topRight())
+            << renderer->screenToPixelCoords(rect.bottomRight())
+            << renderer->screenToPixelCoords(rect.bottomLeft());
+    const QRectF pixelRect = corners.boundingRect().adjusted(-margin, -margin,
+                                                             margin, margin);
+
+    QList<MapObject*> objects;
+    for (MapObject *object : objectGroup()->objectsIntersecting(pixelRect)) {
+        if (!object->isVisible())
+            continue;
+
+        const QRectF bounds = objectBoundingRect(object);
+        if (bounds.left() <= rect.right() && rect.left() <= bounds.right() &&
+                bounds.top() <= rect.bottom() && rect.top() <= bounds.bottom()) {
+            objects.append(object);
+        }
+    }
+
+    if (mObjectIndexes.isEmpty()) {
+        const QList<MapObject*> &allObjects = objectGroup()->objects();
+        mObjectIndexes.reserve(allObjects.size());
+        for (int i = 0; i < allObjects.size(); ++i)
+            mObjectIndexes.insert(allObjects.at(i), i);
+    }
+
+    // Use the same stacking order as the MapObjectItem instances would have
+    if (objectGroup()->drawOrder() == ObjectGroup::TopDownOrder) {
+        std::sort(objects.begin(), objects.end(), [&] (MapObject *a, MapObject *b) {
+            const qreal ya = renderer->pixelToScreenCoords(a->position()).y();
+            const qreal yb = renderer->pixelToScreenCoords(b->position()).y();
+            if (ya != yb)
+                return ya < yb;
+            return mObjectIndexes.value(a) < mObjectIndexes.value(b);
+        });
+    } else {
+        std::sort(objects.begin(), objects.end(), [&] (MapObject *a, MapObject *b) {
+            return mObjectIndexes.value(a) < mObjectIndexes.value(b);
+        });
+    }
+
+    return objects;
+}
+
+QRectF ObjectGroupItem::objectBoundingRect(const MapObject *object) const
+{
+    const QRectF bounds = mMapDocument->renderer()->boundingRect(object);
+    return objectTransform(object).mapRect(bounds);
+}
+
+/**
+ * Returns the rotation of the \a object around its position, like it is
+ * applied to a MapObjectItem.
+ */
+QTransform ObjectGroupItem::objectTransform(const MapObject *object) const
 {
+    QTransform transform;
+    if (object->rotation() != 0) {
+        const MapRenderer *renderer = mMapDocument->renderer();
+        const QPointF pos = renderer->pixelToScreenCoords(object->position());
+        transform.translate(pos.x(), pos.y());
+        transform.rotate(object->rotation());
+        transform.translate(-pos.x(), -pos.y());
+    }
+    return transform;
 }
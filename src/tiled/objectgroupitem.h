@@ -24,27 +24,65 @@
 
 #include "objectgroup.h"
 
+#include <QHash>
+#include <QSet>
+
 namespace Tiled {
+
+class MapObject;
+
 namespace Internal {
 
+class MapDocument;
+
 /**
- * A graphics item representing an object group in a QGraphicsView. It only
- * serves to group together the objects belonging to the same object group.
+ * A graphics item representing an object group in a QGraphicsView. It
+ * usually only serves to group together the objects belonging to the same
+ * object group.
+ *
+ * Object groups with many objects are drawn in batched mode instead. In that
+ * case the item paints the objects itself, and a MapObjectItem is only
+ * created for objects that are selected or hovered. These objects are then
+ * left to their own item.
  *
  * @see MapObjectItem
  */
 class ObjectGroupItem : public LayerItem
 {
 public:
-    ObjectGroupItem(ObjectGroup *objectGroup, QGraphicsItem *parent = nullptr);
+    ObjectGroupItem(ObjectGroup *objectGroup,
+                    MapDocument *mapDocument = nullptr,
+                    QGraphicsItem *parent = nullptr);
 
     ObjectGroup *objectGroup() const;
 
+    bool isBatched() const { return mBatched; }
+
+    void setHasObjectItem(MapObject *object, bool hasItem);
+
+    void syncWithObjects();
+    void objectsChanged(const QList<MapObject*> &objects);
+    void objectsIndexChanged();
+
+    MapObject *topMostObjectAt(const QPointF &pos) const;
+    QList<MapObject*> objectsIntersecting(const QRectF &rect) const;
+
     // QGraphicsItem
     QRectF boundingRect() const override;
     void paint(QPainter *painter,
                const QStyleOptionGraphicsItem *option,
                QWidget *widget = nullptr) override;
+
+private:
+    QList<MapObject*> objectsNear(const QRectF &rect) const;
+    QRectF objectBoundingRect(const MapObject *object) const;
+    QTransform objectTransform(const MapObject *object) const;
+
+    MapDocument *mMapDocument;
+    bool mBatched;
+    QRectF mBoundingRect;
+    QSet<MapObject*> mObjectsWithItem;
+    mutable QHash<MapObject*, int> mObjectIndexes;
 };
 
 inline ObjectGroup *ObjectGroupItem::objectGroup() const
@@ -383,6 +383,12 @@ void ObjectSelectionTool::deactivate(MapScene *scene)
     disconnect(scene, SIGNAL(selectedObjectItemsChanged()),
                this, SLOT(updateHandles()));
 
+    setHoveredObjectItem(nullptr);
+    if (mClickedObjectItem) {
+        scene->unholdObjectItem(mClickedObjectItem);
+        mClickedObjectItem = nullptr;
+    }
+
     AbstractObjectTool::deactivate(scene);
 }
 
@@ -525,6 +531,8 @@ void ObjectSelectionTool::mousePressed(QGraphicsSceneMouseEvent *event)
 
         if (!clickedHandle) {
             mClickedObjectItem = topMostObjectItemAt(mStart);
+            if (mClickedObjectItem)
+                mapScene()->holdObjectItem(mClickedObjectItem);
         } else {
             mClickedOriginIndicator = dynamic_cast<OriginIndicator*>(clickedHandle);
             mClickedRotateHandle = dynamic_cast<RotateHandle*>(clickedHandle);
@@ -593,7 +601,10 @@ void ObjectSelectionTool::mouseReleased(QGraphicsSceneMouseEvent *event)
     }
 
     mMousePressed = false;
-    mClickedObjectItem = nullptr;
+    if (mClickedObjectItem) {
+        mapScene()->unholdObjectItem(mClickedObjectItem);
+        mClickedObjectItem = nullptr;
+    }
     mClickedOriginIndicator = nullptr;
     mClickedRotateHandle = nullptr;
     mClickedResizeHandle = nullptr;
@@ -944,7 +955,24 @@ void ObjectSelectionTool::updateHover(const QPointF &pos)
     MapObjectItem *hoveredObjectItem = nullptr;
     if (!hoveredHandle)
         hoveredObjectItem = topMostObjectItemAt(pos);
-    mHoveredObjectItem = hoveredObjectItem;
+    setHoveredObjectItem(hoveredObjectItem);
+}
+
+/**
+ * Keeps the hovered object item alive while it is hovered, since items for
+ * objects in batched object groups are otherwise released when not selected.
+ */
+void ObjectSelectionTool::setHoveredObjectItem(MapObjectItem *item)
+{
+    if (mHoveredObjectItem == item)
+        return;
+
+    if (mHoveredObjectItem)
+        mapScene()->unholdObjectItem(mHoveredObjectItem);
+    if (item)
+        mapScene()->holdObjectItem(item);
+
+    mHoveredObjectItem = item;
 }
 
 void ObjectSelectionTool::updateSelection(const QPointF &pos,
@@ -956,14 +984,7 @@ void ObjectSelectionTool::updateSelection(const QPointF &pos,
     rect.setWidth(qMax(qreal(1), rect.width()));
     rect.setHeight(qMax(qreal(1), rect.height()));
 
-    QSet<MapObjectItem*> selectedItems;
-
-    const QList<QGraphicsItem *> &items = mapScene()->items(rect);
-    for (QGraphicsItem *item : items) {
-        MapObjectItem *mapObjectItem = dynamic_cast<MapObjectItem*>(item);
-        if (mapObjectItem)
-            selectedItems.insert(mapObjectItem);
-    }
+    QSet<MapObjectItem*> selectedItems = objectItemsIn(mapScene()->items(rect), rect);
 
     if (modifiers & (Qt::ControlModifier | Qt::ShiftModifier))
         selectedItems |= mapScene()->selectedObjectItems();
@@ -81,6 +81,7 @@ private:
     };
 
     void updateHover(const QPointF &pos);
+    void setHoveredObjectItem(MapObjectItem *item);
     void updateSelection(const QPointF &pos,
                          Qt::KeyboardModifiers modifiers);
 
@@ -22,6 +22,7 @@
 #include "preferences.h"
 
 #include "documentmanager.h"
+#include "imagecache.h"
 #include "languagemanager.h"
 #include "mapdocument.h"
 #include "pluginmanager.h"
@@ -65,9 +66,11 @@ Preferences::Preferences()
     mReloadTilesetsOnChange = boolValue("ReloadTilesets", true);
     mStampsDirectory = stringValue("StampsDirectory");
     mObjectTypesFile = stringValue("ObjectTypesFile");
+    const int imageCacheSize = intValue("ImageCacheSize", 256);
     mSettings->endGroup();
 
     SaveFile::setSafeSavingEnabled(mSafeSavingEnabled);
+    ImageCache::setMemoryBudget(imageCacheSize * 1024);
 
     // Retrieve interface settings
     mSettings->beginGroup(QLatin1String("Interface"));
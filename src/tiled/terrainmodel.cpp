@@ -127,7 +127,7 @@ QVariant TerrainModel::data(const QModelIndex &index, int role) const
             return terrain->name();
         case Qt::DecorationRole:
             if (Tile *imageTile = terrain->imageTile())
-                return imageTile->image();
+                return imageTile->image().copy(imageTile->imageRect());
             break;
         case TerrainRole:
             return QVariant::fromValue(terrain);
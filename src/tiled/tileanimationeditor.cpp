@@ -92,7 +92,7 @@ QVariant FrameListModel::data(const QModelIndex &index, int role) const
     case Qt::DecorationRole: {
         int tileId = mFrames.at(index.row()).tileId;
         if (Tile *tile = mTileset->findTile(tileId))
-            return tile->image();
+            return tile->image().copy(tile->imageRect());
     }
     }
 
@@ -487,7 +487,7 @@ void TileAnimationEditor::advancePreviewAnimation(int ms)
     if (previousTileId != frame.tileId) {
         Tileset *tileset = mTile->tileset();
         if (const Tile *tile = tileset->findTile(frame.tileId))
-            mUi->preview->setPixmap(tile->image());
+            mUi->preview->setPixmap(tile->image().copy(tile->imageRect()));
     }
 }
 
@@ -500,7 +500,7 @@ void TileAnimationEditor::resetPreview()
         const int tileId = mTile->frames().first().tileId;
         Tileset *tileset = mTile->tileset();
         if (Tile *tile = tileset->findTile(tileId)) {
-            mUi->preview->setPixmap(tile->image());
+            mUi->preview->setPixmap(tile->image().copy(tile->imageRect()));
             return;
         }
     }
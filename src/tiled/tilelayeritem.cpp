@@ -25,24 +25,75 @@
 #include "mapdocument.h"
 #include "maprenderer.h"
 
-#include <QPainter>
+#include <QCache>
+#include <QPaintDevice>
 #include <QStyleOptionGraphicsItem>
+#include <QtMath>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+// The size of the cached chunks, in logical pixels
+static const int CacheChunkSize = 256;
+
+// The amount of logical pixels cached for all layers together. Multiplied by
+// the square of the device pixel ratio, so that the same area gets cached on
+// high-DPI screens.
+static const int MaxCachedPixels = 4096 * 4096;
+
+namespace {
+
+/**
+ * Identifies a cached chunk of a certain layer item.
+ */
+struct ChunkKey
+{
+    const TileLayerItem *item;
+    QPoint chunk;
+
+    bool operator==(const ChunkKey &other) const
+    { return item == other.item && chunk == other.chunk; }
+};
+
+inline uint qHash(const ChunkKey &key, uint seed = 0) Q_DECL_NOTHROW
+{
+    const uint h1 = ::qHash(key.chunk.x(), seed);
+    const uint h2 = ::qHash(key.chunk.y(), seed);
+    return ((h1 << 16) | (h1 >> 16)) ^ h2 ^ ::qHash(key.item, seed);
+}
+
+} // anonymous namespace
+
+/**
+ * The chunks cached by all tile layer items, sharing a single budget.
+ */
+static QCache<ChunkKey, QPixmap> &chunkCache()
+{
+    static QCache<ChunkKey, QPixmap> cache(MaxCachedPixels);
+    return cache;
+}
+
 TileLayerItem::TileLayerItem(TileLayer *layer, MapDocument *mapDocument, QGraphicsItem *parent)
     : LayerItem(layer, parent)
     , mMapDocument(mapDocument)
+    , mCacheScale(0)
+    , mCacheRatio(0)
 {
     setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 
     syncWithTileLayer();
 }
 
+TileLayerItem::~TileLayerItem()
+{
+    // Another item may later be allocated at the same address
+    invalidateCache();
+}
+
 void TileLayerItem::syncWithTileLayer()
 {
     prepareGeometryChange();
+    invalidateCache();
 
     MapRenderer *renderer = mMapDocument->renderer();
     QRectF boundingRect = renderer->boundingRect(tileLayer()->bounds());
@@ -64,11 +115,169 @@ QRectF TileLayerItem::boundingRect() const
     return mBoundingRect;
 }
 
+void TileLayerItem::invalidateCache(const QRectF &rect)
+{
+    // The tiles have changed, which may include animated ones
+    mAnimatedRegions.clear();
+    removeCachedChunks(rect);
+}
+
+void TileLayerItem::invalidateCache()
+{
+    mAnimatedRegions.clear();
+
+    QCache<ChunkKey, QPixmap> &cache = chunkCache();
+    for (const ChunkKey &key : cache.keys())
+        if (key.item == this)
+            cache.remove(key);
+}
+
+void TileLayerItem::invalidateAnimatedTiles(Tileset *tileset)
+{
+    auto it = mAnimatedRegions.find(tileset);
+    if (it == mAnimatedRegions.end()) {
+        const QRegion region = tileLayer()->region([tileset] (const Cell &cell) {
+            if (cell.tileset() != tileset)
+                return false;
+            const Tile *tile = cell.tile();
+            return tile && tile->isAnimated();
+        });
+        it = mAnimatedRegions.insert(tileset, region);
+    }
+
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const QMargins margins = tileLayer()->drawMargins();
+
+    for (const QRect &rect : it.value().rects()) {
+        removeCachedChunks(renderer->boundingRect(rect).adjusted(-margins.left(),
+                                                                 -margins.top(),
+                                                                 margins.right(),
+                                                                 margins.bottom()));
+    }
+}
+
+void TileLayerItem::removeCachedChunks(const QRectF &rect)
+{
+    QCache<ChunkKey, QPixmap> &cache = chunkCache();
+    if (cache.isEmpty())
+        return;
+
+    const qreal chunkSize = CacheChunkSize / mCacheScale;
+
+    // There are never many chunks in the cache, so just check each of them
+    for (const ChunkKey &key : cache.keys()) {
+        if (key.item != this)
+            continue;
+
+        const QRectF chunkRect(key.chunk.x() * chunkSize, key.chunk.y() * chunkSize,
+                               chunkSize, chunkSize);
+        if (chunkRect.intersects(rect))
+            cache.remove(key);
+    }
+}
+
 void TileLayerItem::paint(QPainter *painter,
                           const QStyleOptionGraphicsItem *option,
                           QWidget *)
 {
     MapRenderer *renderer = mMapDocument->renderer();
     // TODO: Display a border around the layer when selected
-    renderer->drawTileLayer(painter, tileLayer(), option->exposedRect);
+
+    const QTransform &transform = painter->worldTransform();
+    const QRectF exposed = option->exposedRect & mBoundingRect;
+
+    // The cache can only be used when the view is uniformly scaled
+    if (exposed.isEmpty() ||
+            transform.type() > QTransform::TxScale ||
+            transform.m11() != transform.m22()) {
+        renderer->drawTileLayer(painter, tileLayer(), option->exposedRect);
+        return;
+    }
+
+#if QT_VERSION >= 0x050600
+    const qreal ratio = painter->device()->devicePixelRatioF();
+#else
+    const qreal ratio = painter->device()->devicePixelRatio();
+#endif
+    const qreal scale = transform.m11();
+
+    // Only the current zoom level is cached
+    if (scale != mCacheScale || ratio != mCacheRatio) {
+        invalidateCache();
+        mCacheScale = scale;
+        mCacheRatio = ratio;
+    }
+
+    QCache<ChunkKey, QPixmap> &cache = chunkCache();
+    const int maxCost = qCeil(MaxCachedPixels * ratio * ratio);
+    if (cache.maxCost() < maxCost)
+        cache.setMaxCost(maxCost);
+
+    const qreal chunkSize = CacheChunkSize / scale;
+    const int startX = qFloor(exposed.left() / chunkSize);
+    const int startY = qFloor(exposed.top() / chunkSize);
+    const int endX = qCeil(exposed.right() / chunkSize);
+    const int endY = qCeil(exposed.bottom() / chunkSize);
+
+    const int chunkPixelSize = qCeil(CacheChunkSize * ratio);
+    const int chunkCost = chunkPixelSize * chunkPixelSize;
+
+    // Avoid thrashing the cache when it can't hold the exposed area
+    if ((endX - startX) * (endY - startY) * chunkCost > cache.maxCost()) {
+        renderer->drawTileLayer(painter, tileLayer(), option->exposedRect);
+        return;
+    }
+
+    // The chunks are drawn unscaled at whole device pixels, since drawing
+    // them at fractional positions leaves visible seams between them
+    const QPointF origin = transform.map(QPointF(0, 0)) * ratio;
+    const qreal chunkDeviceSize = CacheChunkSize * ratio;
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+
+    for (int y = startY; y < endY; ++y) {
+        for (int x = startX; x < endX; ++x) {
+            const ChunkKey key { this, QPoint(x, y) };
+
+            QPixmap *pixmap = cache.object(key);
+            if (!pixmap) {
+                const QRectF chunkRect(x * chunkSize, y * chunkSize,
+                                       chunkSize, chunkSize);
+                pixmap = new QPixmap(renderChunk(chunkRect, painter->renderHints()));
+                cache.insert(key, pixmap, chunkCost);
+            }
+
+            const QPointF devicePos(qRound(origin.x() + x * chunkDeviceSize),
+                                    qRound(origin.y() + y * chunkDeviceSize));
+            painter->drawPixmap(devicePos / ratio, *pixmap);
+        }
+    }
+
+    painter->restore();
+}
+
+/**
+ * Renders the given \a rect of the layer into a pixmap of the size of a cache
+ * chunk at the current zoom level.
+ */
+QPixmap TileLayerItem::renderChunk(const QRectF &rect,
+                                   QPainter::RenderHints hints) const
+{
+    const int size = qCeil(CacheChunkSize * mCacheRatio);
+
+    QPixmap pixmap(size, size);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
+    painter.setRenderHints(hints);
+    painter.scale(size / rect.width(), size / rect.height());
+    painter.translate(-rect.topLeft());
+
+    mMapDocument->renderer()->drawTileLayer(&painter, tileLayer(), rect);
+    painter.end();
+
+    pixmap.setDevicePixelRatio(mCacheRatio);
+
+    return pixmap;
 }
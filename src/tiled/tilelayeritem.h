@@ -24,6 +24,11 @@
 
 #include "tilelayer.h"
 
+#include <QHash>
+#include <QPainter>
+#include <QPixmap>
+#include <QRegion>
+
 namespace Tiled {
 namespace Internal {
 
@@ -31,6 +36,11 @@ class MapDocument;
 
 /**
  * A graphics item displaying a tile layer in a QGraphicsView.
+ *
+ * The layer is rendered into a cache of pixmap chunks at the current zoom
+ * level, so that scrolling and repainting overlays only needs to blit those
+ * chunks instead of drawing each tile again. The cache is shared by all tile
+ * layer items.
  */
 class TileLayerItem : public LayerItem
 {
@@ -42,6 +52,7 @@ public:
      * @param mapDocument the map document owning the map of this layer
      */
     TileLayerItem(TileLayer *layer, MapDocument *mapDocument, QGraphicsItem *parent = nullptr);
+    ~TileLayerItem();
 
     TileLayer *tileLayer() const;
 
@@ -55,6 +66,23 @@ public:
      */
     void syncWithTileLayer();
 
+    /**
+     * Discards the cached rendering of the given \a rect of the layer, in
+     * pixels. Should be called when the tiles in that area have changed.
+     */
+    void invalidateCache(const QRectF &rect);
+
+    /**
+     * Discards the whole cached rendering of the layer.
+     */
+    void invalidateCache();
+
+    /**
+     * Discards the cached chunks that show animated tiles from the given
+     * \a tileset, so that they get rendered again with the current frames.
+     */
+    void invalidateAnimatedTiles(Tileset *tileset);
+
     // QGraphicsItem
     QRectF boundingRect() const override;
     void paint(QPainter *painter,
@@ -62,8 +90,17 @@ public:
                QWidget *widget = nullptr) override;
 
 private:
+    void removeCachedChunks(const QRectF &rect);
+    QPixmap renderChunk(const QRectF &rect, QPainter::RenderHints hints) const;
+
     MapDocument *mMapDocument;
     QRectF mBoundingRect;
+
+    qreal mCacheScale;
+    qreal mCacheRatio;
+
+    // The cells showing animated tiles, per tileset. Determined on demand.
+    QHash<Tileset*, QRegion> mAnimatedRegions;
 };
 
 inline TileLayer *TileLayerItem::tileLayer() const
@@ -73,6 +73,14 @@ TilesetDocument::TilesetDocument(const SharedTileset &tileset, const QString &fi
     connect(mTerrainModel, &TilesetTerrainModel::terrainRemoved,
             this, &TilesetDocument::onTerrainRemoved);
 
+    // Let the maps using this tileset know when its tiles may look different
+    connect(this, &TilesetDocument::tilesetChanged,
+            this, &TilesetDocument::onTilesetChanged);
+    connect(this, &TilesetDocument::tileImageSourceChanged,
+            this, &TilesetDocument::onTileImageSourceChanged);
+    connect(this, &TilesetDocument::tileAnimationChanged,
+            this, &TilesetDocument::onTileAnimationChanged);
+
     TilesetManager *tilesetManager = TilesetManager::instance();
     tilesetManager->addReference(tileset);
 }
@@ -201,6 +209,7 @@ void TilesetDocument::swapTileset(SharedTileset &tileset)
     setCurrentObject(mTileset.data());
 
     mTileset->swap(*tileset);
+
     emit tilesetChanged(mTileset.data());
 }
 
@@ -238,8 +247,11 @@ void TilesetDocument::setTilesetTileOffset(const QPoint &tileOffset)
     mTileset->setTileOffset(tileOffset);
 
     // Invalidate the draw margins of the maps using this tileset
-    for (MapDocument *mapDocument : mapDocuments())
+    for (MapDocument *mapDocument : mapDocuments()) {
         mapDocument->map()->invalidateDrawMargins();
+        mapDocument->map()->invalidateObjectIndexes();
+        emit mapDocument->tilesetTileOffsetChanged(mTileset.data());
+    }
 
     emit tilesetTileOffsetChanged(mTileset.data());
 }
@@ -309,5 +321,32 @@ void TilesetDocument::onTerrainRemoved(Terrain *terrain)
         emit mapDocument->tilesetTerrainRemoved(mTileset.data(), terrain);
 }
 
+void TilesetDocument::onTilesetChanged(Tileset *tileset)
+{
+    // The tile size and tile offset may have changed, for example when tiles
+    // were added to or removed from an image collection
+    for (MapDocument *mapDocument : mapDocuments()) {
+        mapDocument->map()->invalidateDrawMargins();
+        mapDocument->map()->invalidateObjectIndexes();
+        emit mapDocument->tilesetChanged(tileset);
+    }
+}
+
+void TilesetDocument::onTileImageSourceChanged(Tile *tile)
+{
+    // A new image may change the tile size of an image collection
+    for (MapDocument *mapDocument : mapDocuments()) {
+        mapDocument->map()->invalidateDrawMargins();
+        mapDocument->map()->invalidateObjectIndexes();
+        emit mapDocument->tileImageSourceChanged(tile);
+    }
+}
+
+void TilesetDocument::onTileAnimationChanged(Tile *tile)
+{
+    for (MapDocument *mapDocument : mapDocuments())
+        emit mapDocument->tileAnimationChanged(tile);
+}
+
 } // namespace Internal
 } // namespace Tiled
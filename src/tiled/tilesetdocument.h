@@ -136,6 +136,10 @@ private slots:
     void onTerrainAboutToBeRemoved(Terrain *terrain);
     void onTerrainRemoved(Terrain *terrain);
 
+    void onTilesetChanged(Tileset *tileset);
+    void onTileImageSourceChanged(Tile *tile);
+    void onTileAnimationChanged(Tile *tile);
+
 private:
     SharedTileset mTileset;
     QList<MapDocument*> mMapDocuments;
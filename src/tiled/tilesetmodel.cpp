@@ -71,7 +71,7 @@ QVariant TilesetModel::data(const QModelIndex &index, int role) const
 {
     if (role == Qt::DecorationRole) {
         if (Tile *tile = tileAt(index))
-            return tile->image();
+            return tile->image().copy(tile->imageRect());
     } else if (role == TerrainRole) {
         if (Tile *tile = tileAt(index))
             return tile->terrain();
@@ -70,7 +70,7 @@ QVariant TilesetTerrainModel::data(const QModelIndex &index, int role) const
             return terrain->name();
         case Qt::DecorationRole:
             if (Tile *imageTile = terrain->imageTile())
-                return imageTile->image();
+                return imageTile->image().copy(imageTile->imageRect());
             break;
         case TerrainRole:
             return QVariant::fromValue(terrain);
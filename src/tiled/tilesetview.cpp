@@ -253,7 +253,7 @@ void TileDelegate::paint(QPainter *painter,
     const int extra = mTilesetView->drawGrid() ? 1 : 0;
     const qreal zoom = mTilesetView->scale();
 
-    QSize tileSize = tileImage.size();
+    QSize tileSize = tile->size();
     if (tileImage.isNull()) {
         Tileset *tileset = model->tileset();
         if (tileset->isCollection()) {
@@ -277,7 +277,7 @@ void TileDelegate::paint(QPainter *painter,
             painter->setRenderHint(QPainter::SmoothPixmapTransform);
 
     if (!tileImage.isNull())
-        painter->drawPixmap(targetRect, tileImage);
+        painter->drawPixmap(targetRect, tileImage, tile->imageRect());
     else
         mTilesetView->imageMissingIcon().paint(painter, targetRect, Qt::AlignBottom | Qt::AlignLeft);
 
@@ -286,8 +286,8 @@ void TileDelegate::paint(QPainter *painter,
     if (mTilesetView->markAnimatedTiles() && tile->isAnimated()) {
         painter->save();
 
-        qreal scale = qMin(tileImage.width() / 32.0,
-                           tileImage.height() / 32.0);
+        qreal scale = qMin(tile->width() / 32.0,
+                           tile->height() / 32.0);
 
         painter->setClipRect(targetRect);
         painter->translate(targetRect.right(),
@@ -368,10 +368,10 @@ QSize TileDelegate::sizeHint(const QStyleOptionViewItem & /* option */,
     const int extra = mTilesetView->drawGrid() ? 1 : 0;
 
     if (const Tile *tile = m->tileAt(index)) {
-        const QPixmap &image = tile->image();
-        QSize tileSize = image.size();
+        // Avoid loading deferred images, their size is already known
+        QSize tileSize = tile->size();
 
-        if (image.isNull()) {
+        if (!tile->imageLoaded()) {
             Tileset *tileset = m->tileset();
             if (tileset->isCollection()) {
                 tileSize = QSize(32, 32);
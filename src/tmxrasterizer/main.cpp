@@ -42,6 +42,7 @@ struct CommandLineOptions {
         , scale(1.0)
         , tileSize(0)
         , size(0)
+        , splitSize(0)
         , useAntiAliasing(false)
         , smoothImages(true)
         , ignoreVisibility(false)
@@ -54,6 +55,7 @@ struct CommandLineOptions {
     qreal scale;
     int tileSize;
     int size;
+    int splitSize;
     bool useAntiAliasing;
     bool smoothImages;
     bool ignoreVisibility;
@@ -77,6 +79,8 @@ static void showHelp()
             "                            Overrides the --scale option\n"
             "     --size SIZE          : The output image fits within a SIZE x SIZE square\n"
             "                            Overrides the --scale and --tilesize options\n"
+            "     --split SIZE         : Split the output into images of SIZE x SIZE pixels, rendered\n"
+            "                            in parallel. Their column and row are appended to the file name\n"
             "  -a --anti-aliasing      : Antialias edges of primitives\n"
             "     --no-smoothing       : Use nearest neighbour instead of smooth blending of pixels\n"
             "     --ignore-visibility  : Ignore all layer visibility flags in the map file, and render all\n"
@@ -140,6 +144,18 @@ static void parseCommandLineArguments(CommandLineOptions &options)
                     options.showHelp = true;
                 }
             }
+        } else if (arg == QLatin1String("--split")) {
+            i++;
+            if (i >= arguments.size()) {
+                options.showHelp = true;
+            } else {
+                bool splitSizeIsInt;
+                options.splitSize = arguments.at(i).toInt(&splitSizeIsInt);
+                if (!splitSizeIsInt || options.splitSize <= 0) {
+                    qWarning() << arguments.at(i) << ": the specified split size is not a positive integer.";
+                    options.showHelp = true;
+                }
+            }
         } else if (arg == QLatin1String("--hide-layer")) {
             i++;
             if (i >= arguments.size()) {
@@ -203,6 +219,7 @@ int main(int argc, char *argv[])
     w.setSmoothImages(options.smoothImages);
     w.setIgnoreVisibility(options.ignoreVisibility);
     w.setLayersToHide(options.layersToHide);
+    w.setOutputTileSize(options.splitSize);
 
     if (options.size > 0) {
         w.setSize(options.size);
@@ -38,8 +38,13 @@
 #include "staggeredrenderer.h"
 #include "tilelayer.h"
 
+#include <QAtomicInt>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 #include <QImageWriter>
+#include <QRunnable>
+#include <QThreadPool>
 
 using namespace Tiled;
 
@@ -49,7 +54,10 @@ TmxRasterizer::TmxRasterizer():
     mSize(0),
     mUseAntiAliasing(false),
     mSmoothImages(true),
-    mIgnoreVisibility(false)
+    mIgnoreVisibility(false),
+    mOutputTileSize(0),
+    mXScale(1.0),
+    mYScale(1.0)
 {
 }
 
@@ -57,7 +65,7 @@ TmxRasterizer::~TmxRasterizer()
 {
 }
 
-bool TmxRasterizer::shouldDrawLayer(const Layer *layer)
+bool TmxRasterizer::shouldDrawLayer(const Layer *layer) const
 {
     if (layer->isObjectGroup() || layer->isGroupLayer())
         return false;
@@ -71,11 +79,31 @@ bool TmxRasterizer::shouldDrawLayer(const Layer *layer)
     return !layer->isHidden();
 }
 
+static bool saveImage(const QImage &image, const QString &imageFileName)
+{
+    QImageWriter imageWriter(imageFileName);
+
+    if (!imageWriter.canWrite())
+        imageWriter.setFormat("png");
+
+    if (!imageWriter.write(image)) {
+        qWarning("Error while writing \"%s\": %s",
+                 qUtf8Printable(imageFileName),
+                 qUtf8Printable(imageWriter.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
 int TmxRasterizer::render(const QString &mapFileName,
                           const QString &imageFileName)
 {
     Map *map;
     MapRenderer *renderer;
+    // Tiles may be rendered in parallel, which can't load deferred images
+    MapReader::setDeferTileImages(false);
+
     MapReader reader;
     map = reader.readMap(mapFileName);
     if (!map) {
@@ -102,35 +130,57 @@ int TmxRasterizer::render(const QString &mapFileName,
     }
 
     QSize mapSize = renderer->mapSize();
-    qreal xScale, yScale;
 
     if (mSize > 0) {
-        xScale = (qreal) mSize / mapSize.width();
-        yScale = (qreal) mSize / mapSize.height();
-        xScale = yScale = qMin(1.0, qMin(xScale, yScale));
+        mXScale = (qreal) mSize / mapSize.width();
+        mYScale = (qreal) mSize / mapSize.height();
+        mXScale = mYScale = qMin(1.0, qMin(mXScale, mYScale));
     } else if (mTileSize > 0) {
-        xScale = (qreal) mTileSize / map->tileWidth();
-        yScale = (qreal) mTileSize / map->tileHeight();
+        mXScale = (qreal) mTileSize / map->tileWidth();
+        mYScale = (qreal) mTileSize / map->tileHeight();
     } else {
-        xScale = yScale = mScale;
+        mXScale = mYScale = mScale;
     }
 
-    QMargins margins = map->computeLayerOffsetMargins();
-    mapSize.setWidth(mapSize.width() + margins.left() + margins.right());
-    mapSize.setHeight(mapSize.height() + margins.top() + margins.bottom());
+    mMargins = map->computeLayerOffsetMargins();
+    mapSize.setWidth(mapSize.width() + mMargins.left() + mMargins.right());
+    mapSize.setHeight(mapSize.height() + mMargins.top() + mMargins.bottom());
+
+    mapSize.rwidth() *= mXScale;
+    mapSize.rheight() *= mYScale;
 
-    mapSize.rwidth() *= xScale;
-    mapSize.rheight() *= yScale;
+    int result;
+
+    if (mOutputTileSize > 0) {
+        result = renderTiles(map, renderer, mapSize, imageFileName);
+    } else {
+        const QImage image = renderImage(map, renderer, QRect(QPoint(), mapSize));
+        result = saveImage(image, imageFileName) ? 0 : 1;
+    }
 
-    QImage image(mapSize, QImage::Format_ARGB32);
+    delete renderer;
+    delete map;
+
+    return result;
+}
+
+/**
+ * Renders the part of the map covered by \a rect, given in pixels of the
+ * output image.
+ */
+QImage TmxRasterizer::renderImage(const Map *map, MapRenderer *renderer,
+                                  const QRect &rect) const
+{
+    QImage image(rect.size(), QImage::Format_ARGB32);
     image.fill(Qt::transparent);
     QPainter painter(&image);
 
     painter.setRenderHint(QPainter::Antialiasing, mUseAntiAliasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, mSmoothImages);
-    painter.setTransform(QTransform::fromScale(xScale, yScale));
+    painter.translate(-rect.topLeft());
+    painter.scale(mXScale, mYScale);
 
-    painter.translate(margins.left(), margins.top());
+    painter.translate(mMargins.left(), mMargins.top());
 
     // Perform a similar rendering than found in exportasimagedialog.cpp
     LayerIterator iterator(map);
@@ -143,33 +193,95 @@ int TmxRasterizer::render(const QString &mapFileName,
         painter.setOpacity(layer->affectiveOpacity());
         painter.translate(offset);
 
+        // Only draw the part of the layer that ends up in this image
+        const QRectF exposed = painter.transform().inverted().mapRect(QRectF(image.rect()));
+
         const TileLayer *tileLayer = dynamic_cast<const TileLayer*>(layer);
         const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
 
         if (tileLayer) {
-            renderer->drawTileLayer(&painter, tileLayer);
+            renderer->drawTileLayer(&painter, tileLayer, exposed);
         } else if (imageLayer) {
-            renderer->drawImageLayer(&painter, imageLayer);
+            renderer->drawImageLayer(&painter, imageLayer, exposed);
         }
 
         painter.translate(-offset);
     }
 
-    delete renderer;
-    delete map;
+    return image;
+}
 
-    // Save image
-    QImageWriter imageWriter(imageFileName);
+/**
+ * Renders a single tile of the output image and saves it.
+ */
+class TmxRasterizer::RenderTileTask : public QRunnable
+{
+public:
+    RenderTileTask(const TmxRasterizer *rasterizer,
+                   const Map *map,
+                   MapRenderer *renderer,
+                   const QRect &rect,
+                   const QString &imageFileName,
+                   QAtomicInt &failures)
+        : mRasterizer(rasterizer)
+        , mMap(map)
+        , mRenderer(renderer)
+        , mRect(rect)
+        , mImageFileName(imageFileName)
+        , mFailures(failures)
+    {}
 
-    if (!imageWriter.canWrite())
-        imageWriter.setFormat("png");
+    void run() override
+    {
+        const QImage image = mRasterizer->renderImage(mMap, mRenderer, mRect);
+        if (!saveImage(image, mImageFileName))
+            mFailures.fetchAndAddRelaxed(1);
+    }
 
-    if (!imageWriter.write(image)) {
-        qWarning("Error while writing \"%s\": %s",
-                 qUtf8Printable(imageFileName),
-                 qUtf8Printable(imageWriter.errorString()));
-        return 1;
+private:
+    const TmxRasterizer *mRasterizer;
+    const Map *mMap;
+    MapRenderer *mRenderer;
+    const QRect mRect;
+    const QString mImageFileName;
+    QAtomicInt &mFailures;
+};
+
+/**
+ * Renders the output image as a grid of images of at most mOutputTileSize
+ * pixels square. The tiles are rendered in parallel, each into its own image,
+ * which limits the memory use for huge maps to about one tile per thread.
+ *
+ * The column and row of each tile are appended to the base name of
+ * \a imageFileName, for example "map_0_1.png".
+ */
+int TmxRasterizer::renderTiles(const Map *map, MapRenderer *renderer,
+                               const QSize &imageSize,
+                               const QString &imageFileName) const
+{
+    const QFileInfo fileInfo(imageFileName);
+    const QString baseName = fileInfo.dir().filePath(fileInfo.completeBaseName());
+    QString suffix = fileInfo.suffix();
+    if (suffix.isEmpty())
+        suffix = QLatin1String("png");
+
+    const QRect imageRect(QPoint(), imageSize);
+
+    QAtomicInt failures;
+    QThreadPool threadPool;
+
+    for (int y = 0, row = 0; y < imageSize.height(); y += mOutputTileSize, ++row) {
+        for (int x = 0, column = 0; x < imageSize.width(); x += mOutputTileSize, ++column) {
+            const QRect rect = QRect(x, y, mOutputTileSize, mOutputTileSize) & imageRect;
+            const QString fileName = QString(QLatin1String("%1_%2_%3.%4"))
+                    .arg(baseName).arg(column).arg(row).arg(suffix);
+
+            threadPool.start(new RenderTileTask(this, map, renderer, rect,
+                                                fileName, failures));
+        }
     }
 
-    return 0;
+    threadPool.waitForDone();
+
+    return failures.load() > 0 ? 1 : 0;
 }
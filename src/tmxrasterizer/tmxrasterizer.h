@@ -30,9 +30,15 @@
 
 #include "layer.h"
 
+#include <QImage>
+#include <QMargins>
 #include <QString>
 #include <QStringList>
 
+namespace Tiled {
+class MapRenderer;
+}
+
 using namespace Tiled;
 
 class TmxRasterizer
@@ -47,6 +53,7 @@ public:
     bool useAntiAliasing() const { return mUseAntiAliasing; }
     bool smoothImages() const { return mSmoothImages; }
     bool IgnoreVisibility() const { return mIgnoreVisibility; }
+    int outputTileSize() const { return mOutputTileSize; }
 
     void setScale(qreal scale) { mScale = scale; }
     void setTileSize(int tileSize) { mTileSize = tileSize; }
@@ -54,6 +61,7 @@ public:
     void setAntiAliasing(bool useAntiAliasing) { mUseAntiAliasing = useAntiAliasing; }
     void setSmoothImages(bool smoothImages) { mSmoothImages = smoothImages; }
     void setIgnoreVisibility(bool IgnoreVisibility) { mIgnoreVisibility = IgnoreVisibility; }
+    void setOutputTileSize(int outputTileSize) { mOutputTileSize = outputTileSize; }
 
     void setLayersToHide(QStringList layersToHide) { mLayersToHide = layersToHide; }
 
@@ -66,8 +74,20 @@ private:
     bool mUseAntiAliasing;
     bool mSmoothImages;
     bool mIgnoreVisibility;
+    int mOutputTileSize;
     QStringList mLayersToHide;
 
-    bool shouldDrawLayer(const Layer *layer);
+    qreal mXScale;
+    qreal mYScale;
+    QMargins mMargins;
+
+    class RenderTileTask;
+
+    QImage renderImage(const Map *map, MapRenderer *renderer,
+                       const QRect &rect) const;
+    int renderTiles(const Map *map, MapRenderer *renderer,
+                    const QSize &imageSize, const QString &imageFileName) const;
+
+    bool shouldDrawLayer(const Layer *layer) const;
 
 };
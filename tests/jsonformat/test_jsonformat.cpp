@@ -0,0 +1,263 @@
+#include "json.h"
+#include "map.h"
+#include "maptovariantconverter.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "varianttomapconverter.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_JsonFormat : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void escapedStrings_data();
+    void escapedStrings();
+
+    void compactArray();
+
+    void compactArrayFallback_data();
+    void compactArrayFallback();
+
+    void mapRoundTrip_data();
+    void mapRoundTrip();
+
+    void invalidTile();
+};
+
+/**
+ * Writes the given \a variant to \a json the way the JSON plugin writes
+ * files, streaming through a QTextStream.
+ */
+static bool stringify(const QVariant &variant, QString &json)
+{
+    QTextStream out(&json);
+    JsonWriter writer;
+    writer.setAutoFormatting(true);
+    const bool ok = writer.stringify(variant, out);
+    out.flush();
+    return ok;
+}
+
+void test_JsonFormat::escapedStrings_data()
+{
+    QTest::addColumn<QString>("string");
+
+    QTest::newRow("quotes") << QString::fromLatin1("say \"hello\"");
+    QTest::newRow("backslashes") << QString::fromLatin1("C:\\maps\\level.tmx");
+    QTest::newRow("slashes") << QString::fromLatin1("../tilesets/tiles.tsx");
+    QTest::newRow("whitespace") << QString::fromLatin1("line\nbreak\ttab\rreturn\bback\fform");
+    QTest::newRow("control characters") << QString::fromLatin1("\x01 and \x1f");
+    QTest::newRow("non-ascii") << QString::fromUtf8("Gr\xc3\xbc\xc3\x9f \xe2\x98\x83");
+    QTest::newRow("surrogate pair") << QString::fromUtf8("\xf0\x9f\x97\xba");
+}
+
+void test_JsonFormat::escapedStrings()
+{
+    QFETCH(QString, string);
+
+    QVariantMap variant;
+    variant[QLatin1String("name")] = string;
+
+    QString json;
+    QVERIFY(stringify(variant, json));
+
+    // Streaming produces the same output as building the whole string
+    JsonWriter writer;
+    writer.setAutoFormatting(true);
+    QVERIFY(writer.stringify(variant));
+    QCOMPARE(writer.result(), json);
+
+    // The output is valid JSON
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(json.toUtf8(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(document.object().value(QLatin1String("name")).toString(), string);
+
+    JsonReader reader;
+    QVERIFY(reader.parse(json));
+    QCOMPARE(reader.result().toMap().value(QLatin1String("name")).toString(), string);
+}
+
+void test_JsonFormat::compactArray()
+{
+    const QVector<unsigned> gids { 0, 1, 42, 0x80000001, 0xFFFFFFFF };
+
+    QVariantMap variant;
+    variant[QLatin1String("data")] = QVariant::fromValue(gids);
+    variant[QLatin1String("other")] = QVariantList { 1, 2 };
+
+    QString json;
+    QVERIFY(stringify(variant, json));
+
+    const QJsonDocument document = QJsonDocument::fromJson(json.toUtf8());
+    QCOMPARE(document.object().value(QLatin1String("data")).toArray().size(), gids.size());
+
+    JsonReader reader;
+    reader.setCompactArrayKey(QLatin1String("data"));
+    QVERIFY(reader.parse(json));
+
+    const QVariantMap result = reader.result().toMap();
+    const QVariant data = result.value(QLatin1String("data"));
+    QCOMPARE(data.userType(), qMetaTypeId<QVector<unsigned>>());
+    QCOMPARE(data.value<QVector<unsigned>>(), gids);
+
+    // Arrays under other keys are read as usual
+    QCOMPARE(result.value(QLatin1String("other")).type(), QVariant::List);
+}
+
+void test_JsonFormat::compactArrayFallback_data()
+{
+    QTest::addColumn<QString>("json");
+
+    QTest::newRow("negative") << QString::fromLatin1("{\"data\": [1, -2, 3]}");
+    QTest::newRow("fraction") << QString::fromLatin1("{\"data\": [1, 2.5, 3]}");
+    QTest::newRow("string") << QString::fromLatin1("{\"data\": [1, \"a\\\"b\"]}");
+    QTest::newRow("too large") << QString::fromLatin1("{\"data\": [1, 4294967296]}");
+}
+
+void test_JsonFormat::compactArrayFallback()
+{
+    QFETCH(QString, json);
+
+    JsonReader reader;
+    reader.setCompactArrayKey(QLatin1String("data"));
+    QVERIFY(reader.parse(json));
+
+    const QVariant data = reader.result().toMap().value(QLatin1String("data"));
+    QCOMPARE(data.type(), QVariant::List);
+
+    const QJsonArray expected = QJsonDocument::fromJson(json.toUtf8())
+            .object().value(QLatin1String("data")).toArray();
+    QCOMPARE(QJsonArray::fromVariantList(data.toList()), expected);
+}
+
+void test_JsonFormat::mapRoundTrip_data()
+{
+    QTest::addColumn<bool>("compact");
+
+    QTest::newRow("variant list") << false;
+    QTest::newRow("compact") << true;
+}
+
+void test_JsonFormat::mapRoundTrip()
+{
+    QFETCH(bool, compact);
+
+    const QString escaped = QString::fromUtf8("\"quoted\" \\ \n \x01 \xe2\x98\x83");
+
+    Map map(Map::Orthogonal, 5, 4, 32, 32);
+    map.setLayerDataFormat(Map::CSV);
+    map.setProperty(QLatin1String("escaped"), escaped);
+
+    SharedTileset tileset = Tileset::create(QLatin1String("tiles"), 32, 32);
+    map.addTileset(tileset);
+
+    TileLayer *tileLayer = new TileLayer(QLatin1String("layer"), 0, 0, 5, 4);
+    map.addLayer(tileLayer);
+
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            if ((x + y) % 3 == 0)
+                continue;
+
+            Cell cell;
+            cell.setTile(tileset.data(), x + y * 5);
+            cell.setFlippedHorizontally(x % 2);
+            cell.setFlippedVertically(y % 2);
+            cell.setFlippedAntiDiagonally(x == y);
+            tileLayer->setCell(x, y, cell);
+        }
+    }
+
+    // An ID that doesn't fit the packed cells of a tile layer
+    Cell large;
+    large.setTile(tileset.data(), 1 << 24);
+    tileLayer->setCell(4, 3, large);
+
+    MapToVariantConverter toVariant;
+    toVariant.setCompactTileLayerData(compact);
+
+    QString json;
+    QVERIFY(stringify(toVariant.toVariant(map, QDir()), json));
+
+    JsonReader reader;
+    reader.setCompactArrayKey(QLatin1String("data"));
+    QVERIFY2(reader.parse(json), qPrintable(reader.errorString()));
+
+    VariantToMapConverter toMap;
+    QScopedPointer<Map> readMap(toMap.toMap(reader.result(), QDir()));
+    QVERIFY2(readMap, qPrintable(toMap.errorString()));
+
+    QCOMPARE(readMap->property(QLatin1String("escaped")).toString(), escaped);
+    QCOMPARE(readMap->tilesetCount(), 1);
+    QCOMPARE(readMap->layerCount(), 1);
+
+    Tileset *readTileset = readMap->tilesetAt(0).data();
+    const TileLayer *readLayer = readMap->layerAt(0)->asTileLayer();
+    QVERIFY(readLayer);
+    QCOMPARE(readLayer->size(), tileLayer->size());
+
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            const Cell expected = tileLayer->cellAt(x, y);
+            const Cell cell = readLayer->cellAt(x, y);
+
+            QCOMPARE(cell.isEmpty(), expected.isEmpty());
+            if (expected.isEmpty())
+                continue;
+
+            QCOMPARE(cell.tileset(), readTileset);
+            QCOMPARE(cell.tileId(), expected.tileId());
+            QCOMPARE(cell.flippedHorizontally(), expected.flippedHorizontally());
+            QCOMPARE(cell.flippedVertically(), expected.flippedVertically());
+            QCOMPARE(cell.flippedAntiDiagonally(), expected.flippedAntiDiagonally());
+        }
+    }
+}
+
+void test_JsonFormat::invalidTile()
+{
+    Map map(Map::Orthogonal, 2, 1, 32, 32);
+    map.setLayerDataFormat(Map::CSV);
+
+    SharedTileset tileset = Tileset::create(QLatin1String("tiles"), 32, 32);
+    map.addTileset(tileset);
+
+    TileLayer *tileLayer = new TileLayer(QLatin1String("layer"), 0, 0, 2, 1);
+    map.addLayer(tileLayer);
+
+    QVariantMap mapVariant = MapToVariantConverter().toVariant(map, QDir()).toMap();
+
+    // Let the tileset start at GID 10, so that GID 5 has no tile
+    QVariantList tilesets = mapVariant[QLatin1String("tilesets")].toList();
+    QVariantMap tilesetVariant = tilesets.first().toMap();
+    tilesetVariant[QLatin1String("firstgid")] = 10;
+    tilesets[0] = tilesetVariant;
+    mapVariant[QLatin1String("tilesets")] = tilesets;
+
+    QVariantList layers = mapVariant[QLatin1String("layers")].toList();
+    QVariantMap layer = layers.first().toMap();
+    layer[QLatin1String("data")] = QVariantList { 5, 10 };
+    layers[0] = layer;
+    mapVariant[QLatin1String("layers")] = layers;
+
+    // Invalid tiles are left empty rather than failing the load
+    VariantToMapConverter toMap;
+    QScopedPointer<Map> readMap(toMap.toMap(mapVariant, QDir()));
+    QVERIFY2(readMap, qPrintable(toMap.errorString()));
+
+    const TileLayer *readLayer = readMap->layerAt(0)->asTileLayer();
+    QVERIFY(readLayer->cellAt(0, 0).isEmpty());
+    QCOMPARE(readLayer->cellAt(1, 0).tileset(), readMap->tilesetAt(0).data());
+    QCOMPARE(readLayer->cellAt(1, 0).tileId(), 0);
+}
+
+QTEST_MAIN(test_JsonFormat)
+#include "test_jsonformat.moc"
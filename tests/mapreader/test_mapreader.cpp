@@ -2,8 +2,10 @@
 #include "mapobject.h"
 #include "objectgroup.h"
 #include "tilelayer.h"
+#include "tileset.h"
 #include "mapreader.h"
 
+#include <QtEndian>
 #include <QtTest/QtTest>
 
 using namespace Tiled;
@@ -14,8 +16,49 @@ class test_MapReader : public QObject
 
 private slots:
     void loadMap();
+
+    void decodeLayerData_data();
+    void decodeLayerData();
+
+    void layerDataErrors_data();
+    void layerDataErrors();
 };
 
+static QByteArray mapWithLayerData(const QByteArray &encoding,
+                                   const QByteArray &data,
+                                   int firstGid = 1)
+{
+    QByteArray tileset;
+    if (firstGid > 0) {
+        tileset = "<tileset firstgid=\"" + QByteArray::number(firstGid) +
+                "\" name=\"Tiles\" tilewidth=\"32\" tileheight=\"32\"/>";
+    }
+
+    return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+           "<map version=\"1.0\" orientation=\"orthogonal\" width=\"2\" height=\"2\""
+           " tilewidth=\"32\" tileheight=\"32\">" + tileset +
+           "<layer name=\"Layer\" width=\"2\" height=\"2\">"
+           "<data encoding=\"" + encoding + "\">" + data + "</data>"
+           "</layer>"
+           "</map>";
+}
+
+static QByteArray toBase64(const QVector<quint32> &gids)
+{
+    QByteArray data(gids.size() * 4, Qt::Uninitialized);
+    for (int i = 0; i < gids.size(); ++i)
+        qToLittleEndian(gids.at(i), reinterpret_cast<uchar*>(data.data() + i * 4));
+    return data.toBase64();
+}
+
+static Map *readMapData(MapReader &reader, const QByteArray &mapData)
+{
+    QBuffer buffer;
+    buffer.setData(mapData);
+    buffer.open(QIODevice::ReadOnly);
+    return reader.readMap(&buffer);
+}
+
 void test_MapReader::loadMap()
 {
     MapReader reader;
@@ -53,5 +96,109 @@ void test_MapReader::loadMap()
     QCOMPARE(mapObject->height(), qreal(64));
 }
 
+void test_MapReader::decodeLayerData_data()
+{
+    QTest::addColumn<QByteArray>("encoding");
+    QTest::addColumn<QByteArray>("data");
+
+    // Flip flags, an empty cell and tile IDs that don't fit the packed cells
+    const quint32 flippedAll = 0xE0000000;
+    const QVector<quint32> gids {
+        1 | flippedAll,
+        0,
+        (1 << 20) + 1,
+        ((1 << 24) + 1) | 0x80000000,
+    };
+
+    QByteArray csv;
+    for (quint32 gid : gids)
+        csv += QByteArray::number(gid) + ",\n";
+    csv.chop(2);
+
+    QTest::newRow("csv") << QByteArray("csv") << csv;
+    QTest::newRow("base64") << QByteArray("base64") << toBase64(gids);
+}
+
+void test_MapReader::decodeLayerData()
+{
+    QFETCH(QByteArray, encoding);
+    QFETCH(QByteArray, data);
+
+    MapReader reader;
+    QScopedPointer<Map> map(readMapData(reader, mapWithLayerData(encoding, data)));
+
+    QVERIFY2(map, qPrintable(reader.errorString()));
+
+    const TileLayer *tileLayer = map->layerAt(0)->asTileLayer();
+    Tileset *tileset = map->tilesets().first().data();
+
+    QVERIFY(tileLayer);
+
+    Cell flipped;
+    flipped.setTile(tileset, 0);
+    flipped.setFlippedHorizontally(true);
+    flipped.setFlippedVertically(true);
+    flipped.setFlippedAntiDiagonally(true);
+    QCOMPARE(tileLayer->cellAt(0, 0), flipped);
+
+    QVERIFY(tileLayer->cellAt(1, 0).isEmpty());
+
+    Cell largeId;
+    largeId.setTile(tileset, 1 << 20);
+    QCOMPARE(tileLayer->cellAt(0, 1), largeId);
+
+    Cell largerId;
+    largerId.setTile(tileset, 1 << 24);
+    largerId.setFlippedHorizontally(true);
+    QCOMPARE(tileLayer->cellAt(1, 1), largerId);
+}
+
+void test_MapReader::layerDataErrors_data()
+{
+    QTest::addColumn<QByteArray>("mapData");
+    QTest::addColumn<QString>("error");
+
+    const QString corrupt = QLatin1String("Corrupt layer data for layer 'Layer'");
+
+    QTest::newRow("csv too few")
+            << mapWithLayerData("csv", "1,2,3") << corrupt;
+    QTest::newRow("csv too many")
+            << mapWithLayerData("csv", "1,2,3,4,5") << corrupt;
+    QTest::newRow("csv trailing comma")
+            << mapWithLayerData("csv", "1,2,3,4,") << corrupt;
+    QTest::newRow("csv not a number")
+            << mapWithLayerData("csv", "1,x,3,4")
+            << QString(QLatin1String("Unable to parse tile at (2,1) on layer 'Layer'"));
+    QTest::newRow("csv gid out of range")
+            << mapWithLayerData("csv", "1,2,3,4294967296")
+            << QString(QLatin1String("Unable to parse tile at (2,2) on layer 'Layer'"));
+    QTest::newRow("csv gid before first tileset")
+            << mapWithLayerData("csv", "0,0,6,3", 5)
+            << QString(QLatin1String("Invalid tile: 3"));
+    QTest::newRow("csv without tilesets")
+            << mapWithLayerData("csv", "0,0,0,1", 0)
+            << QString(QLatin1String("Tile used but no tilesets specified"));
+    QTest::newRow("base64 too few")
+            << mapWithLayerData("base64", toBase64({ 1, 2, 3 })) << corrupt;
+    QTest::newRow("base64 too many")
+            << mapWithLayerData("base64", toBase64({ 1, 2, 3, 4, 5 })) << corrupt;
+    QTest::newRow("base64 gid before first tileset")
+            << mapWithLayerData("base64", toBase64({ 0, 2, 6, 7 }), 5)
+            << QString(QLatin1String("Invalid tile: 2"));
+}
+
+void test_MapReader::layerDataErrors()
+{
+    QFETCH(QByteArray, mapData);
+    QFETCH(QString, error);
+
+    MapReader reader;
+    QScopedPointer<Map> map(readMapData(reader, mapData));
+
+    QVERIFY(!map);
+    QVERIFY2(reader.errorString().contains(error),
+             qPrintable(reader.errorString()));
+}
+
 QTEST_MAIN(test_MapReader)
 #include "test_mapreader.moc"
@@ -0,0 +1,160 @@
+#include "mapobject.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_ObjectGroup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void objectsIntersecting_data();
+    void objectsIntersecting();
+
+    void objectsIntersectingAfterChanges();
+    void tileSizeChange();
+
+private:
+    QList<MapObject*> expectedObjects(const QRectF &rect) const;
+    void compareWithAllObjects();
+
+    ObjectGroup *mObjectGroup;
+};
+
+void test_ObjectGroup::init()
+{
+    mObjectGroup = new ObjectGroup;
+
+    // Small objects spread over many buckets, overlapping ones, points and
+    // objects too large to be put in buckets
+    for (int i = 0; i < 200; ++i) {
+        const QPointF pos((i * 97) % 3000, (i * 53) % 2000);
+        const QSizeF size((i % 5) * 40, (i % 7) * 30);
+        mObjectGroup->addObject(new MapObject(QString::number(i), QString(),
+                                              pos, size));
+    }
+
+    mObjectGroup->addObject(new MapObject(QLatin1String("huge"), QString(),
+                                          QPointF(-100, -100),
+                                          QSizeF(5000, 5000)));
+    mObjectGroup->insertObject(0, new MapObject(QLatin1String("wide"), QString(),
+                                                QPointF(0, 1000),
+                                                QSizeF(20000, 10)));
+}
+
+void test_ObjectGroup::cleanup()
+{
+    delete mObjectGroup;
+    mObjectGroup = nullptr;
+}
+
+/**
+ * Returns the objects intersecting \a rect, checking each object in order.
+ */
+QList<MapObject*> test_ObjectGroup::expectedObjects(const QRectF &rect) const
+{
+    const QRectF r = rect.normalized();
+
+    QList<MapObject*> objects;
+    for (MapObject *object : mObjectGroup->objects()) {
+        const QRectF bounds = object->bounds();
+        if (bounds.left() <= r.right() && r.left() <= bounds.right() &&
+                bounds.top() <= r.bottom() && r.top() <= bounds.bottom()) {
+            objects.append(object);
+        }
+    }
+    return objects;
+}
+
+void test_ObjectGroup::compareWithAllObjects()
+{
+    for (int y = -300; y < 2300; y += 170) {
+        for (int x = -300; x < 3300; x += 230) {
+            const QRectF rect(x, y, 300, 200);
+            QCOMPARE(mObjectGroup->objectsIntersecting(rect), expectedObjects(rect));
+        }
+    }
+}
+
+void test_ObjectGroup::objectsIntersecting_data()
+{
+    QTest::addColumn<QRectF>("rect");
+
+    QTest::newRow("point") << QRectF(400, 300, 0, 0);
+    QTest::newRow("small") << QRectF(250, 250, 20, 20);
+    QTest::newRow("bucket edges") << QRectF(255, 255, 2, 2);
+    QTest::newRow("several buckets") << QRectF(100, 100, 700, 600);
+    QTest::newRow("large") << QRectF(-500, -500, 4000, 3000);
+    QTest::newRow("negative size") << QRectF(900, 900, -300, -300);
+    QTest::newRow("outside") << QRectF(-3000, -3000, 100, 100);
+}
+
+void test_ObjectGroup::objectsIntersecting()
+{
+    QFETCH(QRectF, rect);
+
+    const QList<MapObject*> objects = mObjectGroup->objectsIntersecting(rect);
+
+    // Compared as lists, so the order needs to match the order of objects()
+    QCOMPARE(objects, expectedObjects(rect));
+}
+
+void test_ObjectGroup::objectsIntersectingAfterChanges()
+{
+    compareWithAllObjects();
+
+    // Moving and resizing objects
+    for (int i = 0; i < mObjectGroup->objectCount(); i += 3) {
+        MapObject *object = mObjectGroup->objectAt(i);
+        object->setPosition(object->position() + QPointF(310, -170));
+        object->setSize(object->size() * 2);
+    }
+    compareWithAllObjects();
+
+    // Changing the order of the objects
+    mObjectGroup->moveObjects(150, 10, 30);
+    mObjectGroup->moveObjects(0, 50, mObjectGroup->objectCount());
+    compareWithAllObjects();
+
+    // Removing and inserting objects
+    MapObject *removed = mObjectGroup->objectAt(42);
+    mObjectGroup->removeObjectAt(42);
+    delete removed;
+    MapObject *object = mObjectGroup->objectAt(7);
+    mObjectGroup->removeObject(object);
+    mObjectGroup->insertObject(100, object);
+    mObjectGroup->addObject(new MapObject(QString(), QString(),
+                                          QPointF(256, 256), QSizeF()));
+    compareWithAllObjects();
+}
+
+void test_ObjectGroup::tileSizeChange()
+{
+    SharedTileset tileset = Tileset::create(QLatin1String("Collection"), 32, 32);
+    Tile *tile = tileset->addTile(QPixmap());
+    tileset->setDeferredTileImage(tile, QLatin1String("tile.png"), QSize(32, 32));
+
+    // Tile objects extend upwards from their position
+    MapObject *tileObject = new MapObject(QString(), QString(),
+                                          QPointF(1000, 3000), QSizeF());
+    tileObject->setCell(Cell(tile));
+    mObjectGroup->addObject(tileObject);
+
+    const QRectF rect(1010, 2600, 1, 1);
+    QVERIFY(!mObjectGroup->objectsIntersecting(rect).contains(tileObject));
+
+    tileset->setDeferredTileImage(tile, QLatin1String("tile.png"), QSize(512, 512));
+    mObjectGroup->invalidateIndex();
+
+    QVERIFY(mObjectGroup->objectsIntersecting(rect).contains(tileObject));
+}
+
+QTEST_MAIN(test_ObjectGroup)
+#include "test_objectgroup.moc"
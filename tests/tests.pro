@@ -1,4 +1,7 @@
 TEMPLATE=subdirs
 SUBDIRS = \
+    jsonformat \
     mapreader \
-    staggeredrenderer
+    objectgroup \
+    staggeredrenderer \
+    tilelayer
@@ -0,0 +1,287 @@
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_TileLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void packedCell_data();
+    void packedCell();
+
+    void overflowTilesets();
+    void releasedTilesetSlots();
+
+    void setCellAcrossChunks();
+    void mergeAcrossChunks();
+    void resizeAcrossChunks();
+    void offsetTilesAcrossChunks();
+
+private:
+    Cell cell(int tilesetIndex, int tileId) const;
+    void fill(TileLayer &layer) const;
+
+    QVector<SharedTileset> mTilesets;
+};
+
+void test_TileLayer::initTestCase()
+{
+    // More tilesets than fit in the packed layout of a single layer
+    for (int i = 0; i < OverflowTilesetIndex + 10; ++i)
+        mTilesets.append(Tileset::create(QString::number(i), 32, 32));
+}
+
+void test_TileLayer::cleanupTestCase()
+{
+    mTilesets.clear();
+}
+
+Cell test_TileLayer::cell(int tilesetIndex, int tileId) const
+{
+    Cell cell;
+    cell.setTile(mTilesets.at(tilesetIndex).data(), tileId);
+    return cell;
+}
+
+/**
+ * Fills the given layer with a pattern of cells that is unique per position.
+ */
+void test_TileLayer::fill(TileLayer &layer) const
+{
+    for (int y = 0; y < layer.height(); ++y)
+        for (int x = 0; x < layer.width(); ++x)
+            if ((x + y) % 3 != 0)
+                layer.setCell(x, y, cell((x + y) % 2, x + y * layer.width()));
+}
+
+void test_TileLayer::packedCell_data()
+{
+    QTest::addColumn<int>("tileId");
+    QTest::addColumn<bool>("flippedHorizontally");
+    QTest::addColumn<bool>("flippedVertically");
+    QTest::addColumn<bool>("flippedAntiDiagonally");
+
+    QTest::newRow("no flags") << 0 << false << false << false;
+    QTest::newRow("horizontal") << 1 << true << false << false;
+    QTest::newRow("vertical") << 2 << false << true << false;
+    QTest::newRow("anti-diagonal") << 3 << false << false << true;
+    QTest::newRow("all flags") << 4 << true << true << true;
+    QTest::newRow("largest packed ID") << int(PackedTileIdMask) << true << false << true;
+    QTest::newRow("ID of 2^20") << int(PackedTileIdMask) + 1 << false << false << false;
+    QTest::newRow("ID above 2^20") << (1 << 24) << true << true << false;
+}
+
+void test_TileLayer::packedCell()
+{
+    QFETCH(int, tileId);
+    QFETCH(bool, flippedHorizontally);
+    QFETCH(bool, flippedVertically);
+    QFETCH(bool, flippedAntiDiagonally);
+
+    Cell expected = cell(0, tileId);
+    expected.setFlippedHorizontally(flippedHorizontally);
+    expected.setFlippedVertically(flippedVertically);
+    expected.setFlippedAntiDiagonally(flippedAntiDiagonally);
+
+    TileLayer layer(QString(), 0, 0, 20, 20);
+    layer.setCell(17, 3, expected);
+
+    QCOMPARE(layer.cellAt(17, 3), expected);
+    QVERIFY(layer.cellAt(16, 3).isEmpty());
+    QCOMPARE(layer.region(), QRegion(17, 3, 1, 1));
+    QVERIFY(layer.referencesTileset(mTilesets.at(0).data()));
+
+    // Clones share the packed cells
+    QScopedPointer<TileLayer> clone(static_cast<TileLayer*>(layer.clone()));
+    QCOMPARE(clone->cellAt(17, 3), expected);
+    QVERIFY(clone->computeDiffRegion(&layer).isEmpty());
+
+    layer.setCell(17, 3, Cell());
+    QVERIFY(layer.isEmpty());
+    QVERIFY(!layer.referencesTileset(mTilesets.at(0).data()));
+}
+
+void test_TileLayer::overflowTilesets()
+{
+    TileLayer layer(QString(), 0, 0, 40, 40);
+
+    for (int i = 0; i < mTilesets.size(); ++i) {
+        Cell c = cell(i, i);
+        c.setFlippedVertically(i % 2);
+        layer.setCell(i % 40, i / 40, c);
+    }
+
+    for (int i = 0; i < mTilesets.size(); ++i) {
+        Cell c = cell(i, i);
+        c.setFlippedVertically(i % 2);
+        QCOMPARE(layer.cellAt(i % 40, i / 40), c);
+    }
+
+    QCOMPARE(layer.usedTilesets().size(), mTilesets.size());
+
+    // Moving cells keeps the ones that didn't fit the packed layout
+    layer.offsetTiles(QPoint(1, 1), layer.bounds(), true, true);
+
+    for (int i = 0; i < mTilesets.size(); ++i) {
+        Cell c = cell(i, i);
+        c.setFlippedVertically(i % 2);
+        QCOMPARE(layer.cellAt((i % 40 + 1) % 40, (i / 40 + 1) % 40), c);
+    }
+
+    // Removing the references to the last tileset leaves the others intact
+    Tileset *last = mTilesets.last().data();
+    layer.removeReferencesToTileset(last);
+    QVERIFY(!layer.referencesTileset(last));
+    QCOMPARE(layer.usedTilesets().size(), mTilesets.size() - 1);
+}
+
+void test_TileLayer::releasedTilesetSlots()
+{
+    TileLayer layer(QString(), 0, 0, 40, 40);
+
+    // Fill the tileset table, leaving the first slot for empty cells
+    const int slots = OverflowTilesetIndex - 1;
+    for (int i = 0; i < slots; ++i)
+        layer.setCell(i % 40, i / 40, cell(i, 0));
+
+    auto packedCellAt = [&] (int x, int y) {
+        const QPoint position(x & ~CHUNK_MASK, y & ~CHUNK_MASK);
+        return layer.chunks().value(position).packedCellAt(x & CHUNK_MASK,
+                                                           y & CHUNK_MASK);
+    };
+
+    layer.setCell(0, 20, cell(slots, 0));
+    QCOMPARE(packedCellAt(0, 20), PackedOverflowCell);
+
+    // Once the first tileset is no longer used, its slot is reused
+    layer.setCell(0, 0, Cell());
+    QVERIFY(!layer.referencesTileset(mTilesets.at(0).data()));
+
+    layer.setCell(1, 20, cell(slots + 1, 0));
+    QVERIFY(packedCellAt(1, 20) != PackedOverflowCell);
+    QCOMPARE(layer.cellAt(1, 20), cell(slots + 1, 0));
+    QCOMPARE(layer.cellAt(0, 20), cell(slots, 0));
+    QCOMPARE(layer.usedTilesets().size(), slots + 1);
+}
+
+void test_TileLayer::setCellAcrossChunks()
+{
+    TileLayer layer(QString(), 0, 0, 3 * CHUNK_SIZE, 3 * CHUNK_SIZE);
+
+    const QVector<QPoint> positions {
+        QPoint(CHUNK_SIZE - 1, CHUNK_SIZE - 1),
+        QPoint(CHUNK_SIZE, CHUNK_SIZE - 1),
+        QPoint(CHUNK_SIZE - 1, CHUNK_SIZE),
+        QPoint(CHUNK_SIZE, CHUNK_SIZE),
+        QPoint(3 * CHUNK_SIZE - 1, 0),
+    };
+
+    QRegion expectedRegion;
+    for (int i = 0; i < positions.size(); ++i) {
+        layer.setCell(positions.at(i).x(), positions.at(i).y(), cell(0, i));
+        expectedRegion |= QRect(positions.at(i), QSize(1, 1));
+    }
+
+    for (int i = 0; i < positions.size(); ++i)
+        QCOMPARE(layer.cellAt(positions.at(i)), cell(0, i));
+
+    QCOMPARE(layer.region(), expectedRegion);
+    QCOMPARE(layer.chunks().size(), 5);
+
+    layer.erase(QRegion(CHUNK_SIZE - 1, CHUNK_SIZE - 1, 2, 2));
+    QCOMPARE(layer.region(), QRegion(3 * CHUNK_SIZE - 1, 0, 1, 1));
+}
+
+void test_TileLayer::mergeAcrossChunks()
+{
+    TileLayer source(QString(), 0, 0, CHUNK_SIZE + 3, CHUNK_SIZE + 5);
+    fill(source);
+
+    TileLayer layer(QString(), 0, 0, 3 * CHUNK_SIZE, 3 * CHUNK_SIZE);
+    layer.setCell(0, 0, cell(2, 0));
+
+    const QPoint pos(CHUNK_SIZE / 2 + 1, CHUNK_SIZE - 2);
+    layer.merge(pos, &source);
+
+    for (int y = 0; y < layer.height(); ++y) {
+        for (int x = 0; x < layer.width(); ++x) {
+            const QPoint sourcePos = QPoint(x, y) - pos;
+            Cell expected;
+            if (source.contains(sourcePos))
+                expected = source.cellAt(sourcePos);
+            if (x == 0 && y == 0)
+                expected = cell(2, 0);
+
+            QCOMPARE(layer.cellAt(x, y), expected);
+        }
+    }
+}
+
+void test_TileLayer::resizeAcrossChunks()
+{
+    TileLayer original(QString(), 0, 0, 2 * CHUNK_SIZE + 1, 2 * CHUNK_SIZE + 1);
+    fill(original);
+
+    TileLayer layer(QString(), 0, 0, original.width(), original.height());
+    fill(layer);
+
+    const QSize size(CHUNK_SIZE + 7, 3 * CHUNK_SIZE);
+    const QPoint offset(-5, CHUNK_SIZE - 3);
+    layer.resize(size, offset);
+
+    QCOMPARE(layer.size(), size);
+
+    for (int y = 0; y < size.height(); ++y) {
+        for (int x = 0; x < size.width(); ++x) {
+            const QPoint originalPos = QPoint(x, y) - offset;
+            const Cell expected = original.contains(originalPos) ? original.cellAt(originalPos)
+                                                                 : Cell();
+            QCOMPARE(layer.cellAt(x, y), expected);
+        }
+    }
+}
+
+void test_TileLayer::offsetTilesAcrossChunks()
+{
+    TileLayer original(QString(), 0, 0, 2 * CHUNK_SIZE + 3, 2 * CHUNK_SIZE);
+    fill(original);
+
+    const QRect bounds(3, 2, CHUNK_SIZE + 4, CHUNK_SIZE + 1);
+    const QPoint offset(CHUNK_SIZE - 1, -3);
+
+    TileLayer layer(QString(), 0, 0, original.width(), original.height());
+    fill(layer);
+    layer.offsetTiles(offset, bounds, true, false);
+
+    for (int y = 0; y < layer.height(); ++y) {
+        for (int x = 0; x < layer.width(); ++x) {
+            Cell expected;
+
+            if (!bounds.contains(x, y)) {
+                // Tiles outside of the bounds are untouched
+                expected = original.cellAt(x, y);
+            } else {
+                // Wrapped horizontally, cut off vertically
+                int originalX = x - offset.x() - bounds.left();
+                originalX = (originalX % bounds.width() + bounds.width()) % bounds.width();
+                originalX += bounds.left();
+
+                const int originalY = y - offset.y();
+                if (bounds.contains(originalX, originalY))
+                    expected = original.cellAt(originalX, originalY);
+            }
+
+            QCOMPARE(layer.cellAt(x, y), expected);
+        }
+    }
+}
+
+QTEST_MAIN(test_TileLayer)
+#include "test_tilelayer.moc"